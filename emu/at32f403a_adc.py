@@ -0,0 +1,43 @@
+# adc1 for emu/at32f403a.repl: conversions replay the 12-bit samples of an
+# sc16 file (uint16 0..4095, i/q interleaved, little-endian, as iqd writes
+# them), named by the AT32_EMU_FEED environment variable, looping at its
+# end; without one every conversion reads mid-scale. calibration finishes
+# at once and the software trigger restarts the file. one register is not
+# on the chip: writing n to SKIP drops n samples, which src/hal_emu.c uses
+# for blocks the dma would have overwritten.
+
+import System
+
+CTRL2 = 0x08
+ODT = 0x4C
+SKIP = 0x80
+
+ADCAL = 1 << 2
+ADCALINIT = 1 << 3
+OCSWTRG = 1 << 22
+
+if request.isInit:
+    regs = {}
+    feed = None
+    position = 0
+    path = System.Environment.GetEnvironmentVariable("AT32_EMU_FEED")
+    if path:
+        feed = System.IO.File.ReadAllBytes(path)
+    samples = feed.Length // 2 if feed else 0
+elif request.isWrite:
+    if request.offset == CTRL2 and request.value & OCSWTRG:
+        position = 0
+    if request.offset == SKIP:
+        position += request.value
+    else:
+        regs[request.offset] = request.value & ~(ADCAL | ADCALINIT | OCSWTRG)
+elif request.isRead:
+    if request.offset == ODT:
+        if samples:
+            at = (position % samples) * 2
+            request.value = (feed[at] | feed[at + 1] << 8) & 0xfff
+        else:
+            request.value = 0x800
+        position += 1
+    else:
+        request.value = regs.get(request.offset, 0)
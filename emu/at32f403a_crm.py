@@ -0,0 +1,21 @@
+# crm for emu/at32f403a.repl: registers hold what is written, clock sources
+# report stable as soon as they are enabled, and the system clock switch
+# takes effect at once, so the firmware's clock setup runs unchanged
+
+CTRL = 0x00
+CFG = 0x04
+
+if request.isInit:
+    regs = {CTRL: 0x00000083}
+elif request.isWrite:
+    regs[request.offset] = request.value
+elif request.isRead:
+    value = regs.get(request.offset, 0)
+    if request.offset == CTRL:
+        # hick, hext and pll: the stable flag follows the enable
+        for enable in (0, 16, 24):
+            if value & (1 << enable):
+                value |= 1 << (enable + 1)
+    elif request.offset == CFG:
+        value = (value & ~0xc) | ((value & 0x3) << 2)
+    request.value = value
@@ -0,0 +1,41 @@
+#!/bin/sh
+# boot the firmware in renode on a simulated signal, print the stream's
+# cycle profile (missed dma deadlines show as overruns), then stream it to
+# the host and check the samples come back bit for bit:
+#
+#   emu/check.sh [SECONDS]
+#
+# needs renode on the path (or $RENODE), make emu and make host.
+
+set -e
+cd "$(dirname "$0")/.."
+
+SECONDS_=${1:-5}
+RENODE=${RENODE:-renode}
+BUILD=${BUILD:-build}
+PTY=/tmp/at32f403a-emu.$$
+FEED=$BUILD/emu-feed.sc16
+OUT=$BUILD/emu-out.sc16
+
+# a few seconds of synthetic signal, which iqd writes at the module's rate
+timeout 3 ./$BUILD/host/iqd -d sim:seed=1,target=1500@300 -o "$FEED" || true
+test -s "$FEED"
+
+AT32_EMU_FEED=$FEED "$RENODE" --disable-xwt --console --plain \
+  -e "\$pty=\"$PTY\"; include @emu/at32f403a.resc; start" >$BUILD/emu-renode.log 2>&1 &
+renode=$!
+trap 'kill $renode 2>/dev/null || true; rm -f "$PTY"' EXIT
+
+for x in $(seq 100); do
+  test -e "$PTY" && break
+  sleep 0.1
+done
+
+./$BUILD/host/iqprof -d "$PTY" -s "$SECONDS_"
+
+# iqprof leaves the module taking commands, and the trigger restarts the feed
+timeout "$SECONDS_" ./$BUILD/host/iqd -d "$PTY" -o "$OUT" || true
+test -s "$OUT"
+bytes=$(( $(stat -c %s "$OUT") < $(stat -c %s "$FEED") ? $(stat -c %s "$OUT") : $(stat -c %s "$FEED") ))
+cmp -n "$bytes" "$OUT" "$FEED"
+echo "$bytes bytes of the stream match the adc input"
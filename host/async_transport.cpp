@@ -0,0 +1,90 @@
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "async_transport.h"
+#include "protocol.h"
+
+namespace iq {
+
+// SC12_BYTES - 1 bytes past ring_size let a cut finish the pair in progress
+AsyncTransport::AsyncTransport(size_t ring_size)
+    : ring_(ring_size + SC12_BYTES - 1), event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+AsyncTransport::~AsyncTransport() { close(event_fd_); }
+
+void AsyncTransport::push(const uint8_t *data, size_t len) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    size_t drop = std::min(len, skip_);
+    data += drop;
+    len -= drop;
+    skip_ -= drop;
+    dropped_ += drop;
+    uint64_t at = pushed_ + drop;
+    pushed_ += drop + len;
+    size_t room = ring_.size() - fill_;
+    if (fill_ + len > ring_.size() - (SC12_BYTES - 1)) {
+      // keep up to the last pair boundary that fits and cut whole pairs from
+      // there, taking the rest from the next transfer
+      size_t cut = (at - origin_ + room) % SC12_BYTES;
+      size_t keep = room >= cut ? room - cut : 0;
+      if (keep < len) {
+        drop = (len - keep + SC12_BYTES - 1) / SC12_BYTES * SC12_BYTES;
+        skip_ = drop - (len - keep);
+        dropped_ += drop - skip_;
+        len = keep;
+      }
+    }
+    size_t tail = (head_ + fill_) % ring_.size();
+    size_t first = std::min(len, ring_.size() - tail);
+    memcpy(&ring_[tail], data, first);
+    memcpy(&ring_[0], data + first, len - first);
+    fill_ += len;
+  }
+  uint64_t one = 1;
+  (void)::write(event_fd_, &one, sizeof(one));
+}
+
+void AsyncTransport::hangup() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    closed_ = true;
+  }
+  uint64_t one = 1;
+  (void)::write(event_fd_, &one, sizeof(one));
+}
+
+ssize_t AsyncTransport::write(const void *buf, size_t len) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    origin_ = pushed_;
+  }
+  return transmit(buf, len);
+}
+
+ssize_t AsyncTransport::read(void *buf, size_t len) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (fill_ == 0) {
+    if (closed_)
+      return 0;
+    // drain the eventfd under the lock, so a concurrent push re-arms it
+    uint64_t count;
+    (void)::read(event_fd_, &count, sizeof(count));
+    errno = EAGAIN;
+    return -1;
+  }
+
+  len = std::min(len, fill_);
+  size_t first = std::min(len, ring_.size() - head_);
+  memcpy(buf, &ring_[head_], first);
+  memcpy(static_cast<uint8_t *>(buf) + first, &ring_[0], len - first);
+  head_ = (head_ + len) % ring_.size();
+  fill_ -= len;
+  return len;
+}
+
+}  // namespace iq
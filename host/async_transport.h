@@ -0,0 +1,52 @@
+// transport fed by asynchronous completions (libusb transfers, simulators)
+//
+// producers push data from their own thread; the owning loop polls fd(),
+// an eventfd that is readable whenever buffered data or a hangup is pending.
+// what the module sends after a write() answers it, so a stream's sc12
+// pairs are counted from the last write.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "transport.h"
+
+namespace iq {
+
+class AsyncTransport : public Transport {
+ public:
+  explicit AsyncTransport(size_t ring_size);
+  ~AsyncTransport() override;
+
+  int fd() const override { return event_fd_; }
+  ssize_t read(void *buf, size_t len) override;
+  ssize_t write(const void *buf, size_t len) final;
+
+  // producer side; data that does not fit is dropped and counted, in whole
+  // sc12 pairs so the reader stays aligned
+  void push(const uint8_t *data, size_t len);
+  void hangup();
+
+  uint64_t dropped_bytes() const override { return dropped_.load(std::memory_order_relaxed); }
+
+ protected:
+  // the producer's way to the module
+  virtual ssize_t transmit(const void *buf, size_t len) = 0;
+
+ private:
+  std::mutex lock_;
+  std::vector<uint8_t> ring_;
+  size_t head_ = 0;
+  size_t fill_ = 0;
+  size_t skip_ = 0;  // bytes still owed to the last drop
+  uint64_t pushed_ = 0;  // bytes the module has sent, dropped or not
+  uint64_t origin_ = 0;  // pushed_ at the last write, where pairs start
+  bool closed_ = false;
+  std::atomic<uint64_t> dropped_{0};
+  int event_fd_;
+};
+
+}  // namespace iq
@@ -0,0 +1,133 @@
+// the firmware's per-block work, timed on the host: src/app.c and the dsp
+// modules it calls, built natively on the fake drivers in fake_hal.h and
+// driven through the same usb commands iqd sends. this is not the
+// cortex-m4, so the numbers rank changes rather than predict target cycles;
+// `perf record build/host/bench_firmware` profiles the firmware code itself.
+//
+//   bench_firmware [-n BLOCKS]
+//
+// READ_ADC's output is also unpacked and checked against the adc input.
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "app.h"
+#include "fake_hal.h"
+#include "protocol.h"
+#include "simulator.h"
+#include "unpack.h"
+
+namespace {
+
+// quiet blocks with a burst of motion at the end, so READ_TRIGGERED fires
+// once per pass through them
+constexpr size_t SOURCE_BLOCKS = 64;
+constexpr size_t BURST_BLOCKS = 8;
+
+std::vector<uint16_t> source;
+size_t next_block;
+size_t blocks_in;
+size_t bytes_out;
+std::vector<uint8_t> last_out;
+
+void command(const std::vector<uint32_t> &words) {
+  std::vector<uint8_t> packet(words.size() * 4);
+  memcpy(packet.data(), words.data(), packet.size());
+  iq::fake_hal().rx.push_back(packet);
+  app_poll();
+}
+
+// configure the adc and dma as iqd does, then start a stream
+void start(const std::vector<uint32_t> &setup, uint32_t stream) {
+  hal_init();
+  app_init();
+  for (uint32_t cmd : {iq::CFG_DMA, iq::CFG_ADC, iq::TRIGGER_ADC})
+    command({cmd});
+  if (!setup.empty())
+    command(setup);
+  command({stream});
+  next_block = blocks_in = bytes_out = 0;
+}
+
+double run(size_t blocks) {
+  auto t0 = std::chrono::steady_clock::now();
+  while (blocks_in < blocks)
+    app_poll();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t blocks = 20000;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:h")) != -1) {
+    switch (opt) {
+      case 'n':
+        blocks = strtoul(optarg, nullptr, 0);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-n BLOCKS]\n", argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  iq::SimConfig quiet, burst;
+  burst.targets = {{1500, 600}, {-4000, 300}};
+  iq::Simulator quiet_sim(quiet), burst_sim(burst);
+  source.resize(SOURCE_BLOCKS * iq::BLOCK_SAMPLES * 2);
+  for (size_t b = 0; b < SOURCE_BLOCKS; b++) {
+    auto *pairs = reinterpret_cast<uint16_t(*)[2]>(&source[b * iq::BLOCK_SAMPLES * 2]);
+    (b < SOURCE_BLOCKS - BURST_BLOCKS ? quiet_sim : burst_sim).sample(pairs);
+  }
+
+  iq::FakeHal &hal = iq::fake_hal();
+  hal.adc = [](uint16_t (*pairs)[2], size_t count) {
+    memcpy(pairs, &source[next_block * count * 2], count * 4);
+    next_block = (next_block + 1) % SOURCE_BLOCKS;
+    blocks_in++;
+    return true;
+  };
+  hal.tx = [](const uint8_t *data, size_t len) {
+    bytes_out += len;
+    last_out.assign(data, data + len);
+    return true;
+  };
+
+  // READ_ADC, plain: the output must be exactly the adc's samples
+  start({}, iq::READ_ADC);
+  run(SOURCE_BLOCKS);
+  std::vector<int16_t> unpacked(iq::BLOCK_SAMPLES * 2);
+  iq::unpack_sc12(last_out.data(), unpacked.data(), iq::BLOCK_SAMPLES);
+  bool exact = last_out.size() == iq::BLOCK_BYTES;
+  const uint16_t *expect = &source[(SOURCE_BLOCKS - 1) * iq::BLOCK_SAMPLES * 2];
+  for (size_t k = 0; exact && k < iq::BLOCK_SAMPLES * 2; k++)
+    exact = uint16_t(unpacked[k]) == expect[k];
+
+  struct {
+    const char *name;
+    std::vector<uint32_t> setup;
+    uint32_t stream;
+  } modes[] = {
+    {"adc", {}, iq::READ_ADC},
+    {"adc+clutter", {iq::CFG_CLUTTER, 1, 8}, iq::READ_ADC},
+    {"triggered", {iq::CFG_TRIGGER, 1600, 4, 8}, iq::READ_TRIGGERED},
+    {"vitals", {}, iq::READ_VITALS},
+  };
+
+  double budget_ns = iq::BLOCK_SAMPLES / iq::SAMPLE_RATE * 1e9;
+  printf("%-12s %10s %10s %12s\n", "mode", "ns/block", "% budget", "bytes/block");
+  for (auto &m : modes) {
+    start(m.setup, m.stream);
+    double seconds = run(blocks);
+    double ns = seconds * 1e9 / blocks;
+    printf("%-12s %10.0f %10.2f %12.0f\n", m.name, ns, 100 * ns / budget_ns, double(bytes_out) / blocks);
+  }
+  printf("READ_ADC output %s\n", exact ? "bit-exact" : "MISMATCH");
+  return exact ? 0 : 1;
+}
@@ -0,0 +1,629 @@
+// gateway sizing benchmark: how many modules one host keeps up with, and
+// the cpu and memory each one costs
+//
+//   bench_gateway [-n LIST | -N MAX] [-O SPEC]... [-S SPEC] [-j THREADS] [-s SECONDS] [-o FILE]
+//
+// each trial streams N synthetic modules through the host pipeline as iqd
+// runs it: one reader thread polling every device, sc12 decoding into
+// blocks, and the outputs written from a shared worker pool. the default
+// output is sigmf:, which takes the adc's offset out, runs the fft and
+// cfar detector over every block and records the stream to disk; -O
+// replaces it (repeatable; {id} and {dir} expand to the device's id and
+// the trial's scratch directory, which is removed afterwards unless -k).
+//
+// the modules are one pacing thread writing pre-synthesised blocks (the
+// simulator's signal, with -S added to each module's spec) into a
+// socketpair per device at the module's block rate. a block that finds
+// its socket full is lost, as the module's usb fifo would lose it, and so
+// is a block an output drops on overrun. a trial is real time when none
+// were lost, every device was read at the full rate and the pacing
+// thread never fell more than LATE_LIMIT_MS behind.
+//
+// cpu is the process's user + system time less the pacing thread's, per
+// device, in percent of one core; memory is resident growth from before
+// the devices were opened, per device. each trial runs in a child process
+// so its memory starts from the same place. without -n the device count
+// doubles from 1 until a trial fails or reaches -N, then bisects for the
+// largest real-time N. there is no power meter to read: scale cpu per
+// device by the gateway's watts per busy core.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+#include "pipeline.h"
+#include "protocol.h"
+#include "simulator.h"
+#include "sink.h"
+#include "worker_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t SOURCES = 8;          // distinct signals, shared out round robin
+constexpr size_t SOURCE_BLOCKS = 64;   // per signal, played in a loop
+constexpr int SOCKET_BUFFER = 65536;   // about what a cdc-acm tty holds
+constexpr size_t READ_SIZE = 65536;    // iqd's default
+constexpr size_t DEPTH = 64;           // iqd's default
+constexpr double LATE_LIMIT_MS = 100;
+constexpr double MIN_RATE = 0.98;      // of the nominal rate, per device
+
+struct Config {
+  std::vector<std::string> outputs;
+  std::string sim_spec;
+  size_t threads = 0;
+  double seconds = 5;
+  double warmup = 1;
+  std::string dir = "/tmp";
+  bool keep = false;
+};
+
+// one trial's results, passed back from its child through a pipe
+struct Trial {
+  int devices = 0;
+  double seconds = 0;
+  double cpu = 0;          // cores, less the pacing thread
+  double reader_cpu = 0;   // cores
+  double source_cpu = 0;   // cores
+  double rss = 0;          // bytes of growth
+  double rate = 0;         // samples/s, mean per device
+  double min_rate = 0;     // samples/s, slowest device
+  uint64_t offered = 0;    // blocks
+  uint64_t lost_source = 0;
+  uint64_t lost_output = 0;
+  double late_ms = 0;
+  uint64_t detections = 0;
+  bool realtime = false;
+  char error[256] = "";
+};
+
+uint64_t thread_cpu_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t process_cpu_ns() {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (uint64_t(ru.ru_utime.tv_sec) + ru.ru_stime.tv_sec) * 1000000000 +
+         (uint64_t(ru.ru_utime.tv_usec) + ru.ru_stime.tv_usec) * 1000;
+}
+
+double rss_bytes() {
+  long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f) {
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+      resident = 0;
+    fclose(f);
+  }
+  return double(resident) * sysconf(_SC_PAGESIZE);
+}
+
+std::string expand(std::string spec, const std::string &id, const std::string &dir) {
+  for (size_t at; (at = spec.find("{id}")) != std::string::npos;)
+    spec.replace(at, 4, id);
+  for (size_t at; (at = spec.find("{dir}")) != std::string::npos;)
+    spec.replace(at, 5, dir);
+  return spec;
+}
+
+void remove_tree(const std::string &dir) {
+  if (DIR *d = opendir(dir.c_str())) {
+    while (struct dirent *e = readdir(d)) {
+      if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0)
+        unlink((dir + "/" + e->d_name).c_str());
+    }
+    closedir(d);
+  }
+  rmdir(dir.c_str());
+}
+
+// the signals the modules play: half noise alone, half with a target each
+bool synthesise(const std::string &extra, std::vector<std::vector<uint8_t>> *sources, std::string *error) {
+  for (size_t k = 0; k < SOURCES; k++) {
+    std::string spec = "seed=" + std::to_string(k + 1);
+    if (k % 2)
+      spec += ",target=" + std::to_string(250 + 100 * k) + "@300";
+    if (!extra.empty())
+      spec += "," + extra;
+    iq::SimConfig config;
+    if (!iq::parse_sim_spec(spec, &config, error))
+      return false;
+    iq::Simulator sim(config);
+    std::vector<uint8_t> blocks(SOURCE_BLOCKS * iq::BLOCK_BYTES);
+    for (size_t b = 0; b < SOURCE_BLOCKS; b++)
+      sim.synthesise(blocks.data() + b * iq::BLOCK_BYTES);
+    sources->push_back(std::move(blocks));
+  }
+  return true;
+}
+
+// the modules: every device's next block each period, written without
+// waiting. a device whose last block is still partly unsent, or whose
+// socket is full, loses the block.
+class Pacer {
+ public:
+  Pacer(const std::vector<std::vector<uint8_t>> &sources, std::vector<int> fds)
+      : sources_(sources), fds_(std::move(fds)), pending_(fds_.size()) {}
+
+  void start() { thread_ = std::thread([this] { run(); }); }
+  void stop() {
+    stop_.store(true);
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+  uint64_t offered() const { return offered_.load(std::memory_order_relaxed); }
+  uint64_t lost() const { return lost_.load(std::memory_order_relaxed); }
+  uint64_t cpu_ns() const { return cpu_ns_.load(std::memory_order_relaxed); }
+  // worst lag behind the block clock since the last call
+  double take_late_ms() { return late_ns_.exchange(0) / 1e6; }
+
+ private:
+  void run() {
+    auto period = std::chrono::nanoseconds(int64_t(iq::BLOCK_SAMPLES * 1e9 / iq::SAMPLE_RATE));
+    Clock::time_point due = Clock::now();
+    for (uint64_t block = 0; !stop_.load(std::memory_order_relaxed);) {
+      Clock::time_point now = Clock::now();
+      uint64_t late = std::chrono::duration_cast<std::chrono::nanoseconds>(now - due).count();
+      if (now > due && late > late_ns_.load(std::memory_order_relaxed))
+        late_ns_.store(late, std::memory_order_relaxed);
+      // catch up on every block that fell due while asleep
+      for (; due <= now; due += period, block++) {
+        for (size_t d = 0; d < fds_.size(); d++)
+          offer(d, block);
+      }
+      cpu_ns_.store(thread_cpu_ns(), std::memory_order_relaxed);
+      std::this_thread::sleep_until(due);
+    }
+  }
+
+  void offer(size_t d, uint64_t block) {
+    const std::vector<uint8_t> &source = sources_[d % SOURCES];
+    offered_.fetch_add(1, std::memory_order_relaxed);
+    if (!flush(d)) {
+      lost_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    // devices sharing a signal start at different points in it
+    size_t k = (block + d * 7) % SOURCE_BLOCKS;
+    pending_[d].data = source.data() + k * iq::BLOCK_BYTES;
+    pending_[d].left = iq::BLOCK_BYTES;
+    if (!flush(d) && pending_[d].left == iq::BLOCK_BYTES) {
+      lost_.fetch_add(1, std::memory_order_relaxed);
+      pending_[d].left = 0;
+    }
+  }
+
+  // false while part of the device's block is unsent
+  bool flush(size_t d) {
+    Pending &p = pending_[d];
+    while (p.left > 0) {
+      ssize_t n = send(fds_[d], p.data, p.left, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (n <= 0)
+        return false;
+      p.data += n;
+      p.left -= n;
+    }
+    return true;
+  }
+
+  struct Pending {
+    const uint8_t *data = nullptr;
+    size_t left = 0;
+  };
+
+  const std::vector<std::vector<uint8_t>> &sources_;
+  std::vector<int> fds_;
+  std::vector<Pending> pending_;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> offered_{0};
+  std::atomic<uint64_t> lost_{0};
+  std::atomic<uint64_t> cpu_ns_{0};
+  std::atomic<uint64_t> late_ns_{0};
+};
+
+struct Snapshot {
+  Clock::time_point time;
+  uint64_t process_ns, reader_ns, source_ns;
+  uint64_t offered, lost_source, lost_output, detections;
+  std::vector<uint64_t> samples;
+};
+
+// runs in the child: n devices for warmup + seconds
+void run_trial(int n, const Config &config, const std::vector<std::vector<uint8_t>> &sources, Trial *t) {
+  t->devices = n;
+  double rss0 = rss_bytes();
+
+  std::string dir = config.dir + "/bench_gateway.XXXXXX";
+  if (!mkdtemp(&dir[0])) {
+    snprintf(t->error, sizeof(t->error), "%s: %s", dir.c_str(), strerror(errno));
+    return;
+  }
+
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  std::vector<int> readers, writers;
+  std::vector<std::unique_ptr<iq::Pipeline>> pipelines;
+  std::vector<iq::Consumer *> listeners;  // serve: outputs, polled after the readers
+  iq::WorkerPool pool(config.threads);
+  std::string error;
+  for (int d = 0; d < n && error.empty(); d++) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0, sv) != 0) {
+      error = std::string("socketpair: ") + strerror(errno);
+      break;
+    }
+    setsockopt(sv[1], SOL_SOCKET, SO_SNDBUF, &SOCKET_BUFFER, sizeof(SOCKET_BUFFER));
+    readers.push_back(sv[0]);
+    writers.push_back(sv[1]);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = d;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sv[0], &ev);
+
+    char id[16];
+    snprintf(id, sizeof(id), "gw%03d", d);
+    iq::StreamInfo info;
+    info.device_id = id;
+    info.firmware = "bench_gateway";
+    pipelines.push_back(std::make_unique<iq::Pipeline>(id, &pool));
+    for (const std::string &spec : config.outputs) {
+      auto sink = iq::open_sink(expand(spec, id, dir), info, &error);
+      if (!sink)
+        break;
+      pipelines.back()->add_output(std::move(sink), iq::OVERRUN_DROP_OLDEST, DEPTH);
+    }
+  }
+  for (auto &p : pipelines) {
+    for (auto &out : p->outputs()) {
+      if (out->poll_fd() < 0)
+        continue;
+      struct epoll_event ev = {};
+      ev.events = EPOLLIN;
+      ev.data.u32 = n + listeners.size();
+      epoll_ctl(epfd, EPOLL_CTL_ADD, out->poll_fd(), &ev);
+      listeners.push_back(out.get());
+    }
+  }
+
+  if (error.empty()) {
+    Pacer pacer(sources, writers);
+    auto snapshot = [&](Snapshot *s) {
+      s->time = Clock::now();
+      s->process_ns = process_cpu_ns();
+      s->reader_ns = thread_cpu_ns();
+      s->source_ns = pacer.cpu_ns();
+      s->offered = pacer.offered();
+      s->lost_source = pacer.lost();
+      s->lost_output = s->detections = 0;
+      s->samples.clear();
+      for (auto &p : pipelines) {
+        s->samples.push_back(p->samples());
+        for (auto &out : p->outputs()) {
+          s->lost_output += out->overruns();
+          s->detections += out->detections();
+        }
+      }
+    };
+
+    // the reader, on this thread as in iqd
+    Snapshot first, last;
+    std::vector<uint8_t> raw(READ_SIZE);
+    Clock::time_point start = Clock::now();
+    Clock::time_point measured = start + std::chrono::duration_cast<Clock::duration>(
+                                             std::chrono::duration<double>(config.warmup));
+    Clock::time_point end = measured + std::chrono::duration_cast<Clock::duration>(
+                                           std::chrono::duration<double>(config.seconds));
+    bool counting = false;
+    pacer.start();
+    while (true) {
+      Clock::time_point now = Clock::now();
+      if (!counting && now >= measured) {
+        snapshot(&first);
+        pacer.take_late_ms();
+        counting = true;
+      }
+      if (now >= end)
+        break;
+      struct epoll_event events[64];
+      int ready = epoll_wait(epfd, events, 64, 100);
+      for (int k = 0; k < ready; k++) {
+        uint32_t d = events[k].data.u32;
+        if (d >= uint32_t(n)) {
+          listeners[d - n]->service();
+          continue;
+        }
+        ssize_t got = read(readers[d], raw.data(), raw.size());
+        if (got > 0)
+          pipelines[d]->feed(raw.data(), got);
+      }
+    }
+    snapshot(&last);
+    t->late_ms = pacer.take_late_ms();
+    pacer.stop();
+    t->rss = std::max(0.0, rss_bytes() - rss0);
+
+    double elapsed = std::chrono::duration<double>(last.time - first.time).count();
+    t->seconds = elapsed;
+    t->source_cpu = (last.source_ns - first.source_ns) / 1e9 / elapsed;
+    t->cpu = (last.process_ns - first.process_ns) / 1e9 / elapsed - t->source_cpu;
+    t->reader_cpu = (last.reader_ns - first.reader_ns) / 1e9 / elapsed;
+    t->offered = last.offered - first.offered;
+    t->lost_source = last.lost_source - first.lost_source;
+    t->lost_output = last.lost_output - first.lost_output;
+    t->detections = last.detections - first.detections;
+    t->min_rate = 1e12;
+    for (int d = 0; d < n; d++) {
+      double rate = (last.samples[d] - first.samples[d]) / elapsed;
+      t->rate += rate / n;
+      t->min_rate = std::min(t->min_rate, rate);
+    }
+    t->realtime = t->lost_source == 0 && t->lost_output == 0 && t->late_ms <= LATE_LIMIT_MS &&
+                  t->min_rate >= MIN_RATE * iq::SAMPLE_RATE;
+  } else {
+    snprintf(t->error, sizeof(t->error), "%s", error.c_str());
+  }
+
+  pipelines.clear();
+  for (int fd : readers)
+    close(fd);
+  for (int fd : writers)
+    close(fd);
+  close(epfd);
+  if (!config.keep)
+    remove_tree(dir);
+}
+
+// a trial in a child process, so each starts from the same memory
+Trial trial(int n, const Config &config, const std::vector<std::vector<uint8_t>> &sources) {
+  Trial t;
+  t.devices = n;
+  int fds[2];
+  if (pipe(fds) != 0) {
+    snprintf(t.error, sizeof(t.error), "pipe: %s", strerror(errno));
+    return t;
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    Trial result;
+    run_trial(n, config, sources, &result);
+    ssize_t sent = write(fds[1], &result, sizeof(result));
+    _exit(sent == sizeof(result) ? 0 : 1);
+  }
+  close(fds[1]);
+  ssize_t got = pid > 0 ? read(fds[0], &t, sizeof(t)) : -1;
+  close(fds[0]);
+  int status = 0;
+  if (pid > 0)
+    waitpid(pid, &status, 0);
+  if (got != sizeof(t)) {
+    t = Trial();
+    t.devices = n;
+    if (pid < 0)
+      snprintf(t.error, sizeof(t.error), "fork: %s", strerror(errno));
+    else if (WIFSIGNALED(status))
+      snprintf(t.error, sizeof(t.error), "trial died: %s", strsignal(WTERMSIG(status)));
+    else
+      snprintf(t.error, sizeof(t.error), "trial exited without a result");
+  }
+  return t;
+}
+
+void print(const Trial &t) {
+  if (t.error[0]) {
+    printf("%5d  %s\n", t.devices, t.error);
+  } else {
+    printf("%5d %9.1f %9.1f %8llu %8.1f %8.1f %8.1f %8.1f %9.2f %8.1f  %s\n", t.devices, t.rate / 1e3,
+           t.min_rate / 1e3, (unsigned long long)(t.lost_source + t.lost_output), t.late_ms,
+           100 * t.cpu / t.devices, 100 * t.reader_cpu, 100 * t.cpu, t.rss / t.devices / (1 << 20),
+           t.detections / t.seconds, t.realtime ? "real time" : "behind");
+  }
+  fflush(stdout);
+}
+
+std::string to_json(const Trial &t) {
+  char out[768];
+  snprintf(out, sizeof(out),
+           "{\"devices\": %d, \"seconds\": %.3f, \"rate\": %.1f, \"min_rate\": %.1f, \"offered_blocks\": %llu, "
+           "\"lost_source_blocks\": %llu, \"lost_output_blocks\": %llu, \"late_ms\": %.2f, "
+           "\"cpu_cores\": %.4f, \"cpu_per_device\": %.5f, \"reader_cpu_cores\": %.4f, \"source_cpu_cores\": %.4f, "
+           "\"rss_bytes\": %.0f, \"rss_per_device\": %.0f, \"detections\": %llu, \"realtime\": %s",
+           t.devices, t.seconds, t.rate, t.min_rate, (unsigned long long)t.offered,
+           (unsigned long long)t.lost_source, (unsigned long long)t.lost_output, t.late_ms, t.cpu,
+           t.cpu / t.devices, t.reader_cpu, t.source_cpu, t.rss, t.rss / t.devices,
+           (unsigned long long)t.detections, t.realtime ? "true" : "false");
+  std::string s = out;
+  if (t.error[0])
+    s += ", \"error\": " + iq::json_quote(t.error);
+  return s + "}";
+}
+
+std::vector<int> parse_list(const std::string &list) {
+  std::vector<int> out;
+  size_t at = 0;
+  while (at <= list.size()) {
+    size_t comma = std::min(list.find(',', at), list.size());
+    if (comma > at)
+      out.push_back(atoi(list.substr(at, comma - at).c_str()));
+    at = comma + 1;
+  }
+  return out;
+}
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-n LIST | -N MAX] [-O SPEC]... [-S SPEC] [-j THREADS] [-s SECONDS] [-w SECONDS]\n"
+          "          [-D DIR] [-k] [-o FILE]\n"
+          "  -n LIST     comma-separated device counts to run (default: search for the largest)\n"
+          "  -N MAX      most devices the search tries (default 256)\n"
+          "  -O SPEC     each device's output, as for iqd -o; {id} and {dir} expand\n"
+          "              (repeatable; default sigmf:{dir}/{id})\n"
+          "  -S SPEC     added to each module's simulator spec, eg. noise=20\n"
+          "  -j THREADS  output worker threads (default: one per cpu)\n"
+          "  -s SECONDS  measured time per trial (default 5)\n"
+          "  -w SECONDS  warm-up per trial, not measured (default 1)\n"
+          "  -D DIR      where the trials' scratch directories go (default /tmp)\n"
+          "  -k          keep what the outputs wrote\n"
+          "  -o FILE     write the results as json\n",
+          argv0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Config config;
+  std::vector<int> counts;
+  int max_devices = 256;
+  std::string json_path;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:N:O:S:j:s:w:D:ko:h")) != -1) {
+    switch (opt) {
+      case 'n':
+        counts = parse_list(optarg);
+        break;
+      case 'N':
+        max_devices = atoi(optarg);
+        break;
+      case 'O':
+        config.outputs.push_back(optarg);
+        break;
+      case 'S':
+        config.sim_spec = optarg;
+        break;
+      case 'j':
+        config.threads = strtoul(optarg, nullptr, 0);
+        break;
+      case 's':
+        config.seconds = strtod(optarg, nullptr);
+        break;
+      case 'w':
+        config.warmup = strtod(optarg, nullptr);
+        break;
+      case 'D':
+        config.dir = optarg;
+        break;
+      case 'k':
+        config.keep = true;
+        break;
+      case 'o':
+        json_path = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  bool counts_ok = std::all_of(counts.begin(), counts.end(), [](int n) { return n > 0; });
+  if (optind != argc || !(config.seconds > 0) || config.warmup < 0 || max_devices < 1 || !counts_ok) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (config.outputs.empty())
+    config.outputs.push_back("sigmf:{dir}/{id}");
+
+  std::vector<std::vector<uint8_t>> sources;
+  std::string error;
+  if (!synthesise(config.sim_spec, &sources, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  printf("%5s %9s %9s %8s %8s %8s %8s %8s %9s %8s\n", "N", "rate", "min rate", "lost", "late", "cpu/dev",
+         "reader", "cpu", "MiB/dev", "det/s");
+  std::vector<Trial> trials;
+  auto run = [&](int n) {
+    trials.push_back(trial(n, config, sources));
+    print(trials.back());
+    return trials.back().realtime;
+  };
+
+  int largest = 0;
+  bool searched = counts.empty();
+  if (searched) {
+    // double until a trial falls behind, then bisect
+    int failed = 0;
+    for (int n = 1; !failed; n = std::min(2 * n, max_devices)) {
+      if (run(n))
+        largest = n;
+      else
+        failed = n;
+      if (n == max_devices)
+        break;
+    }
+    while (failed && failed - largest > 1) {
+      int n = largest + (failed - largest) / 2;
+      if (run(n))
+        largest = n;
+      else
+        failed = n;
+    }
+  } else {
+    for (int n : counts) {
+      if (run(n))
+        largest = std::max(largest, n);
+    }
+  }
+  printf("(rate per device in ksamples/s; late in ms behind the block clock; cpu in %% of a core)\n");
+
+  const Trial *best = nullptr;
+  for (const Trial &t : trials) {
+    if (t.realtime && t.devices == largest)
+      best = &t;
+  }
+  if (best)
+    printf("largest real-time N: %d%s, at %.1f%% of a core and %.2f MiB per device\n", largest,
+           searched && largest == max_devices ? " (the -N limit)" : "", 100 * best->cpu / largest,
+           best->rss / largest / (1 << 20));
+  else
+    printf("no trial kept up in real time\n");
+
+  bool failed = false;
+  for (const Trial &t : trials)
+    failed |= t.error[0] != 0;
+
+  if (!json_path.empty()) {
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    char nums[128];
+    snprintf(nums, sizeof(nums), "\"cpus\": %ld, \"nominal_rate\": %.0f, \"largest_realtime\": %d",
+             sysconf(_SC_NPROCESSORS_ONLN), iq::SAMPLE_RATE, largest);
+    std::string out = "{\"benchmark\": \"bench_gateway\", \"host\": " + iq::json_quote(host) + ", " + nums +
+                      ", \"outputs\": [";
+    for (size_t k = 0; k < config.outputs.size(); k++)
+      out += (k ? ", " : "") + iq::json_quote(config.outputs[k]);
+    out += "], \"runs\": [\n";
+    for (size_t k = 0; k < trials.size(); k++)
+      out += "  " + to_json(trials[k]) + (k + 1 < trials.size() ? ",\n" : "\n");
+    out += "]}\n";
+    FILE *f = fopen(json_path.c_str(), "w");
+    if (!f || fwrite(out.data(), 1, out.size(), f) != out.size() || fclose(f) != 0) {
+      perror(json_path.c_str());
+      return 1;
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,563 @@
+// end-to-end stream benchmark: sustained rate, lost blocks, arrival jitter
+// and latency percentiles, for each device, output format and read size,
+// as a table and as json for regression tracking
+//
+//   bench_stream [-d DEVICE]... [-f FORMATS] [-r SIZES] [-s SECONDS] [-o FILE]
+//   bench_stream -A
+//
+// without -d it runs against simulated modules on each host transport:
+// sim (in-process socketpair), sim-async (the same behind AsyncTransport,
+// fed in bulk transfers as the libusb backend feeds it), sim-pty (a pty,
+// as the cdc-acm tty path reads) and sim-unix (a unix socket); -S passes
+// them a simulator spec, eg. -S drop=0.001. with -d it runs against real
+// modules (tty, usb...), one run after another: each run ends its stream
+// with READ_PROFILE, so the module needs no reset in between.
+//
+// the module timestamps nothing, so block i's arrival is fitted against
+// i * period; latency is each block's delay above the best-placed one
+// (sample-to-host latency beyond the fixed minimum), after conversion to
+// FORMAT. lost blocks are those the span from first to last arrival
+// should have held at the nominal rate but didn't; each one also shifts
+// the later blocks a period late, so latency is only meaningful for runs
+// that lost none. an unpaced (fast) simulator has no nominal rate, so its
+// loss and latency are left out.
+//
+// -A checks AsyncTransport's overflow path instead: an unpaced replay of a
+// known pattern overfills a small ring under a slow reader with odd read
+// sizes, and every pair read must still decode to the pattern, the drops
+// must be whole pairs accounting for everything not read, and the end of
+// the replay must reach the reader as a hangup on the eventfd.
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_transport.h"
+#include "device.h"
+#include "json.h"
+#include "protocol.h"
+#include "simulator.h"
+#include "unpack.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// a simulator serving a pty or a unix socket on a thread, for the tty and
+// socket transports without hardware
+class SimServer {
+ public:
+  ~SimServer() {
+    stop_.store(true);
+    if (thread_.joinable())
+      thread_.join();
+    if (fd_ >= 0)
+      close(fd_);
+    if (slave_ >= 0)
+      close(slave_);
+    if (!socket_path_.empty())
+      unlink(socket_path_.c_str());
+  }
+
+  // the device path to open: a pty slave, or "unix:PATH"
+  bool start(const std::string &kind, const iq::SimConfig &config, std::string *device, std::string *error) {
+    sim_ = std::make_unique<iq::Simulator>(config);
+    if (kind == "pty")
+      return start_pty(device, error);
+    return start_unix(device, error);
+  }
+
+ private:
+  bool start_pty(std::string *device, std::string *error) {
+    fd_ = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd_ < 0 || grantpt(fd_) != 0 || unlockpt(fd_) != 0) {
+      *error = std::string("posix_openpt: ") + strerror(errno);
+      return false;
+    }
+    *device = ptsname(fd_);
+    // raw before the host opens it, or the line discipline eats bytes
+    slave_ = open(device->c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    struct termios tio;
+    if (slave_ < 0 || tcgetattr(slave_, &tio) != 0) {
+      *error = *device + ": " + strerror(errno);
+      return false;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave_, TCSANOW, &tio);
+    thread_ = std::thread([this] { sim_->serve(fd_, stop_); });
+    return true;
+  }
+
+  bool start_unix(std::string *device, std::string *error) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_stream.%d.sock", getpid());
+    socket_path_ = path;
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, strlen(path));
+    unlink(path);
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0 || bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd_, 1) != 0) {
+      *error = socket_path_ + ": " + strerror(errno);
+      return false;
+    }
+    thread_ = std::thread([this] {
+      while (!stop_.load()) {
+        struct pollfd pfd = {fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0)
+          continue;
+        int conn = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn < 0)
+          continue;
+        sim_->serve(conn, stop_);
+        close(conn);
+      }
+    });
+    *device = "unix:" + socket_path_;
+    return true;
+  }
+
+  std::unique_ptr<iq::Simulator> sim_;
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+  int fd_ = -1;
+  int slave_ = -1;
+  std::string socket_path_;
+};
+
+struct Run {
+  std::string device;
+  std::string transport;
+  std::string format;
+  size_t read_size = 0;
+
+  std::string firmware;
+  std::string error;
+  double seconds = 0;
+  uint64_t samples = 0;
+  uint64_t blocks = 0;
+  double rate = 0;
+  bool paced = true;
+  int64_t lost = 0;
+  double period_us = 0;                 // fitted
+  std::vector<double> interval_us;      // between block arrivals
+  std::vector<double> latency_us;       // above the best-placed block
+};
+
+double percentile(std::vector<double> v, double p) {
+  if (v.empty())
+    return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, size_t(p * (v.size() - 1) + 0.5))];
+}
+
+double stddev(const std::vector<double> &v) {
+  if (v.size() < 2)
+    return 0;
+  double mean = 0, sq = 0;
+  for (double x : v)
+    mean += x;
+  mean /= v.size();
+  for (double x : v)
+    sq += (x - mean) * (x - mean);
+  return std::sqrt(sq / (v.size() - 1));
+}
+
+std::string transport_kind(const std::string &device) {
+  if (device.compare(0, 10, "sim:async,") == 0)
+    return "async";
+  if (device == "sim" || device.compare(0, 4, "sim:") == 0)
+    return "socketpair";
+  if (device.compare(0, 3, "usb") == 0)
+    return "usb";
+  if (device.compare(0, 5, "unix:") == 0)
+    return "unix";
+  return "tty";
+}
+
+// convert the whole blocks in buf to format; the output only has to exist
+void convert(const std::string &format, const uint8_t *in, size_t samples, std::vector<uint8_t> *out) {
+  if (format == "s16")
+    iq::unpack_sc12(in, reinterpret_cast<int16_t *>(out->data()), samples);
+  else if (format == "f32")
+    iq::unpack_sc12(in, reinterpret_cast<float *>(out->data()), samples, 2048, 2048, 1.0f / 2048);
+  else if (format == "cf32")
+    iq::unpack_sc12(in, reinterpret_cast<std::complex<float> *>(out->data()), samples, 2048, 2048, 1.0f / 2048);
+}
+
+void measure(Run *run, const std::string &path, double warmup, double seconds) {
+  std::string error;
+  auto transport = iq::open_transport(path, iq::UsbOptions(), &error);
+  if (!transport) {
+    run->error = error;
+    return;
+  }
+  iq::Device device(run->device, std::move(transport));
+  if (!device.read_version(&run->firmware))
+    run->firmware = "unknown";
+  if (!device.start_streaming()) {
+    run->error = device.error();
+    return;
+  }
+
+  iq::Transport *t = device.transport();
+  std::vector<uint8_t> buf(run->read_size + iq::BLOCK_BYTES);
+  std::vector<uint8_t> converted(run->read_size / iq::SC12_BYTES * 8 + iq::BLOCK_SAMPLES * 8);
+  size_t have = 0;
+  std::vector<double> arrivals;  // seconds since the first counted block
+  Clock::time_point start = Clock::now(), counted;
+  bool counting = false;
+
+  while (true) {
+    Clock::time_point now = Clock::now();
+    if (!counting && now - start >= std::chrono::duration<double>(warmup)) {
+      counting = true;
+      counted = now;
+    }
+    if (counting && now - counted >= std::chrono::duration<double>(seconds))
+      break;
+
+    struct pollfd pfd = {t->fd(), POLLIN, 0};
+    if (poll(&pfd, 1, 1000) == 0) {
+      run->error = run->device + ": stream stalled";
+      break;
+    }
+    ssize_t n = t->read(buf.data() + have, run->read_size);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+      continue;
+    if (n <= 0) {
+      run->error = run->device + ": read: " + (n == 0 ? "device closed" : strerror(errno));
+      break;
+    }
+    have += n;
+    size_t blocks = have / iq::BLOCK_BYTES;
+    if (blocks == 0)
+      continue;
+    convert(run->format, buf.data(), blocks * iq::BLOCK_SAMPLES, &converted);
+    double at = std::chrono::duration<double>(Clock::now() - counted).count();
+    if (counting) {
+      for (size_t k = 0; k < blocks; k++)
+        arrivals.push_back(at);
+      run->blocks += blocks;
+    }
+    have -= blocks * iq::BLOCK_BYTES;
+    memmove(buf.data(), buf.data() + blocks * iq::BLOCK_BYTES, have);
+  }
+  device.stop_streaming();
+
+  run->seconds = seconds;
+  run->samples = run->blocks * iq::BLOCK_SAMPLES;
+  if (arrivals.size() < 2)
+    return;
+  double span = arrivals.back() - arrivals.front();
+  run->rate = span > 0 ? (arrivals.size() - 1) * iq::BLOCK_SAMPLES / span : 0;
+
+  for (size_t k = 1; k < arrivals.size(); k++)
+    run->interval_us.push_back((arrivals[k] - arrivals[k - 1]) * 1e6);
+
+  // an unpaced simulator runs as fast as it is read
+  double nominal = iq::BLOCK_SAMPLES / iq::SAMPLE_RATE;
+  run->paced = run->rate < 1.05 * iq::SAMPLE_RATE;
+  if (!run->paced)
+    return;
+  run->lost = std::max<int64_t>(0, std::llround(span / nominal) + 1 - int64_t(arrivals.size()));
+
+  // least-squares line through (i, arrival i), then delay above its lowest point
+  double n = arrivals.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (size_t k = 0; k < arrivals.size(); k++) {
+    sx += k;
+    sy += arrivals[k];
+    sxx += double(k) * k;
+    sxy += k * arrivals[k];
+  }
+  double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+  double icept = (sy - slope * sx) / n;
+  run->period_us = slope * 1e6;
+  double best = 1e9;
+  for (size_t k = 0; k < arrivals.size(); k++)
+    best = std::min(best, arrivals[k] - (icept + slope * k));
+  for (size_t k = 0; k < arrivals.size(); k++)
+    run->latency_us.push_back((arrivals[k] - (icept + slope * k) - best) * 1e6);
+}
+
+// pair k of the -A pattern; a reader off by a byte or two decodes pairs
+// that break the relation between I and Q
+uint16_t pattern_i(uint64_t k) { return k & 0xfff; }
+uint16_t pattern_q(uint16_t i) { return (7 * i + 1) & 0xfff; }
+
+int check_async_overflow() {
+  const uint64_t blocks = 1024, pairs = blocks * iq::BLOCK_SAMPLES;
+  char path[] = "/tmp/bench_stream.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  std::vector<uint8_t> raw(pairs * iq::SC12_BYTES);
+  for (uint64_t k = 0; k < pairs; k++) {
+    uint16_t i = pattern_i(k), q = pattern_q(i);
+    raw[3 * k] = i >> 4;
+    raw[3 * k + 1] = (i & 0xf) << 4 | q >> 8;
+    raw[3 * k + 2] = q & 0xff;
+  }
+  bool written = ::write(fd, raw.data(), raw.size()) == ssize_t(raw.size());
+  close(fd);
+
+  std::string error = written ? "" : std::string(path) + ": short write";
+  uint64_t received = 0, broken = 0, dropped = 0;
+  bool hung_up = false;
+  if (written) {
+    auto transport = iq::open_transport(std::string("sim:replay=") + path + ",fast,async=32768,ring=65536",
+                                        iq::UsbOptions(), &error);
+    if (transport) {
+      iq::Device device("sim-async", std::move(transport));
+      std::string version;
+      if (!device.read_version(&version) || !device.start_streaming())
+        error = device.error();
+      iq::Transport *t = device.transport();
+      uint8_t buf[1000 + 2];
+      size_t have = 0;
+      while (error.empty()) {
+        struct pollfd pfd = {t->fd(), POLLIN, 0};
+        if (poll(&pfd, 1, 2000) == 0) {
+          error = "no hangup after the replay ended";
+          break;
+        }
+        ssize_t n = t->read(buf + have, 1000);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+          continue;
+        if (n <= 0) {
+          hung_up = n == 0;
+          if (!hung_up)
+            error = std::string("read: ") + strerror(errno);
+          break;
+        }
+        have += n;
+        size_t k = 0;
+        for (; k + iq::SC12_BYTES <= have; k += iq::SC12_BYTES, received++) {
+          uint16_t i = buf[k] << 4 | buf[k + 1] >> 4, q = (buf[k + 1] & 0xf) << 8 | buf[k + 2];
+          broken += q != pattern_q(i);
+        }
+        have -= k;
+        memmove(buf, buf + k, have);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+      dropped = t->dropped_bytes();
+      if (error.empty() && have != 0)
+        error = std::to_string(have) + " bytes of a torn pair at the end";
+    }
+  }
+  unlink(path);
+
+  if (error.empty() && broken > 0)
+    error = std::to_string(broken) + " pairs off the 3-byte boundary";
+  if (error.empty() && (dropped == 0 || dropped % iq::SC12_BYTES != 0))
+    error = "dropped " + std::to_string(dropped) + " bytes, not a non-zero number of whole pairs";
+  if (error.empty() && received + dropped / iq::SC12_BYTES != pairs)
+    error = "read " + std::to_string(received) + " pairs and dropped " + std::to_string(dropped / iq::SC12_BYTES) +
+            " of " + std::to_string(pairs);
+  printf("async overflow: %llu pairs read, %llu dropped, %s: %s\n", (unsigned long long)received,
+         (unsigned long long)(dropped / iq::SC12_BYTES), hung_up ? "hung up" : "no hangup",
+         error.empty() ? "ok" : ("FAIL: " + error).c_str());
+  return error.empty() ? 0 : 1;
+}
+
+std::string json_stats(const std::vector<double> &v) {
+  char out[256];
+  snprintf(out, sizeof(out), "{\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f, \"stddev\": %.1f}",
+           percentile(v, 0.5), percentile(v, 0.9), percentile(v, 0.99), percentile(v, 0.999), percentile(v, 1),
+           stddev(v));
+  return out;
+}
+
+std::string to_json(const Run &r) {
+  char nums[512];
+  snprintf(nums, sizeof(nums),
+           "\"read_size\": %zu, \"seconds\": %.3f, \"samples\": %llu, \"blocks\": %llu, \"rate\": %.1f, "
+           "\"rate_ppm\": %.1f, \"paced\": %s",
+           r.read_size, r.seconds, (unsigned long long)r.samples, (unsigned long long)r.blocks, r.rate,
+           (r.rate / iq::SAMPLE_RATE - 1) * 1e6, r.paced ? "true" : "false");
+  std::string s = "{\"device\": " + iq::json_quote(r.device) + ", \"transport\": " + iq::json_quote(r.transport) +
+                  ", \"format\": " + iq::json_quote(r.format) + ", \"firmware\": " + iq::json_quote(r.firmware) +
+                  ", " + nums;
+  if (r.paced && !r.interval_us.empty()) {
+    char loss[128];
+    snprintf(loss, sizeof(loss), ", \"lost_blocks\": %lld, \"period_us\": %.3f", (long long)r.lost, r.period_us);
+    s += loss;
+    s += ", \"interval_us\": " + json_stats(r.interval_us);
+    s += ", \"latency_us\": " + json_stats(r.latency_us);
+  }
+  if (!r.error.empty())
+    s += ", \"error\": " + iq::json_quote(r.error);
+  return s + "}";
+}
+
+std::vector<std::string> split(const std::string &list) {
+  std::vector<std::string> out;
+  size_t at = 0;
+  while (at <= list.size()) {
+    size_t comma = std::min(list.find(',', at), list.size());
+    if (comma > at)
+      out.push_back(list.substr(at, comma - at));
+    at = comma + 1;
+  }
+  return out;
+}
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-d DEVICE]... [-S SPEC] [-f FORMATS] [-r SIZES] [-s SECONDS] [-w SECONDS] [-o FILE]\n"
+          "       %s -A\n"
+          "  -d DEVICE   a module, as for iqd (default: sim, sim-async, sim-pty and sim-unix)\n"
+          "  -S SPEC     simulator spec for the sim devices (see host/simulator.h)\n"
+          "  -f FORMATS  comma-separated: sc12 (no conversion), s16, f32, cf32 (default s16,f32)\n"
+          "  -r SIZES    comma-separated read sizes in bytes (default 3072,65536)\n"
+          "  -s SECONDS  measured time per run (default 3)\n"
+          "  -w SECONDS  warm-up per run, not measured (default 0.5)\n"
+          "  -o FILE     write the results as json\n"
+          "  -A          check AsyncTransport's overflow path against the simulator and exit\n",
+          argv0, argv0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::string> devices;
+  std::string sim_spec, formats = "s16,f32", sizes = "3072,65536", json_path;
+  double seconds = 3, warmup = 0.5;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:S:f:r:s:w:o:Ah")) != -1) {
+    switch (opt) {
+      case 'A':
+        return check_async_overflow();
+      case 'd':
+        devices.push_back(optarg);
+        break;
+      case 'S':
+        sim_spec = optarg;
+        break;
+      case 'f':
+        formats = optarg;
+        break;
+      case 'r':
+        sizes = optarg;
+        break;
+      case 's':
+        seconds = strtod(optarg, nullptr);
+        break;
+      case 'w':
+        warmup = strtod(optarg, nullptr);
+        break;
+      case 'o':
+        json_path = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || seconds <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (devices.empty())
+    devices = {"sim", "sim-async", "sim-pty", "sim-unix"};
+
+  iq::SimConfig sim_config;
+  std::string error;
+  if (!iq::parse_sim_spec(sim_spec, &sim_config, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  for (const std::string &f : split(formats)) {
+    if (f != "sc12" && f != "s16" && f != "f32" && f != "cf32") {
+      fprintf(stderr, "unknown format '%s'\n", f.c_str());
+      return 1;
+    }
+  }
+
+  std::vector<Run> runs;
+  printf("%-10s %-10s %-5s %6s %10s %6s %9s %9s %9s %9s %9s\n", "device", "transport", "fmt", "read", "rate",
+         "lost", "jit sd", "int p99", "lat p50", "lat p99", "lat max");
+  for (const std::string &d : devices) {
+    for (const std::string &f : split(formats)) {
+      for (const std::string &size : split(sizes)) {
+        Run run;
+        run.device = d;
+        run.format = f;
+        run.read_size = std::max<size_t>(strtoul(size.c_str(), nullptr, 0), 1);
+
+        // the simulated modules get a fresh simulator per run
+        std::string path = d;
+        std::unique_ptr<SimServer> server;
+        if (d == "sim-pty" || d == "sim-unix") {
+          server = std::make_unique<SimServer>();
+          if (!server->start(d.substr(4), sim_config, &path, &run.error)) {
+            fprintf(stderr, "%s\n", run.error.c_str());
+            return 1;
+          }
+        } else if (d == "sim") {
+          path = "sim:" + sim_spec;
+        } else if (d == "sim-async") {
+          path = "sim:async," + sim_spec;
+        }
+        run.transport = d == "sim-pty" ? "pty" : transport_kind(path);
+
+        measure(&run, path, warmup, seconds);
+        server.reset();
+        if (!run.error.empty())
+          fprintf(stderr, "%s\n", run.error.c_str());
+
+        if (run.paced)
+          printf("%-10s %-10s %-5s %6zu %10.0f %6lld %9.1f %9.1f %9.1f %9.1f %9.1f\n", d.c_str(),
+                 run.transport.c_str(), f.c_str(), run.read_size, run.rate, (long long)run.lost,
+                 stddev(run.interval_us), percentile(run.interval_us, 0.99), percentile(run.latency_us, 0.5),
+                 percentile(run.latency_us, 0.99), percentile(run.latency_us, 1));
+        else
+          printf("%-10s %-10s %-5s %6zu %10.0f   (unpaced)\n", d.c_str(), run.transport.c_str(), f.c_str(),
+                 run.read_size, run.rate);
+        fflush(stdout);
+        runs.push_back(std::move(run));
+      }
+    }
+  }
+  printf("(rate in samples/s; jitter, intervals and latency in us)\n");
+
+  bool failed = false;
+  for (const Run &r : runs)
+    failed |= !r.error.empty();
+
+  if (!json_path.empty()) {
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    char nominal[32];
+    snprintf(nominal, sizeof(nominal), "%.0f", iq::SAMPLE_RATE);
+    std::string out = "{\"benchmark\": \"bench_stream\", \"host\": " + iq::json_quote(host) +
+                      ", \"nominal_rate\": " + nominal + ", \"runs\": [\n";
+    for (size_t k = 0; k < runs.size(); k++)
+      out += "  " + to_json(runs[k]) + (k + 1 < runs.size() ? ",\n" : "\n");
+    out += "]}\n";
+    FILE *f = fopen(json_path.c_str(), "w");
+    if (!f || fwrite(out.data(), 1, out.size(), f) != out.size() || fclose(f) != 0) {
+      perror(json_path.c_str());
+      return 1;
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+// sc12 unpack benchmark, with a bit-exact check of every kernel against the
+// decode loop in stream-iq.py
+//
+//   bench_unpack [-m MBYTES]
+//   bench_unpack -c output.iq stream.sc16   check a real capture against the
+//                                           sc16 stream-iq.py wrote for it
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "unpack.h"
+
+namespace {
+
+// transcription of the python loop:
+//   I = (data[0]<<4) | (data[1]>>4)
+//   Q = ((data[1]&0xf)<<8) | data[2]
+void python_decode(const uint8_t *data, size_t len, std::vector<uint16_t> &shorts_out) {
+  shorts_out.clear();
+  for (size_t k = 0; k + 3 <= len; k += 3) {
+    shorts_out.push_back((data[k] << 4) | (data[k + 1] >> 4));
+    shorts_out.push_back(((data[k + 1] & 0xf) << 8) | data[k + 2]);
+  }
+}
+
+std::vector<uint8_t> read_file(const char *path) {
+  std::vector<uint8_t> data;
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    exit(1);
+  }
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return data;
+}
+
+int check_capture(const char *raw_path, const char *sc16_path) {
+  auto raw = read_file(raw_path);
+  auto ref = read_file(sc16_path);
+  size_t samples = std::min(raw.size() / 3, ref.size() / 4);
+  std::vector<int16_t> out(samples * 2);
+
+  int failed = 0;
+  size_t count;
+  const iq::UnpackKernel *kernels = iq::unpack_kernels(&count);
+  for (size_t k = 0; k < count; k++) {
+    if (!kernels[k].supported())
+      continue;
+    kernels[k].s16(raw.data(), out.data(), samples, 0, 0, 0);
+    bool ok = memcmp(out.data(), ref.data(), samples * 4) == 0;
+    printf("%-8s %zu samples %s\n", kernels[k].name, samples, ok ? "match" : "MISMATCH");
+    failed += !ok;
+  }
+  return failed ? 1 : 0;
+}
+
+template <typename F>
+double best_of(int runs, F f) {
+  double best = 1e9;
+  for (int k = 0; k < runs; k++) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t mbytes = 48;
+  int opt;
+  while ((opt = getopt(argc, argv, "m:c:h")) != -1) {
+    switch (opt) {
+      case 'm':
+        mbytes = strtoul(optarg, nullptr, 0);
+        break;
+      case 'c':
+        if (optind >= argc) {
+          fprintf(stderr, "-c needs RAW.iq and REF.sc16\n");
+          return 1;
+        }
+        return check_capture(optarg, argv[optind]);
+      default:
+        fprintf(stderr, "usage: %s [-m MBYTES] | -c RAW.iq REF.sc16\n", argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  size_t samples = mbytes * 1000000 / 3;
+  std::vector<uint8_t> in(samples * 3);
+  std::mt19937 rng(42);
+  for (auto &b : in) b = rng();
+
+  std::vector<uint16_t> reference;
+  python_decode(in.data(), in.size(), reference);
+
+  std::vector<int16_t> s16(samples * 2), s16_ref(samples * 2);
+  std::vector<float> f32(samples * 2), f32_ref(samples * 2);
+  std::vector<std::complex<float>> cf32(samples);
+
+  size_t count;
+  const iq::UnpackKernel *kernels = iq::unpack_kernels(&count);
+  const iq::UnpackKernel &scalar = kernels[0];
+  const float dc_i = 2047.25f, dc_q = 2050.5f, scale = 1.0f / 2048;
+  scalar.s16(in.data(), s16_ref.data(), samples, 2048, 2048, 4);
+  scalar.f32(in.data(), f32_ref.data(), samples, dc_i, dc_q, scale);
+
+  int failed = 0;
+  printf("%-8s %-14s %10s %10s %s\n", "kernel", "format", "MB/s in", "Msample/s", "check");
+  for (size_t k = 0; k < count; k++) {
+    const iq::UnpackKernel &kern = kernels[k];
+    if (!kern.supported()) {
+      printf("%-8s (not supported on this cpu)\n", kern.name);
+      continue;
+    }
+    iq::unpack_use(kern.name);
+
+    // every length and alignment of the vector loops' tails
+    bool tails_ok = true;
+    for (size_t n = 0; n < 48; n++) {
+      std::vector<int16_t> a(n * 2 + 1, 0x5a5a), b(n * 2 + 1, 0x5a5a);
+      kern.s16(in.data() + 3, a.data(), n, 2048, 2048, 4);
+      scalar.s16(in.data() + 3, b.data(), n, 2048, 2048, 4);
+      tails_ok &= a == b;
+    }
+
+    struct {
+      const char *format;
+      double seconds;
+      bool ok;
+    } results[] = {
+      {"s16 raw", best_of(5, [&] { iq::unpack_sc12(in.data(), s16.data(), samples); }),
+       memcmp(s16.data(), reference.data(), samples * 4) == 0 && tails_ok},
+      {"s16 dc+shift", best_of(5, [&] { iq::unpack_sc12(in.data(), s16.data(), samples, 2048, 2048, 4); }),
+       s16 == s16_ref},
+      {"f32 dc+scale", best_of(5, [&] { iq::unpack_sc12(in.data(), f32.data(), samples, dc_i, dc_q, scale); }),
+       memcmp(f32.data(), f32_ref.data(), samples * 8) == 0},
+      {"cf32 dc+scale", best_of(5, [&] { iq::unpack_sc12(in.data(), cf32.data(), samples, dc_i, dc_q, scale); }),
+       memcmp(cf32.data(), f32_ref.data(), samples * 8) == 0},
+    };
+
+    for (auto &r : results) {
+      printf("%-8s %-14s %10.0f %10.0f %s\n", kern.name, r.format, in.size() / r.seconds / 1e6,
+             samples / r.seconds / 1e6, r.ok ? "bit-exact" : "MISMATCH");
+      failed += !r.ok;
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,27 @@
+// unit of sc16 data passed from a device's reader to its outputs
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "protocol.h"
+
+namespace iq {
+
+struct Block {
+  uint64_t seq;      // block number since the stream started
+  uint64_t time_ns;  // CLOCK_REALTIME when the block was completed
+  uint32_t samples;  // i/q pairs in iq; BLOCK_SAMPLES except for the last block
+  int16_t iq[2 * BLOCK_SAMPLES];
+};
+
+// what an output may want to record about the stream it is fed
+struct StreamInfo {
+  std::string device_id;  // stable module id (usb serial) where known
+  std::string firmware;   // READ_VERSION string, or "unknown"
+  double sample_rate = SAMPLE_RATE;
+  uint32_t gain = 0;      // front-end gain stage; 0 = the module's fixed gain
+};
+
+}  // namespace iq
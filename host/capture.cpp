@@ -0,0 +1,227 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "capture.h"
+#include "unpack.h"
+
+namespace iq {
+
+namespace {
+
+size_t payload_size(CaptureFormat format, size_t samples) {
+  return samples * (format == CAPTURE_SC12 ? SC12_BYTES : 2 * sizeof(int16_t));
+}
+
+void copy_string(char *dst, size_t size, const std::string &src) {
+  memset(dst, 0, size);
+  memcpy(dst, src.data(), std::min(src.size(), size - 1));
+}
+
+// the firmware's app_pack_block() (src/app.c), from signed samples
+void pack_sc12(const int16_t *iq, uint8_t *out, size_t samples) {
+  for (size_t k = 0; k < samples; k++) {
+    uint16_t i = iq[2 * k] & 0xfff, q = iq[2 * k + 1] & 0xfff;
+    out[3 * k] = i >> 4;
+    out[3 * k + 1] = (i & 0xf) << 4 | q >> 8;
+    out[3 * k + 2] = q & 0xff;
+  }
+}
+
+class CaptureSink : public Sink {
+ public:
+  explicit CaptureSink(std::string name) : name_(std::move(name)) {}
+
+  CaptureWriter &writer() { return writer_; }
+
+  // raw bytes carry no block boundaries to index
+  bool write(const void *, size_t) override { return false; }
+  bool write_block(const Block &block) override { return writer_.write(block); }
+  const std::string &name() const override { return name_; }
+
+ private:
+  std::string name_;
+  CaptureWriter writer_;
+};
+
+}  // namespace
+
+bool CaptureWriter::open(const std::string &path, CaptureFormat format, const StreamInfo &info,
+                         std::string *error, const RecordOptions &options) {
+  path_ = path;
+  options_ = options;
+
+  memcpy(header_.magic, CAPTURE_MAGIC, sizeof(header_.magic));
+  header_.version = CAPTURE_VERSION;
+  header_.header_size = CAPTURE_HEADER_SIZE;
+  header_.format = format;
+  header_.block_samples = BLOCK_SAMPLES;
+  header_.record_size = sizeof(CaptureRecord) + payload_size(format, BLOCK_SAMPLES);
+  header_.gain = info.gain;
+  header_.sample_rate = info.sample_rate;
+  copy_string(header_.device_id, sizeof(header_.device_id), info.device_id);
+  copy_string(header_.firmware, sizeof(header_.firmware), info.firmware);
+  record_.resize(header_.record_size);
+  return start_file(error);
+}
+
+bool CaptureWriter::start_file(std::string *error) {
+  bool rotating = options_.rotate_bytes > 0 || options_.rotate_seconds > 0;
+  if (!recorder_.open(rotating ? rotated_path(path_, files_) : path_, options_, error))
+    return false;
+  files_++;
+  header_.start_ns = 0;
+  header_.blocks = 0;
+  header_.dropped = 0;
+
+  // the header goes out first so a capture cut short is still recognisable
+  std::vector<uint8_t> head(CAPTURE_HEADER_SIZE, 0);
+  memcpy(head.data(), &header_, sizeof(header_));
+  return recorder_.append(head.data(), head.size());
+}
+
+bool CaptureWriter::write(const Block &block) {
+  if (!recorder_.is_open())
+    return false;
+
+  // rotate on record boundaries, so every file stands alone
+  if (header_.blocks > 0 &&
+      ((options_.rotate_bytes > 0 && recorder_.size() + header_.record_size > options_.rotate_bytes) ||
+       (options_.rotate_seconds > 0 && block.time_ns - header_.start_ns >= options_.rotate_seconds * 1e9))) {
+    if (!close() || !start_file(&error_))
+      return false;
+  }
+
+  if (header_.blocks == 0)
+    header_.start_ns = block.time_ns;
+
+  CaptureRecord rec = {};
+  rec.seq = block.seq;
+  rec.time_ns = block.time_ns;
+  rec.samples = block.samples;
+  rec.dropped = block.seq - next_seq_;
+  header_.dropped += rec.dropped;
+  header_.blocks++;
+  next_seq_ = block.seq + 1;
+
+  // short last blocks still take a whole record so offsets stay computable
+  uint8_t *p = record_.data();
+  memcpy(p, &rec, sizeof(rec));
+  memset(p + sizeof(rec), 0, header_.record_size - sizeof(rec));
+  if (header_.format == CAPTURE_SC12)
+    pack_sc12(block.iq, p + sizeof(rec), block.samples);
+  else
+    memcpy(p + sizeof(rec), block.iq, payload_size(CAPTURE_SC16, block.samples));
+  if (!recorder_.append(p, header_.record_size)) {
+    error_ = recorder_.error();
+    return false;
+  }
+  return true;
+}
+
+bool CaptureWriter::close() {
+  if (!recorder_.is_open())
+    return true;
+  bool ok = recorder_.close(&header_, sizeof(header_));
+  if (!ok)
+    error_ = recorder_.error();
+  return ok;
+}
+
+CaptureReader::~CaptureReader() {
+  if (map_)
+    munmap(const_cast<uint8_t *>(map_), size_);
+}
+
+bool CaptureReader::open(const std::string &path, std::string *error) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    *error = path + ": " + strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)CAPTURE_HEADER_SIZE) {
+    *error = path + ": not a capture file";
+    ::close(fd);
+    return false;
+  }
+  size_ = st.st_size;
+  void *map = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    *error = path + ": mmap: " + strerror(errno);
+    return false;
+  }
+  map_ = static_cast<const uint8_t *>(map);
+  header_ = reinterpret_cast<const CaptureHeader *>(map_);
+
+  const CaptureHeader &h = *header_;
+  if (memcmp(h.magic, CAPTURE_MAGIC, sizeof(h.magic)) != 0) {
+    *error = path + ": not a capture file";
+    return false;
+  }
+  if (h.version != CAPTURE_VERSION || h.header_size < sizeof(CaptureHeader) ||
+      (h.format != CAPTURE_SC12 && h.format != CAPTURE_SC16) || h.block_samples == 0 ||
+      h.record_size != sizeof(CaptureRecord) + payload_size(CaptureFormat(h.format), h.block_samples)) {
+    *error = path + ": unsupported capture version or layout";
+    return false;
+  }
+  blocks_ = size_ >= h.header_size ? (size_ - h.header_size) / h.record_size : 0;
+  return true;
+}
+
+const CaptureRecord &CaptureReader::record(uint64_t k) const {
+  return *reinterpret_cast<const CaptureRecord *>(map_ + header_->header_size + k * header_->record_size);
+}
+
+uint64_t CaptureReader::seek_time(uint64_t time_ns) const {
+  uint64_t lo = 0, hi = blocks_;
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (record(mid).time_ns < time_ns)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+uint64_t CaptureReader::seek_seq(uint64_t seq) const {
+  uint64_t lo = 0, hi = blocks_;
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (record(mid).seq < seq)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+size_t CaptureReader::read(uint64_t k, int16_t *out) const {
+  size_t samples = std::min(record(k).samples, header_->block_samples);
+  if (header_->format == CAPTURE_SC12)
+    unpack_sc12(payload(k), out, samples);
+  else
+    memcpy(out, payload(k), payload_size(CAPTURE_SC16, samples));
+  return samples;
+}
+
+std::unique_ptr<Sink> open_capture_sink(const std::string &spec, CaptureFormat format, const StreamInfo &info,
+                                        std::string *error) {
+  std::string path;
+  RecordOptions options;
+  if (!parse_record_spec(spec, &path, &options, error))
+    return nullptr;
+  auto sink = std::make_unique<CaptureSink>("capture:" + path);
+  if (!sink->writer().open(path, format, info, error, options))
+    return nullptr;
+  return sink;
+}
+
+}  // namespace iq
@@ -0,0 +1,127 @@
+// indexed capture files
+//
+// a capture is a 4 KiB header followed by fixed-size records, one per block:
+//
+//   CaptureHeader | CaptureRecord payload | CaptureRecord payload | ...
+//
+// every record carries the block's sequence number, completion time and the
+// number of blocks lost just before it, so the records themselves are the
+// index: record k sits at header_size + k * record_size, and seeking by time
+// or sequence number is a binary search over an mmap of the file. a capture
+// cut short by a crash stays readable up to its last whole record.
+//
+// all fields are little-endian.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block.h"
+#include "recorder.h"
+#include "sink.h"
+
+namespace iq {
+
+enum CaptureFormat : uint32_t {
+  CAPTURE_SC12 = 1,  // 3 bytes per i/q pair, as sent by the firmware
+  CAPTURE_SC16 = 2,  // int16 i, int16 q (0..4095)
+};
+
+constexpr char CAPTURE_MAGIC[8] = {'I', 'Q', 'C', 'A', 'P', '\r', '\n', 0x1a};
+constexpr uint32_t CAPTURE_VERSION = 1;
+constexpr uint32_t CAPTURE_HEADER_SIZE = 4096;
+
+struct CaptureHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;    // offset of the first record
+  uint32_t format;         // CaptureFormat
+  uint32_t block_samples;  // i/q pairs per record
+  uint32_t record_size;    // sizeof(CaptureRecord) + payload
+  uint32_t gain;           // front-end gain stage; 0 = the module's fixed gain
+  double sample_rate;      // i/q pairs per second
+  uint64_t start_ns;       // time_ns of the first record
+  uint64_t blocks;         // records, filled in on close (0 after a crash)
+  uint64_t dropped;        // blocks lost, filled in on close
+  char device_id[64];
+  char firmware[64];
+};
+
+struct CaptureRecord {
+  uint64_t seq;      // Block::seq
+  uint64_t time_ns;  // Block::time_ns
+  uint32_t samples;  // valid pairs; below block_samples only in the last record
+  uint32_t dropped;  // blocks lost between the previous record and this one
+};
+
+static_assert(sizeof(CaptureRecord) == 24, "record header layout");
+
+// records go out through a Recorder (see recorder.h). with rotation set,
+// each file is a complete capture of its own, named by rotated_path(), and
+// a new one is started on the record that would cross the size or time limit.
+class CaptureWriter {
+ public:
+  ~CaptureWriter() { close(); }
+
+  bool open(const std::string &path, CaptureFormat format, const StreamInfo &info, std::string *error,
+            const RecordOptions &options = RecordOptions());
+  bool write(const Block &block);
+  // write out and fill in the header's totals
+  bool close();
+
+  // of the current file
+  uint64_t blocks() const { return header_.blocks; }
+  uint64_t dropped() const { return header_.dropped; }
+  const std::string &error() const { return error_; }
+
+ private:
+  bool start_file(std::string *error);
+
+  Recorder recorder_;
+  RecordOptions options_;
+  CaptureHeader header_ = {};
+  std::vector<uint8_t> record_;
+  uint64_t next_seq_ = 0;
+  unsigned files_ = 0;
+  std::string path_;
+  std::string error_;
+};
+
+class CaptureReader {
+ public:
+  ~CaptureReader();
+
+  bool open(const std::string &path, std::string *error);
+
+  const CaptureHeader &header() const { return *header_; }
+  // whole records in the file, whatever the header says
+  uint64_t blocks() const { return blocks_; }
+
+  const CaptureRecord &record(uint64_t k) const;
+  const uint8_t *payload(uint64_t k) const { return reinterpret_cast<const uint8_t *>(&record(k) + 1); }
+
+  // first record completed at or after time_ns / with seq at or after seq;
+  // blocks() if there is none. time_ns follows the host's wall clock, so a
+  // clock step backwards mid-capture makes time seeks approximate there.
+  uint64_t seek_time(uint64_t time_ns) const;
+  uint64_t seek_seq(uint64_t seq) const;
+
+  // record k as sc16; returns its i/q pairs
+  size_t read(uint64_t k, int16_t *out) const;
+
+ private:
+  const uint8_t *map_ = nullptr;
+  size_t size_ = 0;
+  const CaptureHeader *header_ = nullptr;
+  uint64_t blocks_ = 0;
+};
+
+// "capture:PATH[,OPTION]..." outputs; see parse_record_spec() for options
+std::unique_ptr<Sink> open_capture_sink(const std::string &spec, CaptureFormat format, const StreamInfo &info,
+                                        std::string *error);
+
+}  // namespace iq
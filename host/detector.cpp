@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cmath>
+
+#include "detector.h"
+
+namespace iq {
+
+Detector::Detector(const DetectorConfig &config)
+    : config_(config),
+      fft_(BLOCK_SAMPLES),
+      window_(BLOCK_SAMPLES),
+      spectrum_(BLOCK_SAMPLES),
+      power_(BLOCK_SAMPLES),
+      threshold_(BLOCK_SAMPLES),
+      hits_(BLOCK_SAMPLES) {
+  cfar_ = {};
+  cfar_.variant = config.variant;
+  cfar_.train = config.train;
+  cfar_.guard = config.guard;
+  cfar_.rank = config.train * 3 / 2;
+  cfar_.flags = CFAR_CIRCULAR;
+  // cell averaging over n exponential cells: pfa = (1 + scale / n)^-n
+  double n = 2.0 * config.train;
+  cfar_.scale = n * (std::pow(config.pfa, -1.0 / n) - 1);
+  scratch_.resize(std::max<size_t>(1, CFAR_SCRATCH_SIZE(&cfar_)));
+
+  for (size_t k = 0; k < BLOCK_SAMPLES; k++)
+    window_[k] = 0.5f - 0.5f * std::cos(2 * M_PI * k / BLOCK_SAMPLES);
+}
+
+double Detector::bin_hz(uint32_t bin) const {
+  int32_t signed_bin = bin < BLOCK_SAMPLES / 2 ? int32_t(bin) : int32_t(bin) - int32_t(BLOCK_SAMPLES);
+  return signed_bin * config_.sample_rate / BLOCK_SAMPLES;
+}
+
+bool Detector::process(const Block &block, Detection *detection) {
+  if (block.samples != BLOCK_SAMPLES)
+    return false;
+
+  // remove the block mean first so the window does not smear dc into the doppler bins
+  double mean_i = 0, mean_q = 0;
+  for (size_t k = 0; k < BLOCK_SAMPLES; k++) {
+    mean_i += block.iq[2 * k];
+    mean_q += block.iq[2 * k + 1];
+  }
+  mean_i /= BLOCK_SAMPLES;
+  mean_q /= BLOCK_SAMPLES;
+  for (size_t k = 0; k < BLOCK_SAMPLES; k++)
+    spectrum_[k] = {float((block.iq[2 * k] - mean_i) * window_[k]), float((block.iq[2 * k + 1] - mean_q) * window_[k])};
+
+  fft_.forward(spectrum_.data());
+  cfar_power(reinterpret_cast<const float *>(spectrum_.data()), power_.data(), BLOCK_SAMPLES);
+  uint32_t count = cfar_run(&cfar_, power_.data(), BLOCK_SAMPLES, threshold_.data(), hits_.data(), hits_.size(),
+                            scratch_.data());
+
+  Detection d = {};
+  d.seq = block.seq;
+  float peak = 0;
+  uint32_t peak_bin = 0;
+  for (uint32_t k = 0; k < std::min<uint32_t>(count, hits_.size()); k++) {
+    uint32_t bin = hits_[k];
+    uint32_t from_dc = std::min(bin, uint32_t(BLOCK_SAMPLES) - bin);
+    if (from_dc <= config_.dc_bins)
+      continue;
+    double hz = bin_hz(bin);
+    d.low_hz = d.hits == 0 ? hz : std::min(d.low_hz, hz);
+    d.high_hz = d.hits == 0 ? hz : std::max(d.high_hz, hz);
+    d.hits++;
+    if (power_[bin] > peak) {
+      peak = power_[bin];
+      peak_bin = bin;
+    }
+  }
+  if (d.hits == 0)
+    return false;
+
+  d.peak_hz = bin_hz(peak_bin);
+  d.snr_db = 10 * std::log10(power_[peak_bin] * cfar_.scale / std::max(threshold_[peak_bin], 1e-30f));
+  *detection = d;
+  return true;
+}
+
+}  // namespace iq
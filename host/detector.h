@@ -0,0 +1,55 @@
+// per-block doppler detector: hann window, fft, then the firmware's cfar
+// kernel (src/cfar.c) over the circular spectrum
+
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "block.h"
+#include "cfar.h"
+#include "fft.h"
+
+namespace iq {
+
+struct DetectorConfig {
+  uint32_t variant = CFAR_CA;
+  uint32_t train = 16;
+  uint32_t guard = 4;
+  double pfa = 1e-8;         // per cell; sets the cfar scale
+  uint32_t dc_bins = 2;      // ignore +-dc_bins around 0 Hz (static clutter)
+  double sample_rate = SAMPLE_RATE;
+};
+
+struct Detection {
+  uint64_t seq;       // block
+  uint32_t hits;      // cells above threshold
+  double peak_hz;     // strongest hit, signed doppler frequency
+  double low_hz;      // span of all hits
+  double high_hz;
+  double snr_db;      // peak power over its threshold's noise estimate
+};
+
+class Detector {
+ public:
+  explicit Detector(const DetectorConfig &config = DetectorConfig());
+
+  // false when nothing in the block crossed the threshold
+  bool process(const Block &block, Detection *detection);
+
+ private:
+  double bin_hz(uint32_t bin) const;
+
+  DetectorConfig config_;
+  cfar_config_t cfar_;
+  Fft fft_;
+  std::vector<float> window_;
+  std::vector<std::complex<float>> spectrum_;
+  std::vector<float> power_;
+  std::vector<float> threshold_;
+  std::vector<float> scratch_;
+  std::vector<uint32_t> hits_;
+};
+
+}  // namespace iq
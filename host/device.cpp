@@ -0,0 +1,150 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "device.h"
+#include "simulator.h"
+
+namespace iq {
+
+namespace {
+
+int remaining_ms(std::chrono::steady_clock::time_point deadline) {
+  auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+  return left.count() > 0 ? left.count() : 0;
+}
+
+}  // namespace
+
+Device::Device(std::string name, std::unique_ptr<Transport> transport)
+    : name_(std::move(name)), transport_(std::move(transport)) {}
+
+bool Device::write_all(const void *buf, size_t len, int timeout_ms) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  const uint8_t *p = static_cast<const uint8_t *>(buf);
+  while (len > 0) {
+    ssize_t n = transport_->write(p, len);
+    if (n > 0) {
+      p += n;
+      len -= n;
+      continue;
+    }
+    if (n < 0 && errno != EAGAIN && errno != EINTR) {
+      error_ = name_ + ": write: " + strerror(errno);
+      return false;
+    }
+    struct pollfd pfd = {transport_->fd(), POLLOUT, 0};
+    if (poll(&pfd, 1, remaining_ms(deadline)) == 0) {
+      error_ = name_ + ": write timed out";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Device::read_exact(void *buf, size_t len, int timeout_ms) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  uint8_t *p = static_cast<uint8_t *>(buf);
+  while (len > 0) {
+    ssize_t n = transport_->read(p, len);
+    if (n > 0) {
+      p += n;
+      len -= n;
+      continue;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+      error_ = name_ + ": read: " + (n == 0 ? "device closed" : strerror(errno));
+      return false;
+    }
+    struct pollfd pfd = {transport_->fd(), POLLIN, 0};
+    if (poll(&pfd, 1, remaining_ms(deadline)) == 0) {
+      error_ = name_ + ": response timed out";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Device::send(uint32_t cmd_code, std::initializer_list<uint32_t> args, int timeout_ms) {
+  std::vector<uint32_t> words;
+  words.push_back(cmd_code);
+  words.insert(words.end(), args.begin(), args.end());
+  return write_all(words.data(), words.size() * sizeof(uint32_t), timeout_ms);
+}
+
+bool Device::command(uint32_t cmd_code, std::initializer_list<uint32_t> args, int timeout_ms, void *reply,
+                     size_t reply_len) {
+  if (!send(cmd_code, args, timeout_ms))
+    return false;
+
+  uint32_t response[2];
+  if (!read_exact(response, sizeof(response), timeout_ms))
+    return false;
+  if (response[0] != cmd_code || response[1] != 0) {
+    char msg[96];
+    snprintf(msg, sizeof(msg), ": command 0x%x failed (0x%x, status %u)", cmd_code, response[0], response[1]);
+    error_ = name_ + msg;
+    return false;
+  }
+  return reply_len == 0 || read_exact(reply, reply_len, timeout_ms);
+}
+
+bool Device::configure_gpio(uint32_t group, uint32_t pin, uint32_t mode) {
+  // the firmware hands args[1] straight to gpio_init() as a pin mask
+  return command(CFG_GPIO_PIN, {group, 1u << pin, mode});
+}
+
+bool Device::read_version(std::string *version) {
+  // older firmware ignores unknown commands, so don't wait long
+  char reply[FW_VERSION_SIZE + 1] = {};
+  if (!command(READ_VERSION, {}, 200, reply, FW_VERSION_SIZE))
+    return false;
+  *version = reply;
+  return true;
+}
+
+bool Device::start_streaming(uint32_t read_cmd) {
+  return configure_gpio(GPIOA, 6, GPIO_ANALOG) &&
+         configure_gpio(GPIOA, 7, GPIO_ANALOG) &&
+         configure_gpio(GPIOB, 0, GPIO_ANALOG) &&
+         configure_gpio(GPIOB, 1, GPIO_ANALOG) &&
+         command(CFG_DMA) &&
+         command(CFG_ADC) &&
+         command(TRIGGER_ADC) &&
+         send(read_cmd);
+}
+
+bool Device::stop_streaming(int quiet_ms, int timeout_ms) {
+  if (!send(READ_PROFILE))
+    return false;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  uint8_t buf[65536];
+  while (remaining_ms(deadline) > 0) {
+    struct pollfd pfd = {transport_->fd(), POLLIN, 0};
+    if (poll(&pfd, 1, quiet_ms) == 0)
+      return true;
+    ssize_t n = transport_->read(buf, sizeof(buf));
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+      error_ = name_ + ": read: " + (n == 0 ? "device closed" : strerror(errno));
+      return false;
+    }
+  }
+  error_ = name_ + ": still streaming after READ_PROFILE";
+  return false;
+}
+
+std::unique_ptr<Transport> open_transport(const std::string &path, const UsbOptions &usb, std::string *error) {
+  if (path.compare(0, 3, "usb") == 0)
+    return open_usb(path, usb, error);
+  if (path == "sim" || path.compare(0, 4, "sim:") == 0)
+    return open_sim(path, error);
+  if (path.compare(0, 5, "unix:") == 0)
+    return open_unix(path.substr(5), error);
+  return open_tty(path, error);
+}
+
+}  // namespace iq
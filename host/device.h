@@ -0,0 +1,60 @@
+// radar module command client
+
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+
+#include "protocol.h"
+#include "transport.h"
+#include "usb.h"
+
+namespace iq {
+
+class Device {
+ public:
+  Device(std::string name, std::unique_ptr<Transport> transport);
+
+  const std::string &name() const { return name_; }
+  const std::string &error() const { return error_; }
+  Transport *transport() { return transport_.get(); }
+  int fd() const { return transport_->fd(); }
+
+  // send a command and wait for its (cmd_code, status) response, followed
+  // by reply_len bytes of payload for commands that return data
+  bool command(uint32_t cmd_code, std::initializer_list<uint32_t> args = {}, int timeout_ms = 500,
+               void *reply = nullptr, size_t reply_len = 0);
+
+  // send a command that has no response (READ_ADC and friends)
+  bool send(uint32_t cmd_code, std::initializer_list<uint32_t> args = {}, int timeout_ms = 500);
+
+  bool configure_gpio(uint32_t group, uint32_t pin, uint32_t mode);
+
+  // firmware build (git describe); false on firmware that predates READ_VERSION
+  bool read_version(std::string *version);
+
+  // adc pins, dma, adc and trigger; then READ_ADC (or read_cmd) starts the
+  // stream
+  bool start_streaming(uint32_t read_cmd = READ_ADC);
+
+  // end a stream without a reset (READ_PROFILE while streaming) and discard
+  // what was in flight, until the module has been quiet for quiet_ms; false
+  // if it is still sending after timeout_ms (firmware that predates this)
+  bool stop_streaming(int quiet_ms = 200, int timeout_ms = 2000);
+
+ private:
+  bool write_all(const void *buf, size_t len, int timeout_ms);
+  bool read_exact(void *buf, size_t len, int timeout_ms);
+
+  std::string name_;
+  std::unique_ptr<Transport> transport_;
+  std::string error_;
+};
+
+// a -d argument: a tty path, "usb[:SERIAL|:BUS-PORT]", "sim[:SPEC]" or
+// "unix:PATH"
+std::unique_ptr<Transport> open_transport(const std::string &path, const UsbOptions &usb, std::string *error);
+
+}  // namespace iq
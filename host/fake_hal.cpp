@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "fake_hal.h"
+#include "prof.h"
+
+namespace iq {
+
+void FakeHal::reset() {
+  rx.clear();
+  dma_configured = adc_configured = adc_triggered = false;
+  std::fill(gpio_pins, gpio_pins + 2, 0);
+  std::fill(gpio_levels, gpio_levels + 2, 0);
+  block_ready = false;
+  last_block = 0;
+}
+
+FakeHal &fake_hal() {
+  static FakeHal hal;
+  return hal;
+}
+
+}  // namespace iq
+
+using iq::fake_hal;
+
+extern "C" {
+
+void hal_init(void) { fake_hal().reset(); }
+
+int hal_gpio_config(uint32_t group, uint32_t pins, uint32_t mode) {
+  (void)mode;
+  if (group > 1)
+    return 1;
+  fake_hal().gpio_pins[group] |= pins;
+  return 0;
+}
+
+int hal_gpio_write(uint32_t group, uint32_t pins, uint32_t level) {
+  if (group > 1)
+    return 1;
+  uint32_t &levels = fake_hal().gpio_levels[group];
+  levels = level ? levels | pins : levels & ~pins;
+  return 0;
+}
+
+void hal_dma_config(void) { fake_hal().dma_configured = true; }
+
+void hal_adc_config(void) { fake_hal().adc_configured = true; }
+
+void hal_adc_trigger(void) { fake_hal().adc_triggered = true; }
+
+const volatile uint16_t (*hal_adc_block(void))[2] {
+  iq::FakeHal &hal = fake_hal();
+  if (!hal.block_ready && hal.dma_configured && hal.adc_configured && hal.adc_triggered && hal.adc &&
+      hal.adc(hal.block, HAL_ADC_BLOCK_PAIRS)) {
+    // where the dma interrupt would be
+    uint32_t now = hal_cycles();
+    if (hal.last_block)
+      prof_record(PROF_DMA_PERIOD, now - hal.last_block);
+    hal.last_block = now;
+    hal.block_ready = true;
+  }
+  return hal.block_ready ? hal.block : nullptr;
+}
+
+void hal_adc_release(void) { fake_hal().block_ready = false; }
+
+uint16_t hal_usb_read(uint8_t *buf) {
+  iq::FakeHal &hal = fake_hal();
+  if (hal.rx.empty())
+    return 0;
+  size_t len = std::min<size_t>(hal.rx.front().size(), HAL_USB_PACKET_SIZE);
+  std::copy_n(hal.rx.front().data(), len, buf);
+  hal.rx.pop_front();
+  return len;
+}
+
+int hal_usb_write(const uint8_t *buf, uint16_t len) {
+  iq::FakeHal &hal = fake_hal();
+  return hal.tx && !hal.tx(buf, len);
+}
+
+void hal_cycles_init(void) {}
+
+uint32_t hal_cycles(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint32_t hal_cycles_hz(void) { return 1000000000; }
+
+}  // extern "C"
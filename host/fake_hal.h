@@ -0,0 +1,58 @@
+// fake adc, dma and usb drivers behind src/hal.h, so the firmware's own
+// command handling, packing and dsp (src/app.c and the modules it calls)
+// run natively, under a debugger, perf, the sanitizers or a fuzzer:
+//
+//   iq::FakeHal &hal = iq::fake_hal();
+//   hal.tx = [&](const uint8_t *p, size_t n) { out.insert(out.end(), p, p + n); return true; };
+//   hal.adc = [&](uint16_t (*pairs)[2], size_t n) { ...; return true; };
+//   hal.rx.push_back(packet);
+//   app_poll();
+//
+// the firmware keeps its state in globals, so there is one fake board per
+// process.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "hal.h"
+
+namespace iq {
+
+struct FakeHal {
+  // usb, host to module: one command per packet, as the cdc endpoint hands
+  // them over; longer packets are cut to HAL_USB_PACKET_SIZE
+  std::deque<std::vector<uint8_t>> rx;
+
+  // usb, module to host. returning false leaves the endpoint busy: the
+  // firmware retries, or under READ_TRIGGERED tries again next block
+  std::function<bool(const uint8_t *data, size_t len)> tx;
+
+  // the adc and dma: fill the next block of raw 12-bit pairs, or return
+  // false while it is not due yet. only asked for once CFG_DMA, CFG_ADC and
+  // TRIGGER_ADC have all run, since only then does the dma on the module
+  std::function<bool(uint16_t (*pairs)[2], size_t count)> adc;
+
+  // what the firmware has set up
+  bool dma_configured = false;
+  bool adc_configured = false;
+  bool adc_triggered = false;
+  uint32_t gpio_pins[2] = {};    // pins configured, per group
+  uint32_t gpio_levels[2] = {};  // output levels, per group
+
+  // the block the firmware holds, between hal_adc_block and hal_adc_release
+  uint16_t block[HAL_ADC_BLOCK_PAIRS][2] = {};
+  bool block_ready = false;
+  uint32_t last_block = 0;  // hal_cycles when it completed
+
+  // power-on state; the callbacks are kept
+  void reset();
+};
+
+FakeHal &fake_hal();
+
+}  // namespace iq
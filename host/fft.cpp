@@ -0,0 +1,41 @@
+#include <cmath>
+#include <utility>
+
+#include "fft.h"
+
+namespace iq {
+
+Fft::Fft(size_t n) : n_(n), twiddle_(n / 2), reverse_(n) {
+  for (size_t k = 0; k < n / 2; k++)
+    twiddle_[k] = std::polar(1.0f, float(-2 * M_PI * k / n));
+
+  size_t bits = 0;
+  while ((size_t(1) << bits) < n)
+    bits++;
+  for (size_t k = 0; k < n; k++) {
+    size_t r = 0;
+    for (size_t b = 0; b < bits; b++)
+      r |= ((k >> b) & 1) << (bits - 1 - b);
+    reverse_[k] = r;
+  }
+}
+
+void Fft::forward(std::complex<float> *x) const {
+  for (size_t k = 0; k < n_; k++) {
+    if (k < reverse_[k])
+      std::swap(x[k], x[reverse_[k]]);
+  }
+
+  for (size_t len = 2; len <= n_; len <<= 1) {
+    size_t half = len / 2, step = n_ / len;
+    for (size_t base = 0; base < n_; base += len) {
+      for (size_t k = 0; k < half; k++) {
+        std::complex<float> t = twiddle_[k * step] * x[base + k + half];
+        x[base + k + half] = x[base + k] - t;
+        x[base + k] += t;
+      }
+    }
+  }
+}
+
+}  // namespace iq
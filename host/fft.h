@@ -0,0 +1,31 @@
+// in-place radix-2 complex fft for the host tools
+//
+// no cmsis-dsp fft can be built from this sdk snapshot (it lacks
+// arm_common_tables.c), and the firmware runs none; the host only needs a
+// plain power-of-two transform.
+
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace iq {
+
+class Fft {
+ public:
+  // n must be a power of two
+  explicit Fft(size_t n);
+
+  size_t size() const { return n_; }
+
+  // forward transform, unnormalised
+  void forward(std::complex<float> *x) const;
+
+ private:
+  size_t n_;
+  std::vector<std::complex<float>> twiddle_;
+  std::vector<size_t> reverse_;
+};
+
+}  // namespace iq
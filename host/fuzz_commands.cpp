@@ -0,0 +1,124 @@
+// fuzz target: the firmware's command dispatch and streams (src/app.c) on
+// the fake drivers, fed arbitrary usb packets
+//
+// the input is a run of packets, each a length byte (mod 65) and that many
+// bytes. every packet is polled through as the main loop would, plus a few
+// stream steps while a READ_* is running, with the adc delivering blocks
+// derived from the input. beyond the sanitizers, it checks that replies
+// fit usb_buffer, that a command answered outside a stream is answered
+// with its own code, and that a CFG_GPIO_PIN too short to name its pins is
+// refused without touching them.
+//
+//   make fuzz; ./build/fuzz/fuzz_commands build/fuzz/corpus/commands
+
+#include <string.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "app.h"
+#include "clutter.h"
+#include "fake_hal.h"
+#include "prof.h"
+#include "protocol.h"
+#include "trigger.h"
+
+namespace {
+
+constexpr size_t USB_BUFFER_SIZE = 4096;  // app.c's usb_buffer
+constexpr int STREAM_STEPS = 3;
+
+#define CHECK(x) \
+  if (!(x))      \
+  __builtin_trap()
+
+struct State {
+  uint32_t expect = 0;  // command code the next reply must carry, or 0
+  size_t replies = 0;
+  uint32_t last_status = 0;
+  uint32_t seed = 1;
+};
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  iq::FakeHal &hal = iq::fake_hal();
+  State state;
+  state.seed = 0x9E3779B9u ^ uint32_t(size);
+
+  // power-on state, as far as the modules allow it
+  hal_init();
+  app_init();
+  clutter_config(CLUTTER_RESET, CLUTTER_DEFAULT_SHIFT);
+  trigger_config(0xffffffff, 4, 16);
+  prof_reset();
+
+  hal.tx = [&](const uint8_t *p, size_t len) {
+    CHECK(len <= USB_BUFFER_SIZE);
+    if (state.expect) {
+      uint32_t code, status;
+      CHECK(len >= 8);
+      memcpy(&code, p, 4);
+      memcpy(&status, p + 4, 4);
+      CHECK(code == state.expect);
+      state.last_status = status;
+      state.replies++;
+    }
+    return true;
+  };
+  // loud and quiet blocks, so the trigger and clutter paths both run
+  hal.adc = [&](uint16_t (*pairs)[2], size_t count) {
+    uint32_t amp = (state.seed >> 8) & 1 ? 2000 : 20;
+    for (size_t k = 0; k < count; k++) {
+      state.seed = state.seed * 1664525u + 1013904223u;
+      pairs[k][0] = (2048 + (state.seed >> 20) % (2 * amp + 1) - amp) & 0xfff;
+      pairs[k][1] = (2048 + (state.seed >> 8) % (2 * amp + 1) - amp) & 0xfff;
+    }
+    return true;
+  };
+
+  size_t at = 0;
+  while (at < size) {
+    size_t len = data[at++] % (HAL_USB_PACKET_SIZE + 1);
+    len = std::min(len, size - at);
+    std::vector<uint8_t> packet(data + at, data + at + len);
+    at += len;
+
+    uint32_t code = 0;
+    if (len >= 4)
+      memcpy(&code, packet.data(), 4);
+    // BENCH_CFAR takes no arguments and only costs time
+    if (code == iq::BENCH_CFAR)
+      continue;
+
+    bool commanding = !app_streaming() && len >= 4;
+    bool replies = code == iq::CFG_GPIO_PIN || code == iq::CFG_DMA || code == iq::CFG_ADC ||
+                   code == iq::TRIGGER_ADC || code == iq::CFG_CLUTTER || code == iq::CFG_TRIGGER ||
+                   code == iq::READ_VERSION || code == iq::READ_PROFILE;
+    state.expect = commanding && replies ? code : 0;
+    state.replies = 0;
+    uint32_t pins[2] = {hal.gpio_pins[0], hal.gpio_pins[1]};
+
+    hal.rx.push_back(std::move(packet));
+    app_poll();
+    CHECK(hal.rx.empty() || app_streaming());
+    if (state.expect) {
+      CHECK(state.replies == 1);
+      if (code == iq::CFG_GPIO_PIN && len < 16) {
+        CHECK(state.last_status != 0);
+        CHECK(hal.gpio_pins[0] == pins[0] && hal.gpio_pins[1] == pins[1]);
+      }
+    }
+    state.expect = 0;
+
+    for (int k = 0; k < STREAM_STEPS && app_streaming(); k++)
+      app_poll();
+    hal.rx.clear();
+  }
+
+  hal.tx = nullptr;
+  hal.adc = nullptr;
+  return 0;
+}
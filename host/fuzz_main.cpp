@@ -0,0 +1,248 @@
+// stand-in for libfuzzer's main, for compilers without -fsanitize=fuzzer
+// (gcc): runs a fuzz target over its corpus, then over random mutations of
+// it. there is no coverage feedback, so it finds less than libfuzzer does,
+// but the targets and their sanitizer checks are the same. takes
+// libfuzzer's options, so `make fuzz` runs the same either way:
+//
+//   fuzz_TARGET [-runs=N] [-max_len=N] [-seed=N] [-artifact_prefix=DIR/] CORPUS...
+//
+// with -runs=0, or given only files, just the inputs are run (a regression
+// check, or a crash again). an input that crashes is written to crash-HASH.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+extern "C" void __sanitizer_set_death_callback(void (*callback)(void)) __attribute__((weak));
+
+// gcc's ubsan exits without the death callback; make it abort instead,
+// which on_signal sees
+extern "C" const char *__ubsan_default_options() { return "abort_on_error=1:print_stacktrace=1"; }
+
+namespace {
+
+// the input being run, for the crash handlers
+const uint8_t *current_data;
+size_t current_size;
+char artifact_prefix[1024] = "./";
+
+// async-signal-safe: writes the input to crash-FNV1A
+void dump_input() {
+  static volatile sig_atomic_t dumped = 0;
+  if (dumped || !current_data)
+    return;
+  dumped = 1;
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t k = 0; k < current_size; k++)
+    hash = (hash ^ current_data[k]) * 1099511628211ull;
+
+  char path[sizeof(artifact_prefix) + 32];
+  size_t n = strlen(artifact_prefix);
+  memcpy(path, artifact_prefix, n);
+  memcpy(path + n, "crash-", 6);
+  n += 6;
+  for (int k = 15; k >= 0; k--)
+    path[n++] = "0123456789abcdef"[hash >> (4 * k) & 0xf];
+  path[n] = 0;
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0) {
+    for (size_t at = 0; at < current_size;) {
+      ssize_t w = write(fd, current_data + at, current_size - at);
+      if (w <= 0)
+        break;
+      at += w;
+    }
+    close(fd);
+    const char msg[] = "fuzz: crashing input written to ";
+    (void)!write(2, msg, sizeof(msg) - 1);
+    (void)!write(2, path, n);
+    (void)!write(2, "\n", 1);
+  }
+}
+
+// the targets' checks trap (SIGILL), which the sanitizers leave alone
+void on_signal(int sig) {
+  dump_input();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+bool read_file(const std::string &path, std::vector<uint8_t> *data) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  uint8_t buf[65536];
+  size_t n;
+  data->clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    data->insert(data->end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+// files, and the files in directories (not recursively)
+bool load_corpus(const std::string &path, std::vector<std::vector<uint8_t>> *corpus, bool *dirs) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    perror(path.c_str());
+    return false;
+  }
+  std::vector<uint8_t> data;
+  if (!S_ISDIR(st.st_mode)) {
+    if (!read_file(path, &data)) {
+      perror(path.c_str());
+      return false;
+    }
+    corpus->push_back(std::move(data));
+    return true;
+  }
+  *dirs = true;
+  DIR *dir = opendir(path.c_str());
+  if (!dir) {
+    perror(path.c_str());
+    return false;
+  }
+  while (struct dirent *e = readdir(dir)) {
+    std::string file = path + "/" + e->d_name;
+    if (e->d_name[0] != '.' && stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+        read_file(file, &data))
+      corpus->push_back(std::move(data));
+  }
+  closedir(dir);
+  return true;
+}
+
+// one of libfuzzer's simpler mutations, at random
+void mutate(std::vector<uint8_t> *data, const std::vector<std::vector<uint8_t>> &corpus,
+            size_t max_len, std::mt19937 &rng) {
+  auto pick = [&](size_t n) { return n ? size_t(rng() % n) : 0; };
+  switch (rng() % 7) {
+    case 0:  // flip a bit
+      if (!data->empty())
+        (*data)[pick(data->size())] ^= 1 << (rng() % 8);
+      break;
+    case 1:  // set a byte, often to an edge value
+      if (!data->empty()) {
+        static const uint8_t edges[] = {0x00, 0x01, 0x0f, 0x10, 0x7f, 0x80, 0xfe, 0xff};
+        (*data)[pick(data->size())] = rng() % 2 ? edges[rng() % sizeof(edges)] : uint8_t(rng());
+      }
+      break;
+    case 2:  // insert random bytes
+      data->insert(data->begin() + pick(data->size() + 1), 1 + rng() % 8, uint8_t(rng()));
+      break;
+    case 3:  // erase a run
+      if (!data->empty()) {
+        size_t at = pick(data->size());
+        data->erase(data->begin() + at, data->begin() + at + 1 + pick(data->size() - at));
+      }
+      break;
+    case 4:  // duplicate a run
+      if (!data->empty()) {
+        size_t at = pick(data->size()), n = 1 + pick(std::min<size_t>(data->size() - at, 64));
+        std::vector<uint8_t> run(data->begin() + at, data->begin() + at + n);
+        data->insert(data->begin() + pick(data->size() + 1), run.begin(), run.end());
+      }
+      break;
+    case 5: {  // splice in part of another input
+      const std::vector<uint8_t> &other = corpus[pick(corpus.size())];
+      if (!other.empty()) {
+        size_t at = pick(other.size()), n = 1 + pick(other.size() - at);
+        data->insert(data->begin() + pick(data->size() + 1), other.begin() + at, other.begin() + at + n);
+      }
+      break;
+    }
+    default: {  // overwrite a 32-bit word, as command arguments are
+      if (data->size() >= 4) {
+        uint32_t v = rng() % 2 ? rng() : rng() % 64;
+        memcpy(data->data() + pick(data->size() - 3), &v, 4);
+      }
+      break;
+    }
+  }
+  if (data->size() > max_len)
+    data->resize(max_len);
+}
+
+void run(const std::vector<uint8_t> &data) {
+  // a copy of exactly the input's size, so reads past it are caught
+  uint8_t *copy = static_cast<uint8_t *>(malloc(data.size() ? data.size() : 1));
+  std::copy(data.begin(), data.end(), copy);
+  current_data = copy;
+  current_size = data.size();
+  LLVMFuzzerTestOneInput(copy, data.size());
+  current_data = nullptr;
+  free(copy);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  long runs = -1;
+  size_t max_len = 4096;
+  unsigned seed = std::random_device()();
+  std::vector<std::string> paths;
+  for (int k = 1; k < argc; k++) {
+    const char *a = argv[k];
+    if (!strncmp(a, "-runs=", 6)) {
+      runs = strtol(a + 6, nullptr, 10);
+    } else if (!strncmp(a, "-max_len=", 9)) {
+      max_len = strtoul(a + 9, nullptr, 10);
+    } else if (!strncmp(a, "-seed=", 6)) {
+      seed = strtoul(a + 6, nullptr, 10);
+    } else if (!strncmp(a, "-artifact_prefix=", 17)) {
+      snprintf(artifact_prefix, sizeof(artifact_prefix), "%s", a + 17);
+    } else if (a[0] == '-') {
+      fprintf(stderr, "%s: ignoring %s\n", argv[0], a);
+    } else {
+      paths.push_back(a);
+    }
+  }
+
+  if (__sanitizer_set_death_callback)
+    __sanitizer_set_death_callback(dump_input);
+  signal(SIGILL, on_signal);
+  signal(SIGABRT, on_signal);
+  signal(SIGFPE, on_signal);
+  signal(SIGSEGV, on_signal);
+
+  std::vector<std::vector<uint8_t>> corpus;
+  bool dirs = paths.empty();
+  for (const std::string &path : paths)
+    if (!load_corpus(path, &corpus, &dirs))
+      return 1;
+  if (!dirs && runs < 0)
+    runs = 0;
+  if (corpus.empty())
+    corpus.emplace_back();
+
+  for (const std::vector<uint8_t> &data : corpus)
+    run(data);
+  fprintf(stderr, "%s: %zu corpus inputs ok\n", argv[0], corpus.size());
+
+  // with no -runs, mutate until interrupted, as libfuzzer does
+  std::mt19937 rng(seed);
+  long done = 0;
+  for (; runs < 0 || done < runs; done++) {
+    std::vector<uint8_t> data = corpus[rng() % corpus.size()];
+    for (unsigned n = 1 + rng() % 4; n > 0; n--)
+      mutate(&data, corpus, max_len, rng);
+    run(data);
+    if ((done + 1) % 100000 == 0)
+      fprintf(stderr, "%s: %ld runs\n", argv[0], done + 1);
+  }
+  fprintf(stderr, "%s: %ld runs ok (seed %u)\n", argv[0], done, seed);
+  return 0;
+}
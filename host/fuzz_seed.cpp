@@ -0,0 +1,212 @@
+// seed corpora for the fuzz targets, from the host's own traffic
+//
+//   fuzz_seed -o DIR [RECORDING...]
+//
+// DIR/commands gets one input per host session (fuzz_commands.cpp's
+// format): the packets Device sends to set up and run each kind of stream,
+// recorded against the firmware simulator. DIR/stream gets slices of each
+// RECORDING (an iqd capture, sigmf dataset or raw sc12, as for replay=),
+// cut mid-block and mid-pair; without recordings, of the simulator's own
+// stream.
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "clutter.h"
+#include "device.h"
+#include "prof.h"
+#include "protocol.h"
+#include "replay.h"
+#include "transport.h"
+
+namespace {
+
+// what the host writes, one packet per write, and the first bytes it reads
+class RecordingTransport : public iq::Transport {
+ public:
+  RecordingTransport(std::unique_ptr<iq::Transport> inner, std::vector<std::vector<uint8_t>> *packets,
+                     std::vector<uint8_t> *stream)
+      : inner_(std::move(inner)), packets_(packets), stream_(stream) {}
+
+  int fd() const override { return inner_->fd(); }
+  ssize_t read(void *buf, size_t len) override {
+    ssize_t n = inner_->read(buf, len);
+    if (n > 0 && stream_->size() < STREAM_BYTES)
+      stream_->insert(stream_->end(), (uint8_t *)buf, (uint8_t *)buf + n);
+    return n;
+  }
+  ssize_t write(const void *buf, size_t len) override {
+    ssize_t n = inner_->write(buf, len);
+    if (n > 0)
+      packets_->emplace_back((const uint8_t *)buf, (const uint8_t *)buf + n);
+    return n;
+  }
+
+  static constexpr size_t STREAM_BYTES = 4 * iq::BLOCK_BYTES;
+
+ private:
+  std::unique_ptr<iq::Transport> inner_;
+  std::vector<std::vector<uint8_t>> *packets_;
+  std::vector<uint8_t> *stream_;
+};
+
+bool write_file(const std::string &path, const std::vector<uint8_t> &data) {
+  FILE *f = fopen(path.c_str(), "wb");
+  bool ok = f && fwrite(data.data(), 1, data.size(), f) == data.size();
+  if (f && fclose(f) != 0)
+    ok = false;
+  if (!ok)
+    perror(path.c_str());
+  return ok;
+}
+
+void drain(iq::Transport *t, int ms) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  uint8_t buf[65536];
+  while (std::chrono::steady_clock::now() < end) {
+    struct pollfd pfd = {t->fd(), POLLIN, 0};
+    if (poll(&pfd, 1, 20) > 0 && t->read(buf, sizeof(buf)) == 0)
+      return;
+  }
+}
+
+// a stream input: read-size seed, dc and shift, then the bytes
+std::vector<uint8_t> stream_input(uint16_t seed, const uint8_t *data, size_t len) {
+  std::vector<uint8_t> input = {uint8_t(seed), uint8_t(seed >> 8), uint8_t(0x80 + seed % 3),
+                                uint8_t(0x80 - seed % 5)};
+  input.insert(input.end(), data, data + len);
+  return input;
+}
+
+void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s -o DIR [RECORDING...]\n", argv0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string dir;
+  int opt;
+  while ((opt = getopt(argc, argv, "o:h")) != -1) {
+    switch (opt) {
+      case 'o':
+        dir = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (dir.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+  mkdir(dir.c_str(), 0755);
+  mkdir((dir + "/commands").c_str(), 0755);
+  mkdir((dir + "/stream").c_str(), 0755);
+
+  // one simulator session per kind of stream the host runs
+  struct Session {
+    const char *name;
+    uint32_t read_cmd;
+    bool clutter, trigger;
+  };
+  const Session sessions[] = {
+    {"adc", iq::READ_ADC, false, false},
+    {"clutter", iq::READ_ADC, true, false},
+    {"triggered", iq::READ_TRIGGERED, true, true},
+    {"vitals", iq::READ_VITALS, false, false},
+  };
+  std::vector<uint8_t> sim_stream;
+  for (const Session &s : sessions) {
+    std::string error;
+    std::unique_ptr<iq::Transport> t = iq::open_transport("sim:firmware,seed=1,target=1500@300", {}, &error);
+    if (!t) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    std::vector<std::vector<uint8_t>> packets;
+    std::vector<uint8_t> stream;
+    iq::Device device(s.name, std::make_unique<RecordingTransport>(std::move(t), &packets, &stream));
+
+    std::string version;
+    prof_report_t report;
+    bool ok = device.read_version(&version) &&
+              device.command(iq::READ_PROFILE, {PROF_RESET}, 500, &report, sizeof(report)) &&
+              (!s.clutter || device.command(iq::CFG_CLUTTER, {CLUTTER_ENABLE | CLUTTER_RESET, CLUTTER_DEFAULT_SHIFT})) &&
+              (!s.trigger || device.command(iq::CFG_TRIGGER, {25 * 16, 4, 16})) &&
+              device.start_streaming(s.read_cmd);
+    if (ok) {
+      drain(device.transport(), 50);
+      ok = device.stop_streaming(50);
+    }
+    ok = ok && device.command(iq::READ_PROFILE, {0}, 500, &report, sizeof(report));
+    if (!ok) {
+      fprintf(stderr, "%s: %s\n", s.name, device.error().c_str());
+      return 1;
+    }
+
+    std::vector<uint8_t> input;
+    for (const std::vector<uint8_t> &p : packets) {
+      input.push_back(uint8_t(std::min<size_t>(p.size(), HAL_USB_PACKET_SIZE)));
+      input.insert(input.end(), p.begin(), p.begin() + std::min<size_t>(p.size(), HAL_USB_PACKET_SIZE));
+    }
+    if (!write_file(dir + "/commands/" + s.name, input))
+      return 1;
+    if (s.read_cmd == iq::READ_ADC && sim_stream.empty())
+      sim_stream = stream;
+  }
+
+  // slices of two blocks and a bit, from the start and the middle
+  size_t seeds = 0;
+  auto add_slices = [&](const std::string &name, const std::vector<uint8_t> &bytes) {
+    size_t len = std::min<size_t>(bytes.size(), 2 * iq::BLOCK_BYTES + 2);
+    for (size_t at : {size_t(0), bytes.size() / 2 / iq::SC12_BYTES * iq::SC12_BYTES + 1}) {
+      if (at + len > bytes.size())
+        continue;
+      std::string path = dir + "/stream/" + name + "." + std::to_string(at);
+      if (!write_file(path, stream_input(uint16_t(seeds * 7919), bytes.data() + at, len)))
+        return false;
+      seeds++;
+    }
+    return true;
+  };
+  for (int k = optind; k < argc; k++) {
+    iq::Replay replay;
+    std::string error;
+    if (!replay.open(argv[k], &error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    // the first blocks and the middle ones, packed back to sc12
+    std::vector<uint8_t> bytes;
+    uint16_t pairs[iq::BLOCK_SAMPLES][2];
+    for (uint64_t b : {uint64_t(0), uint64_t(1), uint64_t(2), replay.blocks() / 2, replay.blocks() / 2 + 1}) {
+      if (b >= replay.blocks())
+        continue;
+      size_t n = replay.read(b, pairs);
+      for (size_t x = 0; x < n; x++) {
+        bytes.push_back(uint8_t(pairs[x][0] >> 4));
+        bytes.push_back(uint8_t((pairs[x][0] & 0xf) << 4 | pairs[x][1] >> 8));
+        bytes.push_back(uint8_t(pairs[x][1]));
+      }
+    }
+    std::string name = argv[k];
+    name = name.substr(name.find_last_of('/') + 1);
+    if (!add_slices(name, bytes))
+      return 1;
+  }
+  if (optind == argc && !add_slices("sim", sim_stream))
+    return 1;
+
+  printf("%zu command and %zu stream seeds in %s\n", std::size(sessions), seeds, dir.c_str());
+  return 0;
+}
@@ -0,0 +1,118 @@
+// fuzz target: the host's sc12 stream decoding, i.e. a Pipeline cutting
+// whatever the reader hands it into blocks, and the unpack kernels under it
+//
+// the first bytes of the input pick the read sizes, the dc and the shift;
+// the rest is the stream. the pipeline's blocks must be numbered in order,
+// be full but for the last, and hold exactly the scalar decode of the whole
+// pairs in the stream, however the reads split them. every kernel the cpu
+// supports must agree with scalar on the same bytes.
+//
+//   make fuzz; ./build/fuzz/fuzz_stream build/fuzz/corpus/stream
+
+#include <string.h>
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+#include "unpack.h"
+#include "worker_pool.h"
+
+namespace {
+
+#define CHECK(x) \
+  if (!(x))      \
+  __builtin_trap()
+
+class CollectSink : public iq::Sink {
+ public:
+  explicit CollectSink(std::vector<int16_t> *out) : out_(out) {}
+
+  bool write(const void *data, size_t len) override {
+    const int16_t *p = static_cast<const int16_t *>(data);
+    out_->insert(out_->end(), p, p + len / sizeof(int16_t));
+    return true;
+  }
+  bool write_block(const iq::Block &block) override {
+    CHECK(block.seq == blocks_);
+    CHECK(block.samples > 0 && block.samples <= iq::BLOCK_SAMPLES);
+    CHECK(!short_);  // only the last block may be short
+    short_ = block.samples < iq::BLOCK_SAMPLES;
+    blocks_++;
+    return write(block.iq, block.samples * 2 * sizeof(int16_t));
+  }
+  const std::string &name() const override { return name_; }
+
+ private:
+  std::vector<int16_t> *out_;
+  std::string name_ = "fuzz";
+  uint64_t blocks_ = 0;
+  bool short_ = false;
+};
+
+void decode(const uint8_t *in, size_t samples, int *out) {
+  for (size_t x = 0; x < samples; x++, in += iq::SC12_BYTES) {
+    out[2 * x] = in[0] << 4 | in[1] >> 4;
+    out[2 * x + 1] = (in[1] & 0xf) << 8 | in[2];
+  }
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static iq::WorkerPool pool(1);
+  if (size < 4)
+    return 0;
+  uint32_t seed = data[0] | data[1] << 8;
+  int16_t dc_i = data[2] << 4, dc_q = data[3] << 4;
+  int shift = data[2] % 5;
+  data += 4;
+  size -= 4;
+
+  size_t samples = size / iq::SC12_BYTES;
+  std::vector<int> ref(2 * samples);
+  decode(data, samples, ref.data());
+
+  // the pipeline, fed in reads of 1 to 8192 bytes
+  std::vector<int16_t> out;
+  {
+    iq::Pipeline pipeline("fuzz", &pool);
+    pipeline.add_output(std::make_unique<CollectSink>(&out), iq::OVERRUN_BLOCK, 4);
+    size_t at = 0;
+    while (at < size) {
+      seed = seed * 1664525u + 1013904223u;
+      size_t n = std::min<size_t>(seed >> 16 & (seed >> 31 ? 0x1fff : 0x7), size - at);
+      pipeline.feed(data + at, n ? n : 1);
+      at += n ? n : 1;
+    }
+    pipeline.finish();
+    CHECK(pipeline.samples() == samples);
+  }
+  CHECK(out.size() == 2 * samples);
+  for (size_t x = 0; x < out.size(); x++)
+    CHECK(out[x] == ref[x]);
+
+  // every kernel against scalar, with dc removal and scaling
+  size_t count;
+  const iq::UnpackKernel *kernels = iq::unpack_kernels(&count);
+  std::vector<int16_t> s16(2 * samples), want_s16(2 * samples);
+  std::vector<float> f32(2 * samples), want_f32(2 * samples);
+  float scale = 1.0f / float(1 << (shift + 8));
+  kernels[0].s16(data, want_s16.data(), samples, dc_i, dc_q, shift);
+  kernels[0].f32(data, want_f32.data(), samples, dc_i, dc_q, scale);
+  for (size_t x = 0; x < 2 * samples; x++)
+    CHECK(want_s16[x] == int16_t((ref[x] - (x & 1 ? dc_q : dc_i)) * (1 << shift)));
+  for (size_t k = 1; k < count; k++) {
+    if (!kernels[k].supported())
+      continue;
+    kernels[k].s16(data, s16.data(), samples, dc_i, dc_q, shift);
+    kernels[k].f32(data, f32.data(), samples, dc_i, dc_q, scale);
+    CHECK(memcmp(s16.data(), want_s16.data(), s16.size() * sizeof(int16_t)) == 0);
+    for (size_t x = 0; x < 2 * samples; x++)
+      CHECK(std::fabs(f32[x] - want_f32[x]) <= 1e-6f * std::fabs(want_f32[x]));
+  }
+  return 0;
+}
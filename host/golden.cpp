@@ -0,0 +1,813 @@
+// golden-vector regression suite for the dsp kernels the firmware and the
+// host share, or could move between them
+//
+//   golden [-d DIR] [-v]                                  check
+//   golden -u [-d DIR] [NAME=RECORDING[@BLOCK]]...         update
+//
+// the vectors are single sc12 blocks, DIR/NAME.sc12 (by default the
+// repository's golden/, wherever this is run from):
+// synthetic ones written once from the simulator and blocks cut from
+// recordings (an iqd capture, a sigmf dataset or output.iq, as for
+// replay=) with -u NAME=PATH@BLOCK. once written they never change.
+// DIR/expected.json holds what the kernels decided about each vector and
+// the tolerance for each kernel and number format; -u rewrites the
+// decisions from the host implementation after a deliberate change, and
+// keeps the tolerances.
+//
+// every kernel runs in each implementation there is: the host's, the
+// firmware's (src/, built for the host) and cmsis-dsp's (at32-sdk, built
+// for the host from its portable c; the cortex-m4 build takes its simd
+// paths instead). numeric outputs are held to a double-precision
+// reference and decisions to expected.json:
+//
+//   unpack       sc12 -> s16 and f32, every simd kernel, against exact
+//   dc           block mean: host estimate_dc (f32), firmware clutter (q16)
+//   energy       firmware clutter_energy (1/16 counts), against expected
+//   fft          host fft (f32) of the detector's windowed block. cmsis-dsp's
+//                ffts need arm_common_tables.c, which the sdk lacks.
+//   mag_squared  detector power: cfar_power host and cmsis f32, cmsis q31
+//                and q15 of the spectrum scaled to full scale
+//   cfar         ca, go and os hits over each power spectrum above, as
+//                cells differing from expected; q15's 3.13 power rounds the
+//                noise floor away, so its hits cannot match cell for cell
+//                and cfar_peak holds it to the decision instead: detected
+//                where expected is, at the strongest expected hit's bin
+//                (bins off, or N for a miss or a false alarm).
+//                cfar_threshold compares the cmsis build's thresholds with
+//                the host's
+//   detector     host detector: its detection exactly, snr in db
+//   biquad       the vitals band-passes: cmsis df2T f32, df1 q31 and q15
+//                with the firmware's coefficients, on a synthetic chest wall
+//
+// errors are relative to the reference's peak unless a unit is given
+// above. exits non-zero when any check is over its tolerance.
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "arm_math.h"
+#include "cfar.h"
+#include "clutter.h"
+#include "detector.h"
+#include "fft.h"
+#include "json.h"
+#include "protocol.h"
+#include "replay.h"
+#include "simulator.h"
+#include "unpack.h"
+#include "vitals.h"
+
+// src/cfar.c built a second time against cmsis-dsp (see the Makefile)
+extern "C" {
+void cfar_power_cmsis(const float *iq, float *power, uint32_t n);
+uint32_t cfar_run_cmsis(const struct cfar_config_t *cfg, const float *power, uint32_t n, float *threshold,
+                        uint32_t *hits, uint32_t max_hits, float *scratch);
+}
+
+// the repository's golden/, which the Makefile passes as an absolute path
+#ifndef GOLDEN_DIR
+#define GOLDEN_DIR "golden"
+#endif
+
+namespace {
+
+constexpr size_t N = iq::BLOCK_SAMPLES;
+
+// written once by -u, then frozen
+struct Synthetic {
+  const char *name;
+  const char *spec;
+};
+const Synthetic SYNTHETIC[] = {
+    {"noise", "seed=11"},
+    {"tone", "seed=12,target=5000@200"},
+    {"two_tones", "seed=13,target=-12000@300,target=3000@60"},
+    {"weak_near_dc", "seed=14,target=900@25"},
+    {"near_nyquist", "seed=15,target=140000@150"},
+    {"offset", "seed=16,dc=1900:2210,target=-40000@250"},
+    {"noisy", "seed=17,noise=60,target=20000@400"},
+    {"clipped", "seed=18,target=6000@2300"},
+};
+
+// used when expected.json has none yet
+const std::pair<const char *, double> DEFAULT_TOLERANCES[] = {
+    {"unpack.s16", 0},          {"unpack.f32", 0},          {"dc.f32", 1e-3},
+    {"dc.q16", 0.5},            {"energy.q4", 0},           {"fft.f32", 2e-6},
+    {"mag_squared.f32", 1e-6},  {"mag_squared.q31", 1e-8},  {"mag_squared.q15", 2.5e-4},
+    {"cfar.f32", 0},            {"cfar.q31", 0},            {"cfar_peak.q15", 1},
+    {"cfar_threshold.f32", 1e-6}, {"detector.f32", 0.01},   {"biquad.f32", 1e-5},
+    {"biquad.q31", 1e-4},       {"biquad.q15", 0.1},
+};
+
+const char *const VARIANTS[] = {"ca", "go", "os"};
+
+struct Expected {
+  std::string name;
+  std::string source;
+  uint32_t energy = 0;
+  std::vector<uint32_t> hits[3];
+  bool detected = false;
+  iq::Detection detection = {};
+};
+
+// one row of the report: the worst error over every vector
+struct Check {
+  std::string kernel, format, impl;
+  double worst = 0;
+  std::string where;
+  bool ran = false;
+};
+
+class Report {
+ public:
+  explicit Report(bool verbose) : verbose_(verbose) {}
+
+  std::vector<std::pair<std::string, double>> tolerances;
+
+  void record(const std::string &vector, const std::string &kernel, const std::string &format,
+              const std::string &impl, double error) {
+    Check *c = nullptr;
+    for (auto &k : checks_)
+      if (k.kernel == kernel && k.format == format && k.impl == impl)
+        c = &k;
+    if (!c) {
+      checks_.push_back({kernel, format, impl});
+      c = &checks_.back();
+    }
+    if (!c->ran || !(error <= c->worst)) {
+      c->worst = error;
+      c->where = vector;
+    }
+    c->ran = true;
+    if (verbose_)
+      printf("  %-14s %-14s %-4s %-8s %12.4g%s\n", vector.c_str(), kernel.c_str(), format.c_str(), impl.c_str(),
+             error, error <= tolerance(kernel, format) ? "" : "  over");
+  }
+
+  double tolerance(const std::string &kernel, const std::string &format) const {
+    for (auto &t : tolerances)
+      if (t.first == kernel + "." + format)
+        return t.second;
+    return -1;
+  }
+
+  // false if anything was over its tolerance
+  bool print() const {
+    bool ok = true;
+    printf("%-14s %-4s %-8s %12s %12s  %-14s\n", "kernel", "fmt", "impl", "worst", "tolerance", "vector");
+    for (auto &c : checks_) {
+      double tol = tolerance(c.kernel, c.format);
+      bool pass = tol >= 0 && c.worst <= tol;
+      ok &= pass;
+      printf("%-14s %-4s %-8s %12.4g %12.4g  %-14s %s\n", c.kernel.c_str(), c.format.c_str(), c.impl.c_str(),
+             c.worst, tol, c.where.c_str(), tol < 0 ? "no tolerance" : pass ? "ok" : "FAIL");
+    }
+    return ok;
+  }
+
+ private:
+  bool verbose_;
+  std::vector<Check> checks_;
+};
+
+void decode(const uint8_t *in, uint16_t (*pairs)[2]) {
+  for (size_t x = 0; x < N; x++, in += iq::SC12_BYTES) {
+    pairs[x][0] = in[0] << 4 | in[1] >> 4;
+    pairs[x][1] = (in[1] & 0xf) << 8 | in[2];
+  }
+}
+
+void encode(const uint16_t (*pairs)[2], uint8_t *out) {
+  for (size_t x = 0; x < N; x++, out += iq::SC12_BYTES) {
+    out[0] = pairs[x][0] >> 4;
+    out[1] = (pairs[x][0] & 0xf) << 4 | pairs[x][1] >> 8;
+    out[2] = pairs[x][1] & 0xff;
+  }
+}
+
+bool read_file(const std::string &path, std::string *out, std::string *error) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    *error = path + ": " + strerror(errno);
+    return false;
+  }
+  std::ostringstream s;
+  s << in.rdbuf();
+  *out = s.str();
+  return true;
+}
+
+bool write_file(const std::string &path, const void *data, size_t len, std::string *error) {
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f || fwrite(data, 1, len, f) != len || fclose(f) != 0) {
+    *error = path + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool load_vector(const std::string &dir, const std::string &name, std::vector<uint8_t> *out, std::string *error) {
+  std::string data;
+  if (!read_file(dir + "/" + name + ".sc12", &data, error))
+    return false;
+  if (data.size() != iq::BLOCK_BYTES) {
+    *error = dir + "/" + name + ".sc12: " + std::to_string(data.size()) + " bytes, not one block";
+    return false;
+  }
+  out->assign(data.begin(), data.end());
+  return true;
+}
+
+// the detector's cfar set-ups, one per variant
+cfar_config_t cfar_config(uint32_t variant) {
+  iq::DetectorConfig d;
+  cfar_config_t c = {};
+  c.variant = variant;
+  c.train = d.train;
+  c.guard = d.guard;
+  c.rank = d.train * 3 / 2;
+  c.flags = CFAR_CIRCULAR;
+  double n = 2.0 * d.train;
+  c.scale = n * (std::pow(d.pfa, -1.0 / n) - 1);
+  return c;
+}
+
+std::vector<uint32_t> cfar_hits(bool cmsis, uint32_t variant, const std::vector<float> &power,
+                                std::vector<float> *threshold = nullptr) {
+  cfar_config_t c = cfar_config(variant);
+  std::vector<float> t(N), scratch(std::max<size_t>(1, CFAR_SCRATCH_SIZE(&c)));
+  std::vector<uint32_t> hits(N);
+  uint32_t count = (cmsis ? cfar_run_cmsis : cfar_run)(&c, power.data(), N, t.data(), hits.data(), N, scratch.data());
+  hits.resize(std::min<uint32_t>(count, N));
+  if (threshold)
+    *threshold = t;
+  return hits;
+}
+
+// cells in one hit list and not the other
+double hit_difference(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b) {
+  std::vector<uint32_t> diff;
+  std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(diff));
+  return diff.size();
+}
+
+// bins between the strongest hits of two lists, circularly; N when only
+// one of them detected anything
+template <typename P, typename Q>
+double peak_offset(const std::vector<uint32_t> &a, const P &power_a, const std::vector<uint32_t> &b,
+                   const Q &power_b) {
+  if (a.empty() || b.empty())
+    return a.empty() == b.empty() ? 0 : N;
+  auto strongest = [](const std::vector<uint32_t> &hits, auto &power) {
+    return *std::max_element(hits.begin(), hits.end(), [&](uint32_t x, uint32_t y) { return power[x] < power[y]; });
+  };
+  uint32_t d = (strongest(a, power_a) - strongest(b, power_b)) % N;
+  return std::min<uint32_t>(d, N - d);
+}
+
+double peak(const std::vector<double> &v) {
+  double m = 0;
+  for (double x : v)
+    m = std::max(m, std::fabs(x));
+  return m;
+}
+
+// the detector's input: mean removed, hann windowed
+std::vector<std::complex<float>> windowed(const uint16_t (*pairs)[2]) {
+  double mean_i = 0, mean_q = 0;
+  for (size_t k = 0; k < N; k++) {
+    mean_i += pairs[k][0];
+    mean_q += pairs[k][1];
+  }
+  mean_i /= N;
+  mean_q /= N;
+  std::vector<std::complex<float>> x(N);
+  for (size_t k = 0; k < N; k++) {
+    float w = 0.5f - 0.5f * std::cos(2 * M_PI * k / N);
+    x[k] = {float((pairs[k][0] - mean_i) * w), float((pairs[k][1] - mean_q) * w)};
+  }
+  return x;
+}
+
+// the spectrum scaled so no component reaches 1, interleaved: the power
+// kernels' input in every format, so their outputs compare directly
+std::vector<float> full_scale(const std::vector<std::complex<float>> &x) {
+  double full = 0;
+  for (auto &c : x)
+    full = std::max({full, double(std::fabs(c.real())), double(std::fabs(c.imag()))});
+  float scale = float(1 / (std::max(full, 1e-30) * (1 + 1.0 / 1024)));
+  std::vector<float> scaled(2 * N);
+  for (size_t f = 0; f < N; f++) {
+    scaled[2 * f] = x[f].real() * scale;
+    scaled[2 * f + 1] = x[f].imag() * scale;
+  }
+  return scaled;
+}
+
+std::vector<std::complex<double>> dft(const std::vector<std::complex<float>> &x) {
+  std::vector<std::complex<double>> twiddle(N), out(N);
+  for (size_t k = 0; k < N; k++)
+    twiddle[k] = std::polar(1.0, -2 * M_PI * k / N);
+  for (size_t f = 0; f < N; f++) {
+    std::complex<double> sum = 0;
+    for (size_t k = 0; k < N; k++)
+      sum += std::complex<double>(x[k]) * twiddle[f * k % N];
+    out[f] = sum;
+  }
+  return out;
+}
+
+// everything the suite decides about a vector, from the host implementation
+Expected decide(const std::string &name, const std::string &source, const uint8_t *block) {
+  uint16_t pairs[N][2];
+  decode(block, pairs);
+  Expected e;
+  e.name = name;
+  e.source = source;
+
+  clutter_config(CLUTTER_RESET, CLUTTER_DEFAULT_SHIFT);
+  clutter_update(pairs, N);
+  e.energy = clutter_energy(pairs, N);
+
+  iq::Fft fft(N);
+  std::vector<std::complex<float>> x = windowed(pairs);
+  fft.forward(x.data());
+  std::vector<float> power(N);
+  cfar_power(full_scale(x).data(), power.data(), N);
+  for (uint32_t v = 0; v < 3; v++)
+    e.hits[v] = cfar_hits(false, v, power);
+
+  auto b = std::make_unique<iq::Block>();
+  b->seq = 0;
+  b->samples = N;
+  iq::unpack_sc12(block, b->iq, N);
+  iq::Detector detector;
+  e.detected = detector.process(*b, &e.detection);
+  return e;
+}
+
+void check_vector(const Expected &e, const uint8_t *block, Report *r) {
+  const std::string &v = e.name;
+  uint16_t pairs[N][2];
+  decode(block, pairs);
+
+  // unpack: every kernel the cpu has, against the exact values
+  size_t count;
+  const iq::UnpackKernel *kernels = iq::unpack_kernels(&count);
+  std::vector<int16_t> s16(2 * N);
+  std::vector<float> f32(2 * N);
+  for (size_t k = 0; k < count; k++) {
+    if (!kernels[k].supported())
+      continue;
+    kernels[k].s16(block, s16.data(), N, 2048, 2048, 4);
+    kernels[k].f32(block, f32.data(), N, 2048, 2048, 1.0f / 2048);
+    double es = 0, ef = 0;
+    for (size_t x = 0; x < 2 * N; x++) {
+      int raw = pairs[x / 2][x & 1];
+      es = std::max(es, std::fabs(s16[x] - double((raw - 2048) * 16)));
+      ef = std::max(ef, std::fabs(f32[x] - (raw - 2048) / 2048.0));
+    }
+    r->record(v, "unpack", "s16", kernels[k].name, es);
+    r->record(v, "unpack", "f32", kernels[k].name, ef);
+  }
+
+  // dc: the host's mean and the firmware's clutter estimate, in counts
+  double mean[2] = {0, 0};
+  for (size_t k = 0; k < N; k++) {
+    mean[0] += pairs[k][0];
+    mean[1] += pairs[k][1];
+  }
+  mean[0] /= N;
+  mean[1] /= N;
+  float dc_i, dc_q;
+  iq::estimate_dc(block, N, &dc_i, &dc_q);
+  r->record(v, "dc", "f32", "host", std::max(std::fabs(dc_i - mean[0]), std::fabs(dc_q - mean[1])));
+  clutter_config(CLUTTER_RESET, CLUTTER_DEFAULT_SHIFT);
+  clutter_update(pairs, N);
+  double fw = 0;
+  for (uint32_t ch = 0; ch < 2; ch++)
+    fw = std::max(fw, std::fabs(2048 - clutter_offset(ch) - mean[ch]));
+  r->record(v, "dc", "q16", "firmware", fw);
+  r->record(v, "energy", "q4", "firmware", std::fabs(double(clutter_energy(pairs, N)) - e.energy));
+
+  // fft
+  std::vector<std::complex<float>> x = windowed(pairs);
+  std::vector<std::complex<double>> ref = dft(x);
+  iq::Fft fft(N);
+  fft.forward(x.data());
+  std::vector<double> err(N), mag(N);
+  for (size_t f = 0; f < N; f++) {
+    err[f] = std::abs(std::complex<double>(x[f]) - ref[f]);
+    mag[f] = std::abs(ref[f]);
+  }
+  r->record(v, "fft", "f32", "host", peak(err) / std::max(peak(mag), 1e-30));
+
+  // power in each format
+  std::vector<float> scaled = full_scale(x);
+  std::vector<double> power_ref(N);
+  for (size_t f = 0; f < N; f++)
+    power_ref[f] = double(scaled[2 * f]) * scaled[2 * f] + double(scaled[2 * f + 1]) * scaled[2 * f + 1];
+  double power_peak = std::max(peak(power_ref), 1e-30);
+
+  std::vector<float> host(N), cmsis(N), p31(N), p15(N);
+  cfar_power(scaled.data(), host.data(), N);
+  cfar_power_cmsis(scaled.data(), cmsis.data(), N);
+  std::vector<q31_t> in31(2 * N), out31(N);
+  std::vector<q15_t> in15(2 * N), out15(N);
+  arm_float_to_q31(scaled.data(), in31.data(), 2 * N);
+  arm_cmplx_mag_squared_q31(in31.data(), out31.data(), N);
+  arm_float_to_q15(scaled.data(), in15.data(), 2 * N);
+  arm_cmplx_mag_squared_q15(in15.data(), out15.data(), N);
+  // errors from the fixed-point values themselves, not their float roundings
+  std::vector<double> e31(N), e15(N), e32(N), ecmsis(N);
+  for (size_t f = 0; f < N; f++) {
+    p31[f] = out31[f] / float(1 << 29);  // 3.29
+    p15[f] = out15[f] / float(1 << 13);  // 3.13
+    e31[f] = std::fabs(std::ldexp(out31[f], -29) - power_ref[f]);
+    e15[f] = std::fabs(std::ldexp(out15[f], -13) - power_ref[f]);
+    e32[f] = std::fabs(host[f] - power_ref[f]);
+    ecmsis[f] = std::fabs(cmsis[f] - power_ref[f]);
+  }
+  struct {
+    const char *format, *impl;
+    const std::vector<float> *power;
+    const std::vector<double> *error;
+  } powers[] = {{"f32", "host", &host, &e32},
+                {"f32", "cmsis", &cmsis, &ecmsis},
+                {"q31", "cmsis", &p31, &e31},
+                {"q15", "cmsis", &p15, &e15}};
+  for (auto &p : powers) {
+    r->record(v, "mag_squared", p.format, p.impl, peak(*p.error) / power_peak);
+
+    // cfar over that power
+    bool q15 = strcmp(p.format, "q15") == 0;
+    double diff = 0;
+    for (uint32_t variant = 0; variant < 3; variant++) {
+      std::vector<uint32_t> hits = cfar_hits(strcmp(p.impl, "cmsis") == 0, variant, *p.power);
+      diff = std::max(diff, q15 ? peak_offset(hits, *p.power, e.hits[variant], power_ref)
+                                : hit_difference(hits, e.hits[variant]));
+    }
+    r->record(v, q15 ? "cfar_peak" : "cfar", p.format, p.impl, diff);
+  }
+
+  // the cmsis build's thresholds over the same power as the host's
+  double worst = 0;
+  for (uint32_t variant = 0; variant < 3; variant++) {
+    std::vector<float> th_host, th_cmsis;
+    cfar_hits(false, variant, host, &th_host);
+    cfar_hits(true, variant, host, &th_cmsis);
+    for (size_t f = 0; f < N; f++)
+      worst = std::max(worst, double(std::fabs(th_cmsis[f] - th_host[f]) / std::max(std::fabs(th_host[f]), 1e-30f)));
+  }
+  r->record(v, "cfar_threshold", "f32", "cmsis", worst);
+
+  // the host detector's decision
+  auto b = std::make_unique<iq::Block>();
+  b->seq = 0;
+  b->samples = N;
+  iq::unpack_sc12(block, b->iq, N);
+  iq::Detector detector;
+  iq::Detection d = {};
+  bool detected = detector.process(*b, &d);
+  double derr = INFINITY;
+  if (detected == e.detected) {
+    const iq::Detection &w = e.detection;
+    derr = !detected ? 0
+           : d.hits == w.hits && d.peak_hz == w.peak_hz && d.low_hz == w.low_hz && d.high_hz == w.high_hz
+               ? std::fabs(d.snr_db - w.snr_db)
+               : INFINITY;
+  }
+  r->record(v, "detector", "f32", "host", derr);
+}
+
+// x in [-1, 1) as a saturated fixed-point value with `bits` fraction bits
+int64_t fixed(double x, int bits) {
+  double one = std::ldexp(1.0, bits);
+  return int64_t(std::min(std::max(std::round(x * one), -one), one - 1));
+}
+
+// the vitals band-passes on a chest wall at the vitals output rate:
+// breathing, a heartbeat, slow drift and sensor noise, within +-0.75
+void check_biquads(Report *r) {
+  const size_t n = 1200;
+  const double fs = VITALS_OUTPUT_RATE_HZ;
+  std::vector<float> in(n);
+  uint32_t seed = 1;
+  for (size_t k = 0; k < n; k++) {
+    double t = k / fs;
+    seed = seed * 1664525u + 1013904223u;
+    in[k] = float(0.35 * std::sin(2 * M_PI * 0.27 * t) + 0.08 * std::sin(2 * M_PI * 1.25 * t + 1) +
+                  0.2 * std::sin(2 * M_PI * 0.02 * t) + 0.02 * ((seed >> 8) / double(1 << 24) - 0.5));
+  }
+  const struct {
+    const char *name;
+    uint32_t band;
+  } bands[] = {{"breath", VITALS_BAND_BREATH}, {"heart", VITALS_BAND_HEART}};
+
+  for (auto &band : bands) {
+    float coeffs[10];
+    vitals_band_coeffs(band.band, coeffs);
+
+    // transposed direct form ii in double, as the firmware runs it
+    std::vector<double> ref(n);
+    double z[2][2] = {};
+    for (size_t k = 0; k < n; k++) {
+      double y = in[k];
+      for (int s = 0; s < 2; s++) {
+        const float *c = coeffs + 5 * s;
+        double x = y;
+        y = c[0] * x + z[s][0];
+        z[s][0] = c[1] * x + c[3] * y + z[s][1];
+        z[s][1] = c[2] * x + c[4] * y;
+      }
+      ref[k] = y;
+    }
+    double full = std::max(peak(ref), 1e-30);
+    auto error = [&](const std::vector<float> &out) {
+      double worst = 0;
+      for (size_t k = 0; k < n; k++)
+        worst = std::max(worst, std::fabs(out[k] - ref[k]));
+      return worst / full;
+    };
+    std::string vector = std::string("vitals_") + band.name;
+
+    std::vector<float> out(n), state(4);
+    arm_biquad_cascade_df2T_instance_f32 f;
+    arm_biquad_cascade_df2T_init_f32(&f, 2, coeffs, state.data());
+    arm_biquad_cascade_df2T_f32(&f, in.data(), out.data(), n);
+    r->record(vector, "biquad", "f32", "cmsis", error(out));
+
+    // the fixed-point forms take coefficients over 2^shift, shifted back
+    // after each stage's accumulate
+    int8_t shift = 0;
+    for (float c : coeffs)
+      while (std::fabs(c) >= (1 << shift))
+        shift++;
+    std::vector<q31_t> c31(10), in31(n), out31(n), s31(8);
+    for (size_t k = 0; k < 10; k++)
+      c31[k] = q31_t(fixed(coeffs[k] / (1 << shift), 31));
+    arm_float_to_q31(in.data(), in31.data(), n);
+    arm_biquad_casd_df1_inst_q31 f31;
+    arm_biquad_cascade_df1_init_q31(&f31, 2, c31.data(), s31.data(), shift);
+    arm_biquad_cascade_df1_q31(&f31, in31.data(), out31.data(), n);
+    arm_q31_to_float(out31.data(), out.data(), n);
+    r->record(vector, "biquad", "q31", "cmsis", error(out));
+
+    // {b0, 0, b1, b2, a1, a2} per stage
+    std::vector<q15_t> c15(12), in15(n), out15(n), s15(8);
+    for (size_t s = 0; s < 2; s++) {
+      const float *c = coeffs + 5 * s;
+      q15_t *q = c15.data() + 6 * s;
+      q[0] = q15_t(fixed(c[0] / (1 << shift), 15));
+      q[1] = 0;
+      for (size_t k = 1; k < 5; k++)
+        q[k + 1] = q15_t(fixed(c[k] / (1 << shift), 15));
+    }
+    arm_float_to_q15(in.data(), in15.data(), n);
+    arm_biquad_casd_df1_inst_q15 f15;
+    arm_biquad_cascade_df1_init_q15(&f15, 2, c15.data(), s15.data(), shift);
+    arm_biquad_cascade_df1_q15(&f15, in15.data(), out15.data(), n);
+    arm_q15_to_float(out15.data(), out.data(), n);
+    r->record(vector, "biquad", "q15", "cmsis", error(out));
+  }
+}
+
+std::string hits_json(const std::vector<uint32_t> &hits) {
+  std::string out = "[";
+  for (size_t k = 0; k < hits.size(); k++)
+    out += (k ? ", " : "") + std::to_string(hits[k]);
+  return out + "]";
+}
+
+std::string to_json(const std::vector<std::pair<std::string, double>> &tolerances, const std::vector<Expected> &all) {
+  std::string out = "{\n  \"tolerances\": {";
+  for (size_t k = 0; k < tolerances.size(); k++) {
+    char num[32];
+    snprintf(num, sizeof(num), "%.6g", tolerances[k].second);
+    out += std::string(k ? "," : "") + "\n    " + iq::json_quote(tolerances[k].first) + ": " + num;
+  }
+  out += "\n  },\n  \"vectors\": [";
+  for (size_t k = 0; k < all.size(); k++) {
+    const Expected &e = all[k];
+    out += std::string(k ? "," : "") + "\n    {\"name\": " + iq::json_quote(e.name) +
+           ", \"source\": " + iq::json_quote(e.source) + ", \"energy\": " + std::to_string(e.energy) + ",\n";
+    for (uint32_t v = 0; v < 3; v++)
+      out += std::string(v ? ",\n" : "") + "     \"cfar_" + VARIANTS[v] + "\": " + hits_json(e.hits[v]);
+    if (e.detected) {
+      const iq::Detection &d = e.detection;
+      // hz to the double's full precision, since they are compared exactly
+      char det[256];
+      snprintf(det, sizeof(det),
+               "{\"hits\": %u, \"peak_hz\": %.17g, \"low_hz\": %.17g, \"high_hz\": %.17g, \"snr_db\": %.4f}",
+               d.hits, d.peak_hz, d.low_hz, d.high_hz, d.snr_db);
+      out += std::string(",\n     \"detection\": ") + det + "}";
+    } else {
+      out += ",\n     \"detection\": null}";
+    }
+  }
+  return out + "\n  ]\n}\n";
+}
+
+bool load_expected(const std::string &path, std::vector<std::pair<std::string, double>> *tolerances,
+                   std::vector<Expected> *all, std::string *error) {
+  std::string text;
+  iq::Json root;
+  if (!read_file(path, &text, error) || !parse_json(text, &root, error)) {
+    *error = path + ": " + *error;
+    return false;
+  }
+  for (auto &t : root["tolerances"].object)
+    tolerances->emplace_back(t.first, t.second.num(-1));
+  for (auto &v : root["vectors"].array) {
+    Expected e;
+    e.name = v["name"].str();
+    e.source = v["source"].str();
+    e.energy = uint32_t(v["energy"].num());
+    for (uint32_t k = 0; k < 3; k++)
+      for (auto &h : v[std::string("cfar_") + VARIANTS[k]].array)
+        e.hits[k].push_back(uint32_t(h.num()));
+    const iq::Json &d = v["detection"];
+    e.detected = !d.is_null();
+    e.detection.hits = uint32_t(d["hits"].num());
+    e.detection.peak_hz = d["peak_hz"].num();
+    e.detection.low_hz = d["low_hz"].num();
+    e.detection.high_hz = d["high_hz"].num();
+    e.detection.snr_db = d["snr_db"].num();
+    if (e.name.empty()) {
+      *error = path + ": a vector without a name";
+      return false;
+    }
+    all->push_back(std::move(e));
+  }
+  return true;
+}
+
+// NAME=PATH[@BLOCK]: one block of a recording as a vector
+bool import_block(const std::string &dir, const std::string &arg, std::string *name, std::string *source,
+                  std::string *error) {
+  size_t eq = arg.find('=');
+  if (eq == 0 || eq == std::string::npos) {
+    *error = arg + ": expected NAME=RECORDING[@BLOCK]";
+    return false;
+  }
+  *name = arg.substr(0, eq);
+  std::string path = arg.substr(eq + 1);
+  uint64_t block = 0;
+  size_t at = path.rfind('@');
+  if (at != std::string::npos) {
+    block = strtoull(path.c_str() + at + 1, nullptr, 0);
+    path.resize(at);
+  }
+  iq::Replay replay;
+  if (!replay.open(path, error))
+    return false;
+  uint16_t pairs[N][2];
+  if (block >= replay.blocks() || replay.read(block, pairs) != N) {
+    *error = path + ": no full block " + std::to_string(block);
+    return false;
+  }
+  uint8_t packed[iq::BLOCK_BYTES];
+  encode(pairs, packed);
+  *source = path + "@" + std::to_string(block);
+  return write_file(dir + "/" + *name + ".sc12", packed, sizeof(packed), error);
+}
+
+bool update(const std::string &dir, const std::vector<std::string> &recordings, std::string *error) {
+  mkdir(dir.c_str(), 0755);
+  std::vector<std::pair<std::string, double>> tolerances;
+  std::vector<Expected> old;
+  std::string ignored;
+  load_expected(dir + "/expected.json", &tolerances, &old, &ignored);
+  if (tolerances.empty())
+    tolerances.assign(std::begin(DEFAULT_TOLERANCES), std::end(DEFAULT_TOLERANCES));
+
+  // the vectors already known, then any new synthetic or recorded ones
+  std::vector<std::pair<std::string, std::string>> vectors;
+  auto add = [&](const std::string &name, const std::string &source) {
+    for (auto &v : vectors)
+      if (v.first == name) {
+        v.second = source;
+        return;
+      }
+    vectors.emplace_back(name, source);
+  };
+  for (auto &e : old)
+    add(e.name, e.source);
+  for (auto &s : SYNTHETIC) {
+    std::string path = dir + "/" + s.name + ".sc12";
+    if (access(path.c_str(), F_OK) != 0) {
+      iq::SimConfig config;
+      if (!iq::parse_sim_spec(s.spec, &config, error))
+        return false;
+      uint8_t packed[iq::BLOCK_BYTES];
+      iq::Simulator(config).synthesise(packed);
+      if (!write_file(path, packed, sizeof(packed), error))
+        return false;
+      printf("wrote %s\n", path.c_str());
+    }
+    add(s.name, std::string("sim:") + s.spec);
+  }
+  for (auto &arg : recordings) {
+    std::string name, source;
+    if (!import_block(dir, arg, &name, &source, error))
+      return false;
+    printf("wrote %s/%s.sc12 from %s\n", dir.c_str(), name.c_str(), source.c_str());
+    add(name, source);
+  }
+
+  std::vector<Expected> all;
+  for (auto &v : vectors) {
+    std::vector<uint8_t> block;
+    if (!load_vector(dir, v.first, &block, error))
+      return false;
+    all.push_back(decide(v.first, v.second, block.data()));
+  }
+  std::string json = to_json(tolerances, all);
+  std::string path = dir + "/expected.json";
+  if (!write_file(path, json.data(), json.size(), error))
+    return false;
+  printf("wrote %s: %zu vectors\n", path.c_str(), all.size());
+  return true;
+}
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-d DIR] [-v]\n"
+          "       %s -u [-d DIR] [NAME=RECORDING[@BLOCK]]...\n"
+          "  -d DIR  the vectors and expected.json (default " GOLDEN_DIR ")\n"
+          "  -v      every vector's error, not just the worst\n"
+          "  -u      write any missing synthetic vectors, cut blocks from recordings\n"
+          "          into new ones, and rewrite the expected decisions\n",
+          argv0, argv0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string dir = GOLDEN_DIR;
+  bool updating = false, verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:uvh")) != -1) {
+    switch (opt) {
+      case 'd':
+        dir = optarg;
+        break;
+      case 'u':
+        updating = true;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (!updating && optind != argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::string error;
+  if (updating) {
+    if (!update(dir, std::vector<std::string>(argv + optind, argv + argc), &error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    return 0;
+  }
+
+  Report report(verbose);
+  std::vector<Expected> all;
+  if (!load_expected(dir + "/expected.json", &report.tolerances, &all, &error)) {
+    fprintf(stderr, "%s (golden -u writes it; -d DIR names another directory)\n", error.c_str());
+    return 1;
+  }
+  for (auto &e : all) {
+    std::vector<uint8_t> block;
+    if (!load_vector(dir, e.name, &block, &error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    check_vector(e, block.data(), &report);
+  }
+  check_biquads(&report);
+
+  bool ok = report.print();
+  printf("%zu vectors; cmsis-dsp fft skipped (arm_common_tables.c is not in the sdk)\n", all.size());
+  printf("%s\n", ok ? "all within tolerance" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+// inspect capture files written by iqd's capture: outputs (or sigmf
+// datasets), cut time ranges out of them as sc16, and convert captures
+// to sigmf
+//
+//   iqcap info FILE
+//   iqcap cat [-s START] [-l LENGTH] FILE > out.sc16
+//   iqcap export [-f] FILE BASE
+//
+// START is seconds from the start of the capture, or @UNIXTIME for an
+// absolute wall-clock time; LENGTH is in seconds (default: to the end).
+// seeking is a binary search over the mmapped record index, so cutting a
+// minute out of a day-long capture touches only that minute.
+// export writes BASE.sigmf-data (ci16_le, or cf32_le with -f) and
+// BASE.sigmf-meta, with the same detections iqd's sigmf: outputs record.
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "capture.h"
+#include "sigmf.h"
+
+namespace {
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s info FILE\n"
+          "       %s cat [-s START] [-l LENGTH] FILE\n"
+          "       %s export [-f] FILE BASE\n"
+          "  FILE       capture file, or a sigmf dataset for info and cat\n"
+          "  -s START   seconds from the start, or @UNIXTIME (default 0)\n"
+          "  -l LENGTH  seconds to extract (default: to the end)\n"
+          "  -f         export cf32_le rather than ci16_le\n",
+          argv0, argv0, argv0);
+}
+
+std::string format_time(uint64_t ns) {
+  time_t t = ns / 1000000000ull;
+  struct tm tm;
+  char buf[64];
+  gmtime_r(&t, &tm);
+  size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  snprintf(buf + n, sizeof(buf) - n, ".%03lluZ", (unsigned long long)(ns / 1000000 % 1000));
+  return buf;
+}
+
+int info(const iq::CaptureReader &cap) {
+  const iq::CaptureHeader &h = cap.header();
+  uint64_t blocks = cap.blocks();
+  printf("device:      %.*s\n", (int)sizeof(h.device_id), h.device_id);
+  printf("firmware:    %.*s\n", (int)sizeof(h.firmware), h.firmware);
+  printf("format:      %s, %u samples per block\n", h.format == iq::CAPTURE_SC12 ? "sc12" : "sc16",
+         h.block_samples);
+  printf("sample rate: %.0f\n", h.sample_rate);
+  printf("gain:        %u\n", h.gain);
+  printf("blocks:      %llu%s\n", (unsigned long long)blocks, h.blocks == blocks ? "" : " (not closed cleanly)");
+  if (blocks == 0)
+    return 0;
+
+  // sequence numbers count every block the device sent, so drops fall out
+  // of the first and last records without a scan (a rotated capture's
+  // first record counts the drops just before it)
+  const iq::CaptureRecord &first = cap.record(0), &last = cap.record(blocks - 1);
+  printf("dropped:     %llu\n", (unsigned long long)(last.seq + 1 - first.seq + first.dropped - blocks));
+  printf("start:       %s\n", format_time(first.time_ns).c_str());
+  printf("end:         %s\n", format_time(last.time_ns).c_str());
+  printf("duration:    %.3f s\n", (last.time_ns - first.time_ns) / 1e9);
+  return 0;
+}
+
+uint64_t start_time(const std::string &start, uint64_t first_ns) {
+  if (start[0] == '@')
+    return uint64_t(strtod(start.c_str() + 1, nullptr) * 1e9);
+  return first_ns + uint64_t(strtod(start.c_str(), nullptr) * 1e9);
+}
+
+int cat(const iq::CaptureReader &cap, const std::string &start, double length) {
+  uint64_t blocks = cap.blocks();
+  if (blocks == 0)
+    return 0;
+
+  uint64_t from_ns = start_time(start, cap.record(0).time_ns);
+  uint64_t to_ns = length > 0 ? from_ns + uint64_t(length * 1e9) : UINT64_MAX;
+
+  auto t0 = std::chrono::steady_clock::now();
+  uint64_t k = cap.seek_time(from_ns);
+  double seek_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  fprintf(stderr, "seek to block %llu of %llu in %.3f ms\n", (unsigned long long)k, (unsigned long long)blocks,
+          seek_ms);
+
+  std::vector<int16_t> sc16(2 * cap.header().block_samples);
+  for (; k < blocks && cap.record(k).time_ns < to_ns; k++) {
+    size_t samples = cap.read(k, sc16.data());
+    if (fwrite(sc16.data(), 2 * sizeof(int16_t), samples, stdout) != samples)
+      return 1;
+  }
+  return 0;
+}
+
+int info(const iq::SigmfReader &sig) {
+  printf("datatype:    %s\n", sig.datatype().c_str());
+  printf("sample rate: %.0f\n", sig.sample_rate());
+  printf("samples:     %llu\n", (unsigned long long)sig.samples());
+  printf("description: %s\n", sig.meta()["global"]["core:description"].str().c_str());
+  printf("captures:    %zu\n", sig.captures().size());
+  if (sig.samples() > 0 && sig.time_of(0)) {
+    printf("start:       %s\n", format_time(sig.time_of(0)).c_str());
+    printf("end:         %s\n", format_time(sig.time_of(sig.samples() - 1)).c_str());
+  }
+  printf("annotations: %zu\n", sig.annotations().size());
+  for (auto &a : sig.annotations()) {
+    uint64_t t = sig.time_of(a.sample_start);
+    printf("  %-8s %s  %.3f s  %s\n", a.label.c_str(), t ? format_time(t).c_str() : "-",
+           a.sample_count / sig.sample_rate(), a.comment.c_str());
+  }
+  return 0;
+}
+
+int cat(const iq::SigmfReader &sig, const std::string &start, double length) {
+  if (sig.samples() == 0)
+    return 0;
+
+  // datasets without datetimes can still be cut by offset
+  uint64_t from, to = sig.samples();
+  if (sig.time_of(0)) {
+    uint64_t from_ns = start_time(start, sig.time_of(0));
+    from = sig.seek_time(from_ns);
+    if (length > 0)
+      to = std::min(to, sig.seek_time(from_ns + uint64_t(length * 1e9)));
+  } else {
+    from = std::min<uint64_t>(to, strtod(start.c_str(), nullptr) * sig.sample_rate());
+    if (length > 0)
+      to = std::min<uint64_t>(to, from + length * sig.sample_rate());
+  }
+
+  std::vector<int16_t> sc16(2 * iq::BLOCK_SAMPLES);
+  while (from < to) {
+    size_t samples = sig.read(from, sc16.data(), std::min<uint64_t>(iq::BLOCK_SAMPLES, to - from));
+    if (fwrite(sc16.data(), 2 * sizeof(int16_t), samples, stdout) != samples)
+      return 1;
+    from += samples;
+  }
+  return 0;
+}
+
+int export_sigmf(const iq::CaptureReader &cap, const std::string &base, iq::SigmfType type) {
+  const iq::CaptureHeader &h = cap.header();
+  if (h.block_samples != iq::BLOCK_SAMPLES) {
+    fprintf(stderr, "capture has %u samples per block, expected %zu\n", h.block_samples, iq::BLOCK_SAMPLES);
+    return 1;
+  }
+
+  iq::StreamInfo info;
+  info.device_id = std::string(h.device_id, strnlen(h.device_id, sizeof(h.device_id)));
+  info.firmware = std::string(h.firmware, strnlen(h.firmware, sizeof(h.firmware)));
+  info.sample_rate = h.sample_rate;
+  info.gain = h.gain;
+
+  iq::SigmfWriter writer;
+  std::string error;
+  if (!writer.open(base, type, info, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  iq::Block block;
+  for (uint64_t k = 0; k < cap.blocks(); k++) {
+    block.seq = cap.record(k).seq;
+    block.time_ns = cap.record(k).time_ns;
+    block.samples = cap.read(k, block.iq);
+    if (!writer.write(block))
+      break;
+  }
+  if (!writer.close()) {
+    fprintf(stderr, "%s\n", writer.error().c_str());
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  std::string command = argv[1];
+  std::string start = "0";
+  double length = 0;
+  iq::SigmfType type = iq::SIGMF_CI16;
+
+  int opt;
+  optind = 2;
+  while ((opt = getopt(argc, argv, "s:l:fh")) != -1) {
+    switch (opt) {
+      case 's':
+        start = optarg;
+        break;
+      case 'l':
+        length = atof(optarg);
+        break;
+      case 'f':
+        type = iq::SIGMF_CF32;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  bool exporting = command == "export";
+  if (optind != argc - (exporting ? 2 : 1) || (command != "info" && command != "cat" && !exporting)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::string path = argv[optind], error;
+  if (!exporting && iq::is_sigmf(path)) {
+    iq::SigmfReader sig;
+    if (!sig.open(path, &error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    return command == "info" ? info(sig) : cat(sig, start, length);
+  }
+
+  iq::CaptureReader cap;
+  if (!cap.open(path, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  if (exporting)
+    return export_sigmf(cap, iq::sigmf_base(argv[optind + 1]), type);
+  return command == "info" ? info(cap) : cat(cap, start, length);
+}
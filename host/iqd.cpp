@@ -0,0 +1,552 @@
+// host streaming daemon: drives one or more radar modules and writes their
+// iq as sc16 (uint16 0..4095, interleaved i/q, host byte order) to stdout,
+// files or sockets
+//
+//   iqd -d /dev/ttyACM0 [-o OUTPUT]... [-d DEVICE [-o OUTPUT]...]...
+//   iqd -a [-o OUTPUT]...
+//
+// DEVICE is a tty path, or "usb", "usb:SERIAL" or "usb:BUS-PORT" to stream
+// through libusb with several bulk transfers in flight. "sim[:SPEC]" runs a
+// simulated module in-process (see simulator.h), and "unix:PATH" talks to
+// one served by iqsim.
+// each -o applies to the preceding -d; a device with no -o writes to stdout.
+// OUTPUT is "-", "file:PATH" (or a bare path), "tcp:HOST:PORT", "unix:PATH",
+// or one of the recording and serving outputs listed in sink.h.
+//
+// -a streams every module on the bus, picking up modules as they are plugged
+// in and dropping them when they go away. its outputs follow -a and may use
+// {id}, the module's usb serial number; the default is file:{id}.sc16.
+//
+// the epoll loop only reads and unpacks; outputs are written from a shared
+// worker pool (pipes and sockets from a thread each) through a ring of -b
+// blocks each. when an output falls behind, -p picks what gives: drop-oldest
+// (default) or drop-newest lose that output's blocks, block stalls the one
+// epoll thread instead, and with it every device.
+//
+// -m serves per-device counters over http for prometheus (see telemetry.h):
+// samples and rate, bytes the transport lost, read sizes, the time spent
+// reading, unpacking and in each output, each output's queue and drops,
+// and the detections of outputs that run a detector. -l appends the same
+// snapshot as a json line every -i seconds.
+
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "device.h"
+#include "modules.h"
+#include "pipeline.h"
+#include "protocol.h"
+#include "sink.h"
+#include "telemetry.h"
+#include "usb.h"
+#include "worker_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// rescan delay after a uevent (cdc-acm binds after the usb device appears),
+// and the fallback period when no uevents arrive or netlink is unavailable
+constexpr auto HOTPLUG_SETTLE = std::chrono::milliseconds(250);
+constexpr auto RESCAN_PERIOD = std::chrono::seconds(5);
+
+struct Output {
+  std::string spec;
+  iq::OverrunPolicy policy;
+};
+
+struct Stream {
+  std::string name;  // the -d argument, or the module id under -a
+  std::string path;  // what is opened
+  std::string id;    // stable module id, recorded in captures
+  bool managed = false;
+  std::vector<Output> outputs;
+  std::unique_ptr<iq::Device> device;
+  std::unique_ptr<iq::Pipeline> pipeline;
+  uint64_t samples = 0;
+  std::vector<uint64_t> overruns;
+  Clock::time_point started;
+
+  // telemetry
+  iq::Histogram read_bytes{6, 20};
+  iq::Histogram read_ns{10, 30};
+  double rate = 0;             // samples per second, over the last report
+  uint64_t dropped_bytes = 0;  // the transport's, kept once the device is gone
+  std::vector<uint64_t> detections;
+  std::vector<double> detection_rates;
+};
+
+struct Config {
+  size_t depth = 64;
+  iq::UsbOptions usb;
+  bool managed_usb = false;
+  bool quiet = false;
+};
+
+volatile sig_atomic_t running = 1;
+
+// outputs with listeners of their own (serve:) on the epoll loop, told
+// apart from streams by their address. those stopped during an epoll batch
+// stay recognizable until it is done.
+std::vector<iq::Consumer *> listeners, stopped_listeners;
+
+void on_signal(int) { running = 0; }
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s -d DEVICE [-o OUTPUT]... [-d DEVICE [-o OUTPUT]...]...\n"
+          "       %s -a [-o OUTPUT]...\n"
+          "  -d DEVICE  radar module tty (eg. /dev/ttyACM0), usb, usb:SERIAL or usb:BUS-PORT,\n"
+          "             sim[:SPEC] for a simulated module, or unix:PATH for one served by iqsim\n"
+          "  -a         every module on the bus, including ones plugged in later\n"
+          "  -U         -a: open modules through libusb rather than their tty\n"
+          "  -o OUTPUT  '-', file:PATH, tcp:HOST:PORT, unix:PATH, capture:PATH, sigmf:BASE,\n"
+          "             shm:NAME or serve:[HOST:]PORT\n"
+          "             (default '-', or file:{id}.sc16 for -a)\n"
+          "  -p POLICY  for the following -o: drop-oldest (default), drop-newest or block\n"
+          "  -b BLOCKS  per-output queue depth in %zu-sample blocks (default 64)\n"
+          "  -j THREADS output writer threads shared by all modules (default: one per cpu)\n"
+          "  -r BYTES   read size (default 65536)\n"
+          "  -t COUNT   usb: bulk transfers in flight (default 8)\n"
+          "  -T BYTES   usb: bytes per bulk transfer (default 32768)\n"
+          "  -q         no per-second rate lines on stderr\n"
+          "  -m [HOST:]PORT  serve counters for prometheus at http://HOST:PORT/metrics\n"
+          "             (json at /metrics.json)\n"
+          "  -l FILE    append the counters to FILE as a json line every -i seconds\n"
+          "  -i SECONDS interval for -l (default 10)\n",
+          argv0, argv0, iq::BLOCK_SAMPLES);
+}
+
+// substitute the module id into an output spec
+std::string expand(std::string spec, const std::string &id) {
+  for (size_t at; (at = spec.find("{id}")) != std::string::npos;)
+    spec.replace(at, 4, id);
+  return spec;
+}
+
+// stable id for a -d argument: the module's serial where sysfs can tell
+// (following /dev/serial/by-id links), else the argument itself
+std::string module_id(const std::string &path) {
+  char real[PATH_MAX];
+  std::string tty = realpath(path.c_str(), real) ? real : path;
+  for (auto &m : iq::list_modules()) {
+    if (m.tty == tty || path == "usb:" + m.port || (!m.serial.empty() && path == "usb:" + m.serial))
+      return m.id;
+  }
+  return path;
+}
+
+// open the device and its outputs and start streaming; the stream is
+// registered with epoll only on success
+bool start(Stream &s, const Config &config, iq::WorkerPool *pool, int epfd) {
+  std::string error;
+  std::unique_ptr<iq::Transport> transport = iq::open_transport(s.path, config.usb, &error);
+  if (!transport) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return false;
+  }
+  s.device = std::make_unique<iq::Device>(s.name, std::move(transport));
+
+  iq::StreamInfo info;
+  info.device_id = s.id;
+  if (!s.device->read_version(&info.firmware))
+    info.firmware = "unknown";
+
+  s.pipeline = std::make_unique<iq::Pipeline>(s.name, pool);
+  for (auto &out : s.outputs) {
+    auto sink = iq::open_sink(out.spec, info, &error);
+    if (!sink) {
+      fprintf(stderr, "%s\n", error.c_str());
+      s.device.reset();
+      return false;
+    }
+    s.pipeline->add_output(std::move(sink), out.policy, config.depth);
+  }
+  s.overruns.assign(s.outputs.size(), 0);
+  s.detections.assign(s.outputs.size(), 0);
+  s.detection_rates.assign(s.outputs.size(), 0);
+
+  if (!s.device->start_streaming()) {
+    fprintf(stderr, "%s\n", s.device->error().c_str());
+    s.device.reset();
+    return false;
+  }
+
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.ptr = &s;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, s.device->fd(), &ev);
+  for (auto &out : s.pipeline->outputs()) {
+    if (out->poll_fd() < 0)
+      continue;
+    ev.data.ptr = out.get();
+    epoll_ctl(epfd, EPOLL_CTL_ADD, out->poll_fd(), &ev);
+    listeners.push_back(out.get());
+  }
+  s.started = Clock::now();
+  return true;
+}
+
+// stop reading the device, drain its outputs and print its sample count
+// with the total, so a replay at full speed (sim:replay=...,fast) doubles
+// as a pipeline throughput benchmark
+void stop(Stream &s, const Config &config, int epfd) {
+  epoll_ctl(epfd, EPOLL_CTL_DEL, s.device->fd(), nullptr);
+  for (auto &out : s.pipeline->outputs()) {
+    if (out->poll_fd() < 0)
+      continue;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, out->poll_fd(), nullptr);
+    listeners.erase(std::find(listeners.begin(), listeners.end(), out.get()));
+    stopped_listeners.push_back(out.get());
+  }
+  s.dropped_bytes = s.device->transport()->dropped_bytes();
+  s.device.reset();
+  s.pipeline->finish();
+  double seconds = std::chrono::duration<double>(Clock::now() - s.started).count();
+  if (!config.quiet)
+    fprintf(stderr, "%s: %llu samples in %.3f s, %.0f per second\n", s.name.c_str(),
+            (unsigned long long)s.pipeline->samples(), seconds, s.pipeline->samples() / seconds);
+}
+
+// read until the device has nothing more; false when it is gone.
+// raw is shared by every stream: the pipeline copies out of it right away.
+bool service(Stream &s, std::vector<uint8_t> &raw) {
+  while (true) {
+    auto start = Clock::now();
+    ssize_t n = s.device->transport()->read(raw.data(), raw.size());
+    if (n > 0) {
+      s.read_ns.record(iq::elapsed_ns(start));
+      s.read_bytes.record(n);
+      s.pipeline->feed(raw.data(), n);
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno == EAGAIN)
+      return true;
+    fprintf(stderr, "%s: %s\n", s.name.c_str(), n == 0 ? "device closed" : strerror(errno));
+    return false;
+  }
+}
+
+// one snapshot of every stream's counters, for -m and -l
+iq::Metrics collect(const std::vector<std::unique_ptr<Stream>> &streams) {
+  iq::Metrics m;
+  for (auto &s : streams) {
+    if (!s->pipeline)
+      continue;
+    iq::Metrics::Labels device = {{"device", s->name}, {"id", s->id}};
+    auto with = [](iq::Metrics::Labels labels, const char *key, const std::string &value) {
+      labels.emplace_back(key, value);
+      return labels;
+    };
+    m.gauge("iq_device_up", "1 while the module is streaming", device, s->device != nullptr);
+    m.counter("iq_samples_total", "i/q pairs received", device, s->pipeline->samples());
+    m.gauge("iq_samples_per_second", "i/q pairs received over the last second", device, s->rate);
+    m.counter("iq_transport_dropped_bytes_total", "bytes lost in the host's transport buffer before iqd read them",
+              device, s->device ? s->device->transport()->dropped_bytes() : s->dropped_bytes);
+    m.histogram("iq_read_bytes", "bytes per read from the module", device, s->read_bytes);
+    m.histogram("iq_stage_seconds", "time per read from the module, per unpack of a read, per output write",
+                with(device, "stage", "read"), s->read_ns, 1e-9);
+    m.histogram("iq_stage_seconds", "", with(device, "stage", "unpack"), s->pipeline->feed_ns(), 1e-9);
+
+    auto &outs = s->pipeline->outputs();
+    for (size_t k = 0; k < outs.size(); k++) {
+      const iq::Consumer &out = *outs[k];
+      iq::Metrics::Labels output = with(device, "output", out.name());
+      m.histogram("iq_stage_seconds", "", with(output, "stage", "write"), out.write_ns(), 1e-9);
+      m.counter("iq_output_dropped_blocks_total", "blocks an output lost to its overrun policy",
+                with(output, "policy", iq::policy_name(s->outputs[k].policy)), out.overruns());
+      m.gauge("iq_output_queued_blocks", "blocks waiting for the output", output, out.queued());
+      m.gauge("iq_output_queue_capacity_blocks", "the output's queue size (-b)", output, out.capacity());
+      m.histogram("iq_output_queue_depth_blocks", "blocks already queued as each block arrived", output,
+                  out.queue_depth());
+      m.counter("iq_detections_total", "blocks with a detection, from the detectors of sigmf: and serve: outputs",
+                output, out.detections());
+      m.gauge("iq_detections_per_second", "detections over the last second", output, s->detection_rates[k]);
+    }
+  }
+  return m;
+}
+
+// the module is already streaming through a -d (or a previous scan)
+bool claimed(const std::vector<std::unique_ptr<Stream>> &streams, const iq::ModuleInfo &m) {
+  for (auto &s : streams) {
+    if (s->managed ? s->name == m.id
+                   : (s->path == m.tty || s->path == "usb:" + m.port ||
+                      (!m.serial.empty() && s->path == "usb:" + m.serial)))
+      return true;
+  }
+  return false;
+}
+
+// start a stream for every module that does not have one yet
+void rescan(std::vector<std::unique_ptr<Stream>> &streams, const std::vector<Output> &outputs,
+            const Config &config, iq::WorkerPool *pool, int epfd) {
+  for (auto &m : iq::list_modules()) {
+    if (claimed(streams, m) || (!config.managed_usb && m.tty.empty()))
+      continue;
+
+    auto s = std::make_unique<Stream>();
+    s->name = s->id = m.id;
+    s->path = config.managed_usb ? "usb:" + m.port : m.tty;
+    s->managed = true;
+    for (auto &out : outputs)
+      s->outputs.push_back({expand(out.spec, m.id), out.policy});
+
+    if (start(*s, config, pool, epfd)) {
+      fprintf(stderr, "%s: module on %s (port %s)\n", s->name.c_str(), s->path.c_str(), m.port.c_str());
+      streams.push_back(std::move(s));
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  // declared first so every pipeline is finished before the pool goes away
+  std::unique_ptr<iq::WorkerPool> pool;
+  std::vector<std::unique_ptr<Stream>> streams;
+  std::vector<Output> managed_outputs;
+  std::vector<Output> *outputs = nullptr;
+  bool managed = false;
+  Config config;
+  size_t read_size = 65536;
+  size_t threads = 0;
+  iq::OverrunPolicy policy = iq::OVERRUN_DROP_OLDEST;
+  std::string metrics_addr, log_path;
+  double log_interval = 10;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:aUo:p:b:j:r:t:T:qm:l:i:h")) != -1) {
+    switch (opt) {
+      case 'd':
+        streams.push_back(std::make_unique<Stream>());
+        streams.back()->name = streams.back()->path = optarg;
+        outputs = &streams.back()->outputs;
+        break;
+      case 'a':
+        managed = true;
+        outputs = &managed_outputs;
+        break;
+      case 'U':
+        config.managed_usb = true;
+        break;
+      case 'o':
+        if (!outputs) {
+          fprintf(stderr, "-o %s: no preceding -d or -a\n", optarg);
+          return 1;
+        }
+        outputs->push_back({optarg, policy});
+        break;
+      case 'p':
+        if (!iq::parse_policy(optarg, &policy)) {
+          fprintf(stderr, "-p %s: expected block, drop-oldest or drop-newest\n", optarg);
+          return 1;
+        }
+        break;
+      case 'b':
+        config.depth = strtoul(optarg, nullptr, 0);
+        break;
+      case 'j':
+        threads = strtoul(optarg, nullptr, 0);
+        break;
+      case 'r':
+        read_size = strtoul(optarg, nullptr, 0);
+        break;
+      case 't':
+        config.usb.transfers = atoi(optarg);
+        break;
+      case 'T':
+        config.usb.transfer_size = strtoul(optarg, nullptr, 0);
+        break;
+      case 'q':
+        config.quiet = true;
+        break;
+      case 'm':
+        metrics_addr = optarg;
+        break;
+      case 'l':
+        log_path = optarg;
+        break;
+      case 'i':
+        log_interval = strtod(optarg, nullptr);
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if ((streams.empty() && !managed) || read_size < iq::SC12_BYTES || config.depth == 0 || !(log_interval > 0)) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (managed_outputs.empty())
+    managed_outputs.push_back({"file:{id}.sc16", policy});
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  pool = std::make_unique<iq::WorkerPool>(threads);
+  std::vector<uint8_t> raw(read_size);
+
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+
+  iq::MetricsServer metrics;
+  if (!metrics_addr.empty()) {
+    std::string error;
+    if (!metrics.listen(metrics_addr, &error)) {
+      fprintf(stderr, "-m %s\n", error.c_str());
+      return 1;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &metrics;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, metrics.fd(), &ev);
+  }
+  FILE *log = nullptr;
+  if (!log_path.empty() && !(log = fopen(log_path.c_str(), "ae"))) {
+    fprintf(stderr, "-l %s: %s\n", log_path.c_str(), strerror(errno));
+    return 1;
+  }
+  auto next_log = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(log_interval));
+
+  for (auto &s : streams) {
+    if (s->outputs.empty())
+      s->outputs.push_back({"-", policy});
+    s->id = module_id(s->path);
+    if (!start(*s, config, pool.get(), epfd))
+      return 1;
+  }
+
+  iq::HotplugMonitor hotplug;
+  auto next_scan = Clock::now();
+  if (managed) {
+    std::string error;
+    if (hotplug.open(&error)) {
+      struct epoll_event ev = {};
+      ev.events = EPOLLIN;
+      ev.data.ptr = &hotplug;
+      epoll_ctl(epfd, EPOLL_CTL_ADD, hotplug.fd(), &ev);
+    } else {
+      fprintf(stderr, "%s; polling sysfs every %llds instead\n", error.c_str(),
+              (long long)std::chrono::duration_cast<std::chrono::seconds>(RESCAN_PERIOD).count());
+    }
+  }
+
+  auto last_report = Clock::now();
+  struct epoll_event events[16];
+
+  while (running) {
+    auto now = Clock::now();
+    if (managed && now >= next_scan) {
+      rescan(streams, managed_outputs, config, pool.get(), epfd);
+      next_scan = Clock::now() + RESCAN_PERIOD;
+    }
+
+    size_t live = std::count_if(streams.begin(), streams.end(), [](auto &s) { return s->device != nullptr; });
+    if (!managed && live == 0)
+      break;
+
+    int timeout = 1000;
+    if (managed)
+      timeout = std::min<long long>(
+          timeout, std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(next_scan - now).count()));
+
+    int n = epoll_wait(epfd, events, 16, timeout);
+    for (int k = 0; k < n; k++) {
+      if (events[k].data.ptr == &hotplug) {
+        if (hotplug.read_events())
+          next_scan = std::min(next_scan, Clock::now() + HOTPLUG_SETTLE);
+        continue;
+      }
+      if (events[k].data.ptr == &metrics) {
+        metrics.service([&] { return collect(streams); });
+        continue;
+      }
+      auto listener = std::find(listeners.begin(), listeners.end(), events[k].data.ptr);
+      if (listener != listeners.end()) {
+        (*listener)->service();
+        continue;
+      }
+      if (std::find(stopped_listeners.begin(), stopped_listeners.end(), events[k].data.ptr) !=
+          stopped_listeners.end())
+        continue;
+      Stream &s = *static_cast<Stream *>(events[k].data.ptr);
+      if (s.device && (!service(s, raw) || s.pipeline->live_outputs() == 0))
+        stop(s, config, epfd);
+    }
+    stopped_listeners.clear();
+
+    // unplugged modules are forgotten so a replug starts them afresh
+    streams.erase(std::remove_if(streams.begin(), streams.end(),
+                                 [](auto &s) { return s->managed && !s->device; }),
+                  streams.end());
+
+    // print the sample rate, and any blocks an output had to drop, once per second
+    now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - last_report).count();
+    if (elapsed >= 1.0) {
+      for (auto &s : streams) {
+        uint64_t samples = s->pipeline->samples();
+        s->rate = (samples - s->samples) / elapsed;
+        if (!config.quiet && s->device)
+          fprintf(stderr, "%s: %.0f samples per second\n", s->name.c_str(), s->rate);
+        s->samples = samples;
+
+        auto &outs = s->pipeline->outputs();
+        for (size_t k = 0; k < outs.size(); k++) {
+          uint64_t overruns = outs[k]->overruns();
+          if (!config.quiet && overruns > s->overruns[k])
+            fprintf(stderr, "%s: output %s dropped %llu blocks (%s)\n", s->name.c_str(),
+                    outs[k]->name().c_str(), (unsigned long long)(overruns - s->overruns[k]),
+                    iq::policy_name(s->outputs[k].policy));
+          s->overruns[k] = overruns;
+
+          uint64_t detections = outs[k]->detections();
+          s->detection_rates[k] = (detections - s->detections[k]) / elapsed;
+          s->detections[k] = detections;
+        }
+      }
+      last_report = now;
+
+      // also closes scrapers that stalled
+      if (!metrics_addr.empty())
+        metrics.service([&] { return collect(streams); });
+      if (log && now >= next_log) {
+        fprintf(log, "%s\n", collect(streams).json().c_str());
+        fflush(log);
+        next_log += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(log_interval));
+        next_log = std::max(next_log, now);
+      }
+    }
+  }
+
+  // flush the last partial block and let every output drain
+  for (auto &s : streams) {
+    if (s->device)
+      stop(*s, config, epfd);
+    else if (s->pipeline)
+      s->pipeline->finish();
+  }
+  streams.clear();
+
+  if (log)
+    fclose(log);
+  close(epfd);
+  return 0;
+}
@@ -0,0 +1,163 @@
+// per-zone cycle profile of the firmware's stream path (READ_PROFILE, see
+// src/prof.h): count, min, mean and max per zone, and optionally the log2
+// histograms
+//
+//   iqprof -d DEVICE                  the profile as it stands
+//   iqprof -d DEVICE -s SECONDS [-m MODE]
+//                                     clear it, stream for SECONDS, print it
+//
+// MODE is adc (default), clutter, triggered or vitals. the firmware cannot
+// answer while it streams, so the run ends with one READ_PROFILE that stops
+// the stream and, once it has drained, another that reads the profile; the
+// module then takes commands again without a reset.
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "clutter.h"
+#include "device.h"
+#include "prof.h"
+#include "protocol.h"
+
+namespace {
+
+const char *const ZONE_NAMES[PROF_ZONES] = {
+  "dma_isr", "dma_period", "block", "clutter", "pack", "usb_send", "trigger", "vitals",
+};
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s -d DEVICE [-s SECONDS [-m MODE] [-t COUNTS]] [-r] [-H]\n"
+          "  -d DEVICE   module tty, usb[:SERIAL], sim[:SPEC] or unix:PATH, as for iqd\n"
+          "  -s SECONDS  clear the profile, stream for SECONDS, then read it\n"
+          "  -m MODE     adc (default), clutter, triggered or vitals\n"
+          "  -t COUNTS   triggered: mean |iq - clutter| that fires an event (default 25)\n"
+          "  -r          clear the profile after reading it\n"
+          "  -H          print each zone's histogram too\n",
+          argv0);
+}
+
+// read and discard the stream for seconds
+void drain(iq::Transport *t, double seconds) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+  uint8_t buf[65536];
+  while (std::chrono::steady_clock::now() < end) {
+    struct pollfd pfd = {t->fd(), POLLIN, 0};
+    if (poll(&pfd, 1, 100) > 0 && t->read(buf, sizeof(buf)) == 0)
+      return;
+  }
+}
+
+void print_histogram(const prof_zone_t &z) {
+  uint32_t peak = 0;
+  for (uint32_t n : z.hist)
+    peak = std::max(peak, n);
+  for (int k = 0; k < PROF_BUCKETS; k++) {
+    if (z.hist[k] == 0)
+      continue;
+    int bar = int(40.0 * z.hist[k] / peak + 0.5);
+    printf("    %s2^%-2d %10u %s\n", k == PROF_BUCKETS - 1 ? ">=" : "  ", k, z.hist[k],
+           std::string(std::max(bar, 1), '#').c_str());
+  }
+}
+
+void print(const prof_report_t &r, bool histograms) {
+  double us = 1e6 / r.cycles_hz;
+  printf("cycle counter %.1f MHz, %u dma overruns\n", r.cycles_hz / 1e6, r.overruns);
+  printf("%-12s %10s %10s %10s %10s %10s %10s\n", "zone", "count", "min", "mean", "max", "mean us", "max us");
+  for (uint32_t k = 0; k < std::min<uint32_t>(r.zones, PROF_ZONES); k++) {
+    const prof_zone_t &z = r.zone[k];
+    if (z.count == 0) {
+      printf("%-12s %10u\n", ZONE_NAMES[k], 0u);
+      continue;
+    }
+    double mean = (double(uint64_t(z.sum_hi) << 32 | z.sum_lo)) / z.count;
+    printf("%-12s %10u %10u %10.0f %10u %10.2f %10.2f\n", ZONE_NAMES[k], z.count, z.min, mean, z.max, mean * us,
+           z.max * us);
+    if (histograms)
+      print_histogram(z);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string path, mode = "adc";
+  double seconds = 0, trigger_counts = 25;
+  bool reset = false, histograms = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:s:m:t:rHh")) != -1) {
+    switch (opt) {
+      case 'd':
+        path = optarg;
+        break;
+      case 's':
+        seconds = strtod(optarg, nullptr);
+        break;
+      case 'm':
+        mode = optarg;
+        break;
+      case 't':
+        trigger_counts = strtod(optarg, nullptr);
+        break;
+      case 'r':
+        reset = true;
+        break;
+      case 'H':
+        histograms = true;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (path.empty() || optind != argc ||
+      (mode != "adc" && mode != "clutter" && mode != "triggered" && mode != "vitals")) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::string error;
+  auto transport = iq::open_transport(path, iq::UsbOptions(), &error);
+  if (!transport) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  iq::Device device(path, std::move(transport));
+
+  prof_report_t report;
+  auto read_profile = [&](uint32_t flags) {
+    if (device.command(iq::READ_PROFILE, {flags}, 500, &report, sizeof(report)))
+      return true;
+    fprintf(stderr, "%s (firmware without READ_PROFILE?)\n", device.error().c_str());
+    return false;
+  };
+
+  if (seconds > 0) {
+    if (!read_profile(PROF_RESET))
+      return 1;
+    uint32_t read_cmd = mode == "triggered" ? iq::READ_TRIGGERED : mode == "vitals" ? iq::READ_VITALS : iq::READ_ADC;
+    bool ok = (mode != "clutter" || device.command(iq::CFG_CLUTTER, {CLUTTER_ENABLE | CLUTTER_RESET, CLUTTER_DEFAULT_SHIFT})) &&
+              (mode != "triggered" || device.command(iq::CFG_TRIGGER, {uint32_t(trigger_counts * 16), 4, 16})) &&
+              device.start_streaming(read_cmd);
+    if (ok) {
+      drain(device.transport(), seconds);
+      ok = device.stop_streaming();
+    }
+    if (!ok) {
+      fprintf(stderr, "%s\n", device.error().c_str());
+      return 1;
+    }
+  }
+
+  if (!read_profile(reset ? PROF_RESET : 0))
+    return 1;
+  print(report, histograms);
+  return 0;
+}
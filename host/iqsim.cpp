@@ -0,0 +1,138 @@
+// simulated radar module on a pty or a unix socket, for running iqd,
+// stream-iq.py and the benchmarks without hardware
+//
+//   iqsim [SPEC]               prints the pty to open, eg. /dev/pts/3
+//   iqsim -u PATH [SPEC]       serves one connection at a time on PATH
+//
+// SPEC is as for iqd's sim: devices (see simulator.h), eg.
+//   iqsim target=1500@300,target=-4000@80,noise=12,drop=0.001,short=0.05
+//   iqsim replay=/data/radar0.iqc,speed=4,loop
+// a summary of blocks sent and dropped goes to stderr after each session.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+#include "simulator.h"
+
+namespace {
+
+std::atomic<bool> stop{false};
+
+void on_signal(int) { stop.store(true); }
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-u PATH] [SPEC]\n"
+          "  -u PATH  listen on a unix socket (iqd -d unix:PATH) rather than a pty\n"
+          "  SPEC     target=HZ[@AMP],noise=RMS,dc=I:Q,rate=PAIRS,fast,drop=P,short=P,\n"
+          "           seed=N,version=STRING,firmware,replay=PATH,speed=N,loop\n"
+          "           (see host/simulator.h)\n",
+          argv0);
+}
+
+void report(const iq::Simulator &sim) {
+  fprintf(stderr, "session ended: %llu blocks sent, %llu dropped\n", (unsigned long long)sim.sent(),
+          (unsigned long long)sim.dropped());
+}
+
+int serve_pty(iq::Simulator &sim) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("posix_openpt");
+    return 1;
+  }
+  // holding the slave open keeps the master readable across host sessions
+  const char *name = ptsname(master);
+  int slave = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+  struct termios tio;
+  if (slave < 0 || tcgetattr(slave, &tio) != 0) {
+    perror(name);
+    return 1;
+  }
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+  printf("%s\n", name);
+  fflush(stdout);
+
+  sim.serve(master, stop);
+  report(sim);
+  close(slave);
+  close(master);
+  return 0;
+}
+
+int serve_unix(iq::Simulator &sim, const std::string &path) {
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "%s: path too long\n", path.c_str());
+    return 1;
+  }
+  memcpy(addr.sun_path, path.c_str(), path.size());
+  unlink(path.c_str());
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+    perror(path.c_str());
+    return 1;
+  }
+
+  while (!stop.load()) {
+    int conn = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (conn < 0)
+      continue;
+    sim.serve(conn, stop);
+    report(sim);
+    close(conn);
+  }
+  close(fd);
+  unlink(path.c_str());
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string socket_path;
+  int opt;
+  while ((opt = getopt(argc, argv, "u:h")) != -1) {
+    switch (opt) {
+      case 'u':
+        socket_path = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind < argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  iq::SimConfig config;
+  std::string error;
+  if (!iq::parse_sim_spec(optind < argc ? argv[optind] : "", &config, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  // no SA_RESTART: a signal must break accept() so the loop sees stop
+  struct sigaction sa = {};
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+
+  iq::Simulator sim(config);
+  return socket_path.empty() ? serve_pty(sim) : serve_unix(sim, socket_path);
+}
@@ -0,0 +1,185 @@
+// attach to an iqd shm: or serve: output and write its blocks to stdout as
+// sc16
+//
+//   iqtap [-o] [-q] NAME | baudline -stdin ...
+//   iqtap [-D N] [-R BYTES] [-e] [-q] tcp:HOST:PORT | udp:HOST:PORT
+//
+// any number of iqtaps (or other ShmReader users) can attach to one stream
+// without adding work to iqd or to each other. a tap that falls behind
+// loses blocks from its own view only; losses are reported on stderr once
+// per second. exits when iqd closes the stream.
+//
+// over the network, -D and -R ask the server to decimate and rate-limit
+// this client's iq, and -e asks for detections instead, printed one per
+// line. losses are counted from gaps in the block sequence numbers.
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "netstream.h"
+#include "shm_ring.h"
+
+namespace {
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-o] [-q] NAME\n"
+          "       %s [-D N] [-R BYTES] [-e] [-q] tcp:HOST:PORT|udp:HOST:PORT\n"
+          "  NAME      the iqd output shm:NAME\n"
+          "  -o        start at the oldest block still in the ring, not the newest\n"
+          "  -D N      have the server decimate by N (a power of two)\n"
+          "  -R BYTES  have the server send at most BYTES per second\n"
+          "  -e        detections, one line each, instead of iq\n"
+          "  -q        no loss reports\n",
+          argv0, argv0);
+}
+
+double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+int tap_shm(const char *name, bool from_oldest, bool quiet) {
+  iq::ShmReader reader;
+  std::string error;
+  if (!reader.open(name, &error, from_oldest)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  if (!quiet)
+    fprintf(stderr, "%s: %s, firmware %s, %u slots\n", name, reader.header().device_id, reader.header().firmware,
+            reader.header().slots);
+
+  iq::Block block;
+  uint64_t reported = 0;
+  double last = now();
+  while (true) {
+    // copied out rather than written from the ring: stdout may block for
+    // longer than a slot lives, and torn blocks must not reach it
+    iq::ShmReader::Result r = reader.read(&block, 1000);
+    if (r == iq::ShmReader::CLOSED)
+      break;
+    if (r == iq::ShmReader::READY && fwrite(block.iq, 2 * sizeof(int16_t), block.samples, stdout) != block.samples)
+      return 1;
+
+    double t = now();
+    if (!quiet && t - last >= 1) {
+      if (reader.lost() != reported)
+        fprintf(stderr, "%s: lost %llu blocks\n", name, (unsigned long long)(reader.lost() - reported));
+      reported = reader.lost();
+      last = t;
+    }
+  }
+  fflush(stdout);
+  if (!quiet)
+    fprintf(stderr, "%s: closed, lost %llu blocks in total\n", name, (unsigned long long)reader.lost());
+  return 0;
+}
+
+int tap_net(const char *spec, const iq::NetRequest &request, bool quiet) {
+  iq::NetClient client;
+  std::string error;
+  if (!client.open(spec, request, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  iq::NetFrame frame;
+  const uint8_t *payload;
+  uint64_t next_seq = 0, lost = 0, skipped = 0, reported_lost = 0, reported_skipped = 0;
+  bool started = false;
+  double last = now();
+  while (true) {
+    iq::NetClient::Result r = client.read(&frame, &payload, 1000);
+    if (r == iq::NetClient::CLOSED) {
+      fprintf(stderr, "%s: %s\n", spec, client.error().c_str());
+      return 1;
+    }
+
+    if (r == iq::NetClient::READY && frame.type == iq::NET_HELLO) {
+      std::string hello(reinterpret_cast<const char *>(payload), frame.length);
+      if (hello.find("\"error\"") != std::string::npos) {
+        fprintf(stderr, "%s: %s\n", spec, hello.c_str());
+        return 1;
+      }
+      if (!quiet)
+        fprintf(stderr, "%s: %s\n", spec, hello.c_str());
+    } else if (r == iq::NetClient::READY && frame.type == iq::NET_IQ) {
+      // device drops and server skips both show up as gaps; skipped says
+      // how many of them were the server's
+      if (frame.offset == 0) {
+        if (started && frame.seq > next_seq)
+          lost += frame.seq - next_seq;
+        started = true;
+        next_seq = frame.seq + 1;
+        skipped = frame.skipped;
+      }
+      if (fwrite(payload, 1, frame.length, stdout) != frame.length)
+        return 1;
+    } else if (r == iq::NetClient::READY && frame.type == iq::NET_DETECTION) {
+      iq::NetDetection d;
+      memcpy(&d, payload, std::min<size_t>(sizeof(d), frame.length));
+      printf("%llu %.6f hits=%u peak=%.1fHz band=%.1f..%.1fHz snr=%.1fdB\n", (unsigned long long)frame.seq,
+             frame.time_ns / 1e9, d.hits, d.peak_hz, d.low_hz, d.high_hz, d.snr_db);
+      fflush(stdout);
+    }
+
+    double t = now();
+    if (!quiet && t - last >= 1) {
+      if (lost != reported_lost)
+        fprintf(stderr, "%s: lost %llu blocks (%llu held back by the server)\n", spec,
+                (unsigned long long)(lost - reported_lost), (unsigned long long)(skipped - reported_skipped));
+      reported_lost = lost;
+      reported_skipped = skipped;
+      last = t;
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  bool from_oldest = false, quiet = false;
+  iq::NetRequest request;
+  int opt;
+  while ((opt = getopt(argc, argv, "oD:R:eqh")) != -1) {
+    switch (opt) {
+      case 'o':
+        from_oldest = true;
+        break;
+      case 'D':
+        request.decimation = atoi(optarg);
+        break;
+      case 'R':
+        request.rate = atof(optarg);
+        break;
+      case 'e':
+        request.iq = false;
+        request.events = true;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::string name = argv[optind];
+  if (name.compare(0, 4, "tcp:") == 0 || name.compare(0, 4, "udp:") == 0)
+    return tap_net(argv[optind], request, quiet);
+  return tap_shm(argv[optind], from_oldest, quiet);
+}
@@ -0,0 +1,216 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "json.h"
+
+namespace iq {
+
+namespace {
+
+const Json null_json;
+
+struct Parser {
+  const std::string &text;
+  size_t pos = 0;
+  std::string error;
+
+  void skip_space() {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+      pos++;
+  }
+
+  bool fail(const char *what) {
+    if (error.empty())
+      error = std::string(what) + " at offset " + std::to_string(pos);
+    return false;
+  }
+
+  bool literal(const char *word) {
+    size_t n = std::char_traits<char>::length(word);
+    if (text.compare(pos, n, word) != 0)
+      return fail("bad literal");
+    pos += n;
+    return true;
+  }
+
+  void put_utf8(std::string *out, unsigned cp) {
+    if (cp < 0x80) {
+      *out += char(cp);
+    } else if (cp < 0x800) {
+      *out += char(0xc0 | cp >> 6);
+      *out += char(0x80 | (cp & 0x3f));
+    } else {
+      *out += char(0xe0 | cp >> 12);
+      *out += char(0x80 | (cp >> 6 & 0x3f));
+      *out += char(0x80 | (cp & 0x3f));
+    }
+  }
+
+  bool string(std::string *out) {
+    pos++;  // opening quote
+    while (pos < text.size() && text[pos] != '"') {
+      char c = text[pos++];
+      if (c != '\\') {
+        *out += c;
+        continue;
+      }
+      if (pos >= text.size())
+        break;
+      switch (char e = text[pos++]) {
+        case 'n': *out += '\n'; break;
+        case 't': *out += '\t'; break;
+        case 'r': *out += '\r'; break;
+        case 'b': *out += '\b'; break;
+        case 'f': *out += '\f'; break;
+        case 'u':
+          // surrogate pairs are passed through as two code units
+          if (pos + 4 > text.size())
+            return fail("bad escape");
+          put_utf8(out, strtoul(text.substr(pos, 4).c_str(), nullptr, 16));
+          pos += 4;
+          break;
+        default: *out += e; break;
+      }
+    }
+    if (pos >= text.size())
+      return fail("unterminated string");
+    pos++;
+    return true;
+  }
+
+  bool value(Json *out, int depth) {
+    if (depth > 64)
+      return fail("nested too deeply");
+    skip_space();
+    if (pos >= text.size())
+      return fail("unexpected end");
+
+    char c = text[pos];
+    if (c == '{') {
+      out->type = Json::OBJECT;
+      pos++;
+      skip_space();
+      if (pos < text.size() && text[pos] == '}') {
+        pos++;
+        return true;
+      }
+      while (true) {
+        skip_space();
+        if (pos >= text.size() || text[pos] != '"')
+          return fail("expected key");
+        std::string key;
+        if (!string(&key))
+          return false;
+        skip_space();
+        if (pos >= text.size() || text[pos] != ':')
+          return fail("expected ':'");
+        pos++;
+        out->object.emplace_back(std::move(key), Json());
+        if (!value(&out->object.back().second, depth + 1))
+          return false;
+        skip_space();
+        if (pos < text.size() && text[pos] == ',') {
+          pos++;
+          continue;
+        }
+        if (pos < text.size() && text[pos] == '}') {
+          pos++;
+          return true;
+        }
+        return fail("expected ',' or '}'");
+      }
+    }
+    if (c == '[') {
+      out->type = Json::ARRAY;
+      pos++;
+      skip_space();
+      if (pos < text.size() && text[pos] == ']') {
+        pos++;
+        return true;
+      }
+      while (true) {
+        out->array.emplace_back();
+        if (!value(&out->array.back(), depth + 1))
+          return false;
+        skip_space();
+        if (pos < text.size() && text[pos] == ',') {
+          pos++;
+          continue;
+        }
+        if (pos < text.size() && text[pos] == ']') {
+          pos++;
+          return true;
+        }
+        return fail("expected ',' or ']'");
+      }
+    }
+    if (c == '"') {
+      out->type = Json::STRING;
+      return string(&out->string);
+    }
+    if (c == 't' || c == 'f') {
+      out->type = Json::BOOL;
+      out->boolean = c == 't';
+      return literal(c == 't' ? "true" : "false");
+    }
+    if (c == 'n')
+      return literal("null");
+
+    const char *start = text.c_str() + pos;
+    char *end;
+    out->type = Json::NUMBER;
+    out->number = strtod(start, &end);
+    if (end == start)
+      return fail("unexpected character");
+    pos += end - start;
+    return true;
+  }
+};
+
+}  // namespace
+
+const Json &Json::operator[](const std::string &key) const {
+  for (auto &kv : object) {
+    if (kv.first == key)
+      return kv.second;
+  }
+  return null_json;
+}
+
+const Json &Json::operator[](size_t index) const {
+  return index < array.size() ? array[index] : null_json;
+}
+
+bool parse_json(const std::string &text, Json *out, std::string *error) {
+  Parser p{text};
+  *out = Json();
+  if (!p.value(out, 0)) {
+    *error = p.error;
+    return false;
+  }
+  p.skip_space();
+  if (p.pos != text.size()) {
+    *error = "trailing data at offset " + std::to_string(p.pos);
+    return false;
+  }
+  return true;
+}
+
+std::string json_quote(const std::string &s) {
+  std::string out = "\"";
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c < 0x20) {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      out += esc;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+}  // namespace iq
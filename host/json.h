@@ -0,0 +1,37 @@
+// just enough json for sigmf metadata: a tree parser and string quoting
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace iq {
+
+struct Json {
+  enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+  Type type = NUL;
+  bool boolean = false;
+  double number = 0;
+  std::string string;
+  std::vector<Json> array;
+  std::vector<std::pair<std::string, Json>> object;
+
+  // missing keys and indices give a null value
+  const Json &operator[](const std::string &key) const;
+  const Json &operator[](size_t index) const;
+  size_t size() const { return type == ARRAY ? array.size() : object.size(); }
+
+  bool is_null() const { return type == NUL; }
+  double num(double fallback = 0) const { return type == NUMBER ? number : fallback; }
+  const std::string &str() const { return string; }
+};
+
+bool parse_json(const std::string &text, Json *out, std::string *error);
+
+// "..." with json escapes
+std::string json_quote(const std::string &s);
+
+}  // namespace iq
@@ -0,0 +1,130 @@
+#include <dirent.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+#include "modules.h"
+#include "protocol.h"
+
+namespace iq {
+
+namespace {
+
+const char USB_DEVICES[] = "/sys/bus/usb/devices/";
+
+// first line of a sysfs attribute, or "" if it is missing
+std::string read_attr(const std::string &path) {
+  std::string value;
+  if (FILE *f = fopen(path.c_str(), "r")) {
+    char line[256];
+    if (fgets(line, sizeof(line), f))
+      value = line;
+    fclose(f);
+  }
+  while (!value.empty() && isspace(static_cast<unsigned char>(value.back())))
+    value.pop_back();
+  return value;
+}
+
+// ids end up in file names and metric labels
+std::string sanitize(const std::string &s) {
+  std::string out;
+  for (char c : s)
+    out += isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.' ? c : '_';
+  return out;
+}
+
+}  // namespace
+
+std::string module_tty(const std::string &port) {
+  std::string dir = USB_DEVICES + port + ":1.0/tty";
+  std::string path;
+  if (DIR *d = opendir(dir.c_str())) {
+    while (struct dirent *e = readdir(d)) {
+      if (e->d_name[0] != '.')
+        path = std::string("/dev/") + e->d_name;
+    }
+    closedir(d);
+  }
+  return path;
+}
+
+std::vector<ModuleInfo> list_modules() {
+  std::vector<ModuleInfo> modules;
+  DIR *d = opendir(USB_DEVICES);
+  if (!d)
+    return modules;
+
+  while (struct dirent *e = readdir(d)) {
+    // devices are "BUS-PORT[.PORT...]"; skip interfaces ("1-2:1.0") and root hubs ("usb1")
+    std::string port = e->d_name;
+    if (port[0] == '.' || port.find(':') != std::string::npos || port.compare(0, 3, "usb") == 0)
+      continue;
+
+    std::string dir = USB_DEVICES + port + "/";
+    if (strtoul(read_attr(dir + "idVendor").c_str(), nullptr, 16) != MODULE_VID ||
+        strtoul(read_attr(dir + "idProduct").c_str(), nullptr, 16) != MODULE_PID)
+      continue;
+
+    ModuleInfo m;
+    m.serial = read_attr(dir + "serial");
+    m.port = port;
+    m.id = sanitize(m.serial.empty() ? "port-" + port : m.serial);
+    m.tty = module_tty(port);
+    modules.push_back(m);
+  }
+  closedir(d);
+
+  std::sort(modules.begin(), modules.end(),
+            [](const ModuleInfo &a, const ModuleInfo &b) { return a.id < b.id; });
+  return modules;
+}
+
+HotplugMonitor::~HotplugMonitor() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool HotplugMonitor::open(std::string *error) {
+  fd_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+  if (fd_ < 0) {
+    *error = std::string("hotplug: ") + strerror(errno);
+    return false;
+  }
+
+  struct sockaddr_nl addr = {};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1;  // kernel uevents (udev rebroadcasts on group 2)
+  if (bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+    *error = std::string("hotplug: ") + strerror(errno);
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  return true;
+}
+
+bool HotplugMonitor::read_events() {
+  bool relevant = false;
+  char buf[4096];
+  ssize_t n;
+
+  // "ACTION@DEVPATH\0KEY=VALUE\0..."
+  while ((n = recv(fd_, buf, sizeof(buf) - 1, 0)) > 0) {
+    buf[n] = 0;
+    for (char *p = buf; p < buf + n; p += strlen(p) + 1) {
+      if (strcmp(p, "SUBSYSTEM=usb") == 0 || strcmp(p, "SUBSYSTEM=tty") == 0)
+        relevant = true;
+    }
+  }
+  return relevant;
+}
+
+}  // namespace iq
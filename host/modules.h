@@ -0,0 +1,42 @@
+// radar modules on the usb bus: sysfs enumeration and hotplug events
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace iq {
+
+struct ModuleInfo {
+  // stable across replugs and reboots: the usb serial number (the chip's
+  // unique id), or "port-BUS-PORT" for a module that reports none
+  std::string id;
+  std::string serial;
+  std::string port;  // sysfs port path, eg. "1-2.3"
+  std::string tty;   // "/dev/ttyACMn", empty until cdc-acm has bound
+};
+
+// every module currently attached, sorted by id
+std::vector<ModuleInfo> list_modules();
+
+// the tty the cdc-acm driver created for a usb port path, or ""
+std::string module_tty(const std::string &port);
+
+// kernel uevents for usb and tty devices, from a netlink socket
+class HotplugMonitor {
+ public:
+  HotplugMonitor() = default;
+  ~HotplugMonitor();
+
+  // false (with error set) where netlink is unavailable, eg. in a container
+  bool open(std::string *error);
+  int fd() const { return fd_; }
+
+  // consume pending events; true if any may have added or removed a module
+  bool read_events();
+
+ private:
+  int fd_ = -1;
+};
+
+}  // namespace iq
@@ -0,0 +1,688 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+#include "detector.h"
+#include "json.h"
+#include "netstream.h"
+
+namespace iq {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t MAX_CLIENTS = 64;
+// a tcp client that has not asked for anything by then gets plain iq
+constexpr auto REQUEST_WAIT = std::chrono::seconds(1);
+// udp subscriptions lapse unless renewed
+constexpr auto UDP_LEASE = std::chrono::seconds(10);
+constexpr auto UDP_RENEW = std::chrono::seconds(2);
+// a challenge cookie is good for the period it was made in and the next
+constexpr auto COOKIE_PERIOD = std::chrono::seconds(10);
+constexpr size_t MAX_REQUEST = 256;
+constexpr size_t MAX_PAYLOAD = 2 * BLOCK_SAMPLES * sizeof(int16_t);
+
+NetFrame make_frame(NetFrameType type, uint16_t decimation, uint64_t seq, uint64_t time_ns, uint32_t offset,
+                    uint32_t length, uint64_t skipped) {
+  NetFrame f;
+  memcpy(f.magic, NET_MAGIC, sizeof(f.magic));
+  f.version = NET_VERSION;
+  f.type = type;
+  f.decimation = decimation;
+  f.seq = seq;
+  f.time_ns = time_ns;
+  f.offset = offset;
+  f.length = length;
+  f.skipped = skipped;
+  return f;
+}
+
+struct Client {
+  int fd = -1;                    // tcp; -1 for udp subscribers
+  struct sockaddr_storage addr;   // udp
+  socklen_t addr_len = 0;
+  bool configured = false;
+  std::string line;               // tcp request being read
+  NetRequest request;
+  Clock::time_point seen;         // tcp: accepted; udp: last request
+  double tokens = 0;
+  Clock::time_point refilled;
+  std::vector<uint8_t> pending;   // tcp: unsent tail of the last frame
+  uint64_t skipped = 0;
+  bool dead = false;
+};
+
+class ServerSink : public Sink {
+ public:
+  ServerSink(std::string name, const StreamInfo &info) : name_(std::move(name)), info_(info) {
+    DetectorConfig config;
+    config.sample_rate = info.sample_rate;
+    detector_ = std::make_unique<Detector>(config);
+    std::random_device random;
+    for (auto &word : secret_)
+      word = uint64_t(random()) << 32 | random();
+  }
+  ~ServerSink() override {
+    for (auto &c : clients_)
+      if (c.fd >= 0)
+        close(c.fd);
+    if (tcp_ >= 0)
+      close(tcp_);
+    if (udp_ >= 0)
+      close(udp_);
+    if (epfd_ >= 0)
+      close(epfd_);
+  }
+
+  bool listen(const std::string &hostport, std::string *error) {
+    tcp_ = bind_socket(hostport, SOCK_STREAM, error);
+    if (tcp_ >= 0)
+      udp_ = bind_socket(hostport, SOCK_DGRAM, error);
+    if (tcp_ < 0 || udp_ < 0) {
+      *error = "serve:" + *error;
+      return false;
+    }
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    watch(tcp_);
+    watch(udp_);
+    return true;
+  }
+
+  bool write(const void *, size_t) override { return false; }
+  bool write_block(const Block &block) override;
+  const std::string &name() const override { return name_; }
+  // the detector only runs while a client has asked for events
+  uint64_t detections() const override { return detections_.load(std::memory_order_relaxed); }
+  int poll_fd() const override { return epfd_; }
+  void service() override;
+
+ private:
+  void watch(int fd);
+  void accept_clients();
+  void read_requests();
+  void receive_datagrams();
+  void expire();
+  void reap();
+  uint64_t cookie(const struct sockaddr_storage &addr, socklen_t len, uint64_t period) const;
+  bool valid_cookie(const struct sockaddr_storage &addr, socklen_t len, uint64_t cookie) const;
+  void challenge(const struct sockaddr_storage &addr, socklen_t len);
+  void configure(Client &c, const std::string &line);
+  bool admit(Client &c, size_t bytes);
+  bool flush(Client &c);
+  void send_frame(Client &c, const NetFrame &frame, const void *payload);
+  void send_iq(Client &c, const Block &block);
+
+  std::string name_;
+  StreamInfo info_;
+  int tcp_ = -1;
+  int udp_ = -1;
+  int epfd_ = -1;
+  uint64_t secret_[2];
+  // service() runs on the reader's loop, write_block on a pool worker
+  std::mutex lock_;
+  std::vector<Client> clients_;
+  std::unique_ptr<Detector> detector_;
+  std::atomic<uint64_t> detections_{0};
+  std::vector<int16_t> decimated_;
+  std::vector<uint8_t> frame_;
+};
+
+void ServerSink::watch(int fd) {
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// connects, requests and hangups, from the owner's loop as they arrive;
+// dead clients are closed here too, so their hangup stops polling readable
+void ServerSink::service() {
+  std::lock_guard<std::mutex> guard(lock_);
+  accept_clients();
+  read_requests();
+  receive_datagrams();
+  reap();
+}
+
+bool ServerSink::write_block(const Block &block) {
+  std::lock_guard<std::mutex> guard(lock_);
+  expire();
+
+  bool events = false;
+  for (auto &c : clients_)
+    events |= c.configured && c.request.events;
+  Detection d;
+  bool detected = events && detector_->process(block, &d);
+  if (detected)
+    detections_.fetch_add(1, std::memory_order_relaxed);
+
+  for (auto &c : clients_) {
+    if (!c.configured || c.dead)
+      continue;
+    if (c.request.iq)
+      send_iq(c, block);
+    if (detected && c.request.events) {
+      NetDetection nd = {d.hits, 0, d.peak_hz, d.low_hz, d.high_hz, d.snr_db};
+      NetFrame f = make_frame(NET_DETECTION, c.request.decimation, block.seq, block.time_ns, 0, sizeof(nd),
+                              c.skipped);
+      if ((c.fd < 0 || flush(c)) && admit(c, sizeof(f) + sizeof(nd)))
+        send_frame(c, f, &nd);
+    }
+  }
+
+  reap();
+  return true;
+}
+
+// the time-outs: a silent tcp client gets plain iq, an unrenewed udp one lapses
+void ServerSink::expire() {
+  Clock::time_point now = Clock::now();
+  for (auto &c : clients_) {
+    if (c.fd >= 0 && !c.configured && !c.dead && now - c.seen > REQUEST_WAIT)
+      configure(c, "iq");
+    if (c.fd < 0 && now - c.seen > UDP_LEASE)
+      c.dead = true;
+  }
+}
+
+void ServerSink::reap() {
+  clients_.erase(std::remove_if(clients_.begin(), clients_.end(),
+                                [](const Client &c) {
+                                  if (c.dead && c.fd >= 0)
+                                    close(c.fd);
+                                  return c.dead;
+                                }),
+                 clients_.end());
+}
+
+void ServerSink::accept_clients() {
+  int fd;
+  while ((fd = accept4(tcp_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    if (clients_.size() >= MAX_CLIENTS) {
+      close(fd);
+      continue;
+    }
+    Client c;
+    c.fd = fd;
+    c.seen = Clock::now();
+    clients_.push_back(std::move(c));
+    watch(fd);
+  }
+}
+
+void ServerSink::read_requests() {
+  for (auto &c : clients_) {
+    if (c.fd < 0)
+      continue;
+    char buf[MAX_REQUEST];
+    ssize_t n;
+    // configured clients have nothing more to say; reading them only
+    // notices a hangup before the next send would
+    while ((n = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+      if (c.configured)
+        continue;
+      c.line.append(buf, n);
+      size_t eol = c.line.find('\n');
+      if (eol != std::string::npos) {
+        configure(c, c.line.substr(0, eol));
+        break;
+      }
+      if (c.line.size() > MAX_REQUEST)
+        c.dead = true;
+    }
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+      c.dead = true;
+  }
+}
+
+void ServerSink::receive_datagrams() {
+  char buf[MAX_REQUEST];
+  struct sockaddr_storage addr;
+  socklen_t len = sizeof(addr);
+  ssize_t n;
+  while ((n = recvfrom(udp_, buf, sizeof(buf) - 1, MSG_DONTWAIT, reinterpret_cast<struct sockaddr *>(&addr), &len)) >=
+         0) {
+    std::string line(buf, n);
+    line.erase(std::find(line.begin(), line.end(), '\n'), line.end());
+    uint64_t echoed = 0;
+    bool has_cookie = line.compare(0, 7, "cookie=") == 0;
+    if (has_cookie) {
+      size_t end = line.find(' ');
+      echoed = strtoull(line.c_str() + 7, nullptr, 16);
+      line = end == std::string::npos ? "" : line.substr(end + 1);
+    }
+
+    auto c = std::find_if(clients_.begin(), clients_.end(), [&](const Client &k) {
+      return k.fd < 0 && k.addr_len == len && memcmp(&k.addr, &addr, len) == 0;
+    });
+    // the source may be forged: without a cookie it gets one small frame,
+    // and nothing it says counts until it shows it can hear us
+    bool valid = has_cookie && valid_cookie(addr, len, echoed);
+    if (line == "bye") {
+      if (c != clients_.end() && valid)
+        c->dead = true;
+    } else if (!valid) {
+      challenge(addr, len);
+    } else if (c != clients_.end()) {
+      c->seen = Clock::now();
+      NetRequest request;
+      std::string error;
+      if (!parse_request(line, &request, &error) || format_request(request) != format_request(c->request))
+        configure(*c, line);
+    } else if (clients_.size() < MAX_CLIENTS) {
+      Client client;
+      client.addr = addr;
+      client.addr_len = len;
+      client.seen = Clock::now();
+      clients_.push_back(std::move(client));
+      configure(clients_.back(), line);
+    }
+    len = sizeof(addr);
+  }
+}
+
+// a keyed hash of the source address, so checking an echoed cookie needs
+// no state for sources that have not subscribed
+uint64_t ServerSink::cookie(const struct sockaddr_storage &addr, socklen_t len, uint64_t period) const {
+  auto mix = [](uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  };
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&addr);
+  uint64_t h = mix(secret_[0] ^ period);
+  for (socklen_t k = 0; k < len; k += 8) {
+    uint64_t word = 0;
+    memcpy(&word, bytes + k, std::min<size_t>(8, len - k));
+    h = mix(h ^ word);
+  }
+  return mix(h ^ secret_[1]);
+}
+
+bool ServerSink::valid_cookie(const struct sockaddr_storage &addr, socklen_t len, uint64_t echoed) const {
+  uint64_t period = Clock::now().time_since_epoch() / COOKIE_PERIOD;
+  return echoed == cookie(addr, len, period) || echoed == cookie(addr, len, period - 1);
+}
+
+void ServerSink::challenge(const struct sockaddr_storage &addr, socklen_t len) {
+  uint64_t period = Clock::now().time_since_epoch() / COOKIE_PERIOD;
+  uint64_t value = cookie(addr, len, period);
+  NetFrame f = make_frame(NET_CHALLENGE, 1, 0, 0, 0, sizeof(value), 0);
+  uint8_t datagram[sizeof(f) + sizeof(value)];
+  memcpy(datagram, &f, sizeof(f));
+  memcpy(datagram + sizeof(f), &value, sizeof(value));
+  sendto(udp_, datagram, sizeof(datagram), MSG_DONTWAIT, reinterpret_cast<const struct sockaddr *>(&addr), len);
+}
+
+void ServerSink::configure(Client &c, const std::string &line) {
+  std::string error, hello;
+  bool ok = parse_request(line, &c.request, &error);
+  if (ok) {
+    char rate[64];
+    snprintf(rate, sizeof(rate), "%.17g", info_.sample_rate / c.request.decimation);
+    hello = "{\"device\": " + json_quote(info_.device_id) + ", \"firmware\": " + json_quote(info_.firmware) +
+            ", \"sample_rate\": " + rate + ", \"decimation\": " + std::to_string(c.request.decimation) +
+            ", \"request\": " + json_quote(format_request(c.request)) + "}";
+  } else {
+    hello = "{\"error\": " + json_quote(error) + "}";
+  }
+
+  c.configured = ok;
+  c.refilled = Clock::now();
+  c.tokens = c.request.rate;
+  NetFrame f = make_frame(NET_HELLO, c.request.decimation, 0, 0, 0, hello.size(), 0);
+  send_frame(c, f, hello.data());
+  if (!ok)
+    c.dead = true;
+}
+
+// token bucket holding up to a second's worth, or the frame when that is
+// more, so a rate below one frame a second still sends every few seconds;
+// frames that do not fit are skipped whole rather than delayed, so a
+// limited client stays current
+bool ServerSink::admit(Client &c, size_t bytes) {
+  if (c.request.rate <= 0)
+    return true;
+  Clock::time_point now = Clock::now();
+  c.tokens = std::min(std::max<double>(c.request.rate, bytes),
+                      c.tokens + c.request.rate * std::chrono::duration<double>(now - c.refilled).count());
+  c.refilled = now;
+  if (c.tokens < bytes)
+    return false;
+  c.tokens -= bytes;
+  return true;
+}
+
+// sends what a tcp client has not taken yet; false while some remains
+bool ServerSink::flush(Client &c) {
+  while (!c.pending.empty()) {
+    ssize_t n = send(c.fd, c.pending.data(), c.pending.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return false;
+    if (n <= 0) {
+      c.dead = true;
+      return false;
+    }
+    c.pending.erase(c.pending.begin(), c.pending.begin() + n);
+  }
+  return !c.dead;
+}
+
+void ServerSink::send_frame(Client &c, const NetFrame &frame, const void *payload) {
+  frame_.resize(sizeof(frame) + frame.length);
+  memcpy(frame_.data(), &frame, sizeof(frame));
+  memcpy(frame_.data() + sizeof(frame), payload, frame.length);
+
+  if (c.fd < 0) {
+    // a full socket buffer loses the datagram, as the network might
+    sendto(udp_, frame_.data(), frame_.size(), MSG_DONTWAIT, reinterpret_cast<struct sockaddr *>(&c.addr),
+           c.addr_len);
+    return;
+  }
+
+  // what the socket does not take now is kept, and frames are skipped
+  // until flush() gets it out, so the client never sees a torn frame
+  size_t sent = 0;
+  while (sent < frame_.size()) {
+    ssize_t n = send(c.fd, frame_.data() + sent, frame_.size() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if (n <= 0) {
+      c.dead = true;
+      return;
+    }
+    sent += n;
+  }
+  c.pending.assign(frame_.begin() + sent, frame_.end());
+}
+
+void ServerSink::send_iq(Client &c, const Block &block) {
+  // a tcp client still taking the previous frame skips this block
+  if (c.fd >= 0 && !flush(c)) {
+    c.skipped += !c.dead;
+    return;
+  }
+
+  // boxcar average over each group of n, rounded; n divides BLOCK_SAMPLES
+  uint32_t n = c.request.decimation, samples = block.samples / n;
+  const int16_t *iq = block.iq;
+  if (n > 1) {
+    decimated_.resize(2 * samples);
+    for (uint32_t k = 0; k < samples; k++) {
+      int32_t i = 0, q = 0;
+      for (uint32_t j = 0; j < n; j++) {
+        i += block.iq[2 * (k * n + j)];
+        q += block.iq[2 * (k * n + j) + 1];
+      }
+      decimated_[2 * k] = (i + n / 2) / n;
+      decimated_[2 * k + 1] = (q + n / 2) / n;
+    }
+    iq = decimated_.data();
+  }
+
+  size_t chunk = c.fd < 0 ? NET_UDP_SAMPLES : samples;
+  size_t frames = samples == 0 ? 0 : (samples + chunk - 1) / chunk;
+  if (!admit(c, frames * sizeof(NetFrame) + samples * 2 * sizeof(int16_t))) {
+    c.skipped++;
+    return;
+  }
+  for (uint32_t offset = 0; offset < samples && !c.dead; offset += chunk) {
+    uint32_t count = std::min<size_t>(chunk, samples - offset);
+    NetFrame f = make_frame(NET_IQ, n, block.seq, block.time_ns, offset, count * 2 * sizeof(int16_t), c.skipped);
+    send_frame(c, f, iq + 2 * offset);
+  }
+}
+
+}  // namespace
+
+int bind_socket(const std::string &hostport, int type, std::string *error) {
+  size_t colon = hostport.rfind(':');
+  std::string host = colon == std::string::npos ? "" : hostport.substr(0, colon);
+  std::string port = colon == std::string::npos ? hostport : hostport.substr(colon + 1);
+
+  struct addrinfo hints = {}, *res;
+  hints.ai_socktype = type;
+  hints.ai_flags = AI_PASSIVE;
+  int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res);
+  if (rc != 0) {
+    *error = hostport + ": " + gai_strerror(rc);
+    return -1;
+  }
+
+  int fd = -1, one = 1;
+  for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+    if (fd < 0)
+      continue;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && (type != SOCK_STREAM || listen(fd, 16) == 0))
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  if (fd < 0)
+    *error = hostport + ": " + strerror(errno);
+  return fd;
+}
+
+bool parse_request(const std::string &line, NetRequest *request, std::string *error) {
+  NetRequest r;
+  r.iq = false;
+  std::istringstream words(line);
+  std::string word;
+  while (words >> word) {
+    if (word == "iq") {
+      r.iq = true;
+    } else if (word == "events") {
+      r.events = true;
+    } else if (word.compare(0, 6, "decim=") == 0) {
+      r.decimation = strtoul(word.c_str() + 6, nullptr, 10);
+      if (r.decimation == 0 || r.decimation > BLOCK_SAMPLES || BLOCK_SAMPLES % r.decimation != 0 ||
+          (r.decimation & (r.decimation - 1)) != 0) {
+        *error = "decim must be a power of two up to " + std::to_string(BLOCK_SAMPLES);
+        return false;
+      }
+    } else if (word.compare(0, 5, "rate=") == 0) {
+      char *end;
+      r.rate = strtod(word.c_str() + 5, &end);
+      if (end == word.c_str() + 5 || *end != 0 || !std::isfinite(r.rate) || r.rate < 0) {
+        *error = "rate must be a number of bytes per second, 0 for no limit";
+        return false;
+      }
+    } else {
+      *error = "unknown request '" + word + "'";
+      return false;
+    }
+  }
+  if (!r.events)
+    r.iq = true;
+  *request = r;
+  return true;
+}
+
+std::string format_request(const NetRequest &request) {
+  std::string line = request.iq && request.events ? "iq events" : request.events ? "events" : "iq";
+  if (request.decimation != 1)
+    line += " decim=" + std::to_string(request.decimation);
+  if (request.rate > 0) {
+    char rate[32];
+    snprintf(rate, sizeof(rate), " rate=%.0f", request.rate);
+    line += rate;
+  }
+  return line;
+}
+
+std::unique_ptr<Sink> open_server_sink(const std::string &hostport, const StreamInfo &info, std::string *error) {
+  auto sink = std::make_unique<ServerSink>("serve:" + hostport, info);
+  if (!sink->listen(hostport, error))
+    return nullptr;
+  return sink;
+}
+
+NetClient::~NetClient() {
+  if (fd_ >= 0) {
+    if (udp_) {
+      std::string bye = cookie_.empty() ? "bye\n" : "cookie=" + cookie_ + " bye\n";
+      send(fd_, bye.data(), bye.size(), MSG_DONTWAIT);
+    }
+    close(fd_);
+  }
+}
+
+bool NetClient::open(const std::string &spec, const NetRequest &request, std::string *error) {
+  udp_ = spec.compare(0, 4, "udp:") == 0;
+  if (!udp_ && spec.compare(0, 4, "tcp:") != 0) {
+    *error = spec + ": expected tcp:HOST:PORT or udp:HOST:PORT";
+    return false;
+  }
+  std::string hostport = spec.substr(4);
+  size_t colon = hostport.rfind(':');
+  if (colon == std::string::npos) {
+    *error = spec + ": expected HOST:PORT";
+    return false;
+  }
+
+  struct addrinfo hints = {}, *res;
+  hints.ai_socktype = udp_ ? SOCK_DGRAM : SOCK_STREAM;
+  int rc = getaddrinfo(hostport.substr(0, colon).c_str(), hostport.substr(colon + 1).c_str(), &hints, &res);
+  if (rc != 0) {
+    *error = spec + ": " + gai_strerror(rc);
+    return false;
+  }
+  for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+    fd_ = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+    if (fd_ >= 0 && connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0)
+      break;
+    if (fd_ >= 0)
+      close(fd_);
+    fd_ = -1;
+  }
+  freeaddrinfo(res);
+  if (fd_ < 0) {
+    *error = spec + ": " + strerror(errno);
+    return false;
+  }
+
+  if (udp_) {
+    // a second of full-rate iq, so bursts survive a slow reader
+    int size = 4 << 20;
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  }
+  request_ = format_request(request) + "\n";
+  subscribe();
+  buffer_.resize(udp_ ? 65536 : sizeof(NetFrame) + MAX_PAYLOAD);
+  return true;
+}
+
+void NetClient::subscribe() {
+  std::string line = cookie_.empty() ? request_ : "cookie=" + cookie_ + " " + request_;
+  send(fd_, line.data(), line.size(), MSG_NOSIGNAL);
+  subscribed_ = Clock::now();
+}
+
+// tcp: read until the current frame has len bytes, keeping partial reads
+bool NetClient::fill(size_t len, int timeout_ms, Result *result) {
+  while (have_ < len) {
+    struct pollfd pfd = {fd_, POLLIN, 0};
+    int rc = poll(&pfd, 1, timeout_ms);
+    if (rc < 0 && errno == EINTR)
+      continue;
+    if (rc == 0) {
+      *result = TIMEOUT;
+      return false;
+    }
+    ssize_t n = recv(fd_, buffer_.data() + have_, len - have_, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      error_ = n == 0 ? "server closed the connection" : strerror(errno);
+      *result = CLOSED;
+      return false;
+    }
+    have_ += n;
+  }
+  return true;
+}
+
+NetClient::Result NetClient::read(NetFrame *frame, const uint8_t **payload, int timeout_ms) {
+  Result result = READY;
+
+  if (udp_) {
+    while (true) {
+      if (Clock::now() - subscribed_ > UDP_RENEW)
+        subscribe();
+      struct pollfd pfd = {fd_, POLLIN, 0};
+      int wait = timeout_ms < 0 ? 1000 : std::min(timeout_ms, 1000);
+      int rc = poll(&pfd, 1, wait);
+      if (rc < 0 && errno == EINTR)
+        continue;
+      if (rc == 0) {
+        if (timeout_ms >= 0 && (timeout_ms -= wait) <= 0)
+          return TIMEOUT;
+        continue;
+      }
+      ssize_t n = recv(fd_, buffer_.data(), buffer_.size(), 0);
+      // icmp port unreachable while the server is not up yet
+      if (n < 0 && (errno == EINTR || errno == ECONNREFUSED))
+        continue;
+      if (n < 0) {
+        error_ = strerror(errno);
+        return CLOSED;
+      }
+      memcpy(frame, buffer_.data(), std::min<size_t>(n, sizeof(*frame)));
+      if (size_t(n) < sizeof(*frame) || memcmp(frame->magic, NET_MAGIC, 4) != 0 ||
+          frame->length != n - sizeof(*frame))
+        continue;
+      // answer the server's challenge and wait for the hello
+      if (frame->type == NET_CHALLENGE && frame->length == sizeof(uint64_t)) {
+        uint64_t value;
+        char hex[17];
+        memcpy(&value, buffer_.data() + sizeof(*frame), sizeof(value));
+        snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)value);
+        cookie_ = hex;
+        subscribe();
+        continue;
+      }
+      *payload = buffer_.data() + sizeof(*frame);
+      return READY;
+    }
+  }
+
+  if (used_) {
+    have_ = 0;
+    used_ = 0;
+  }
+  if (!fill(sizeof(NetFrame), timeout_ms, &result))
+    return result;
+  memcpy(frame, buffer_.data(), sizeof(*frame));
+  if (memcmp(frame->magic, NET_MAGIC, 4) != 0 || frame->version != NET_VERSION || frame->length > MAX_PAYLOAD) {
+    error_ = "not an iqd stream";
+    return CLOSED;
+  }
+  if (!fill(sizeof(NetFrame) + frame->length, timeout_ms, &result))
+    return result;
+  used_ = have_;
+  *payload = buffer_.data() + sizeof(*frame);
+  return READY;
+}
+
+}  // namespace iq
@@ -0,0 +1,128 @@
+// network fan-out: iqd serves a device's blocks and detections to remote
+// clients over tcp and udp, and NetClient pulls them
+//
+// a "serve:[HOST:]PORT" output listens on tcp and udp PORT (HOST defaults
+// to every interface; serve:localhost:PORT stays on loopback). a client
+// asks for what it wants with one line of words:
+//
+//   iq | events | iq events   [decim=N] [rate=BYTES]
+//
+// decim=N (a power of two up to 1024) boxcar-averages and decimates the
+// iq; rate=BYTES caps the bytes the client is sent per second (0, the
+// default, for no limit; a cap below one frame lets a frame through every
+// frame/rate seconds). tcp clients send the line after connecting (one
+// that says nothing for a second gets plain iq); udp clients send it as a
+// datagram, repeat it at least every 10 s to stay subscribed, and send
+// "bye" to leave. a datagram without a current cookie is answered only
+// with a challenge frame; the source subscribes by sending its line again
+// behind the challenge's cookie,
+//
+//   cookie=HEX iq decim=4
+//
+// and renewals and "bye" carry it too, so a forged source address can draw
+// one small frame, never a stream, and cannot end or change someone else's.
+// a renewal with a different line reconfigures the client, with a new hello.
+//
+// everything sent is a NetFrame followed by its payload: a json hello on
+// subscribing, iq frames (sc16, a whole block per tcp frame, up to
+// NET_UDP_SAMPLES per datagram) and detection frames. frames carry the
+// device's block sequence number, so a client sees the device's drops as
+// gaps, and skipped counts the blocks the server held back from that
+// client (rate limit, full socket). all fields are little-endian.
+
+#pragma once
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block.h"
+#include "sink.h"
+
+namespace iq {
+
+constexpr char NET_MAGIC[4] = {'I', 'Q', 'N', 'F'};
+constexpr uint8_t NET_VERSION = 1;
+constexpr size_t NET_UDP_SAMPLES = 256;
+
+enum NetFrameType : uint8_t {
+  NET_HELLO = 1,      // json: device, firmware, sample_rate, decimation, or error
+  NET_IQ = 2,         // sc16 pairs
+  NET_DETECTION = 3,  // NetDetection
+  NET_CHALLENGE = 4,  // udp: uint64_t cookie to repeat the request behind
+};
+
+struct NetFrame {
+  char magic[4];
+  uint8_t version;
+  uint8_t type;
+  uint16_t decimation;
+  uint64_t seq;        // device block sequence number
+  uint64_t time_ns;    // when the block was completed
+  uint32_t offset;     // first (decimated) sample of the payload in its block
+  uint32_t length;     // payload bytes that follow
+  uint64_t skipped;    // blocks held back from this client so far
+};
+
+struct NetDetection {
+  uint32_t hits;
+  uint32_t reserved;
+  double peak_hz;
+  double low_hz;
+  double high_hz;
+  double snr_db;
+};
+
+static_assert(sizeof(NetFrame) == 40 && sizeof(NetDetection) == 40, "wire layout");
+
+struct NetRequest {
+  bool iq = true;
+  bool events = false;
+  uint32_t decimation = 1;
+  double rate = 0;  // bytes per second; 0 is unlimited
+};
+
+bool parse_request(const std::string &line, NetRequest *request, std::string *error);
+std::string format_request(const NetRequest &request);
+
+// non-blocking socket bound to [HOST:]PORT, listening if SOCK_STREAM
+int bind_socket(const std::string &hostport, int type, std::string *error);
+
+// "serve:[HOST:]PORT" outputs
+std::unique_ptr<Sink> open_server_sink(const std::string &hostport, const StreamInfo &info, std::string *error);
+
+class NetClient {
+ public:
+  enum Result { READY, TIMEOUT, CLOSED };
+
+  ~NetClient();
+
+  // "tcp:HOST:PORT" or "udp:HOST:PORT"
+  bool open(const std::string &spec, const NetRequest &request, std::string *error);
+
+  // wait up to timeout_ms (-1 forever) for the next frame; *payload stays
+  // valid until the next call. CLOSED also covers a corrupt stream.
+  Result read(NetFrame *frame, const uint8_t **payload, int timeout_ms);
+
+  const std::string &error() const { return error_; }
+
+ private:
+  bool fill(size_t len, int timeout_ms, Result *result);
+  void subscribe();
+
+  int fd_ = -1;
+  bool udp_ = false;
+  std::string request_;
+  std::string cookie_;  // udp: from the server's challenge
+  std::chrono::steady_clock::time_point subscribed_;
+  std::vector<uint8_t> buffer_;
+  size_t have_ = 0;   // tcp: bytes buffered
+  size_t used_ = 0;   // tcp: bytes already returned
+  std::string error_;
+};
+
+}  // namespace iq
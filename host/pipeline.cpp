@@ -0,0 +1,189 @@
+#include <time.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "pipeline.h"
+#include "unpack.h"
+
+namespace iq {
+
+bool parse_policy(const std::string &name, OverrunPolicy *policy) {
+  if (name == "block")
+    *policy = OVERRUN_BLOCK;
+  else if (name == "drop-oldest")
+    *policy = OVERRUN_DROP_OLDEST;
+  else if (name == "drop-newest")
+    *policy = OVERRUN_DROP_NEWEST;
+  else
+    return false;
+  return true;
+}
+
+const char *policy_name(OverrunPolicy policy) {
+  switch (policy) {
+    case OVERRUN_BLOCK:
+      return "block";
+    case OVERRUN_DROP_OLDEST:
+      return "drop-oldest";
+    case OVERRUN_DROP_NEWEST:
+      return "drop-newest";
+  }
+  return "?";
+}
+
+// blocks written per task before the worker moves on to other outputs
+constexpr int DRAIN_BATCH = 16;
+
+Consumer::Consumer(std::string device, std::unique_ptr<Sink> sink, OverrunPolicy policy, size_t depth,
+                   WorkerPool *pool)
+    : device_(std::move(device)), sink_(std::move(sink)), ring_(depth, policy), pool_(pool) {
+  if (sink_->may_stall())
+    writer_ = std::thread(&Consumer::run, this);
+}
+
+Consumer::~Consumer() { finish(); }
+
+bool Consumer::push(const Block &block) {
+  if (!alive())
+    return false;
+  if (sink_->nonblocking())
+    return write(block);
+  queue_depth_.record(ring_.size());
+  ring_.push(block);
+  if (!writer_.joinable())
+    schedule();
+  return true;
+}
+
+void Consumer::finish() {
+  ring_.close();
+  if (writer_.joinable()) {
+    writer_.join();
+    return;
+  }
+  schedule();
+  std::unique_lock<std::mutex> guard(lock_);
+  idle_.wait(guard, [&] { return !scheduled_.load(); });
+}
+
+// at most one drain task is queued or running per output
+void Consumer::schedule() {
+  // pairs with the fence in drain(): either it sees our block or we see it idle
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!scheduled_.exchange(true))
+    pool_->post([this] { drain(); });
+}
+
+void Consumer::drain() {
+  for (int k = 0; k < DRAIN_BATCH && alive() && ring_.try_pop(block_); k++)
+    write(block_);
+
+  // finish() may destroy us as soon as it sees scheduled_ clear, so clear
+  // it under the lock; a push that saw it still set is caught by the size check
+  std::lock_guard<std::mutex> guard(lock_);
+  scheduled_.store(false);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (alive() && ring_.size() > 0 && !scheduled_.exchange(true)) {
+    pool_->post([this] { drain(); });
+    return;
+  }
+  idle_.notify_all();
+}
+
+// the writer thread of an output that may stall
+void Consumer::run() {
+  while (alive() && ring_.pop(block_))
+    write(block_);
+}
+
+bool Consumer::write(const Block &block) {
+  auto start = std::chrono::steady_clock::now();
+  bool ok = sink_->write_block(block);
+  write_ns_.record(elapsed_ns(start));
+  if (!ok) {
+    fprintf(stderr, "%s: output %s closed\n", device_.c_str(), sink_->name().c_str());
+    alive_.store(false, std::memory_order_release);
+    // unblocks a reader waiting on a full ring
+    ring_.close();
+  }
+  return ok;
+}
+
+void Pipeline::add_output(std::unique_ptr<Sink> sink, OverrunPolicy policy, size_t depth) {
+  outputs_.push_back(std::make_unique<Consumer>(device_, std::move(sink), policy, depth, pool_));
+}
+
+void Pipeline::feed(const uint8_t *data, size_t len) {
+  auto start = std::chrono::steady_clock::now();
+  feed_pairs(data, len);
+  feed_ns_.record(elapsed_ns(start));
+}
+
+void Pipeline::feed_pairs(const uint8_t *data, size_t len) {
+  // complete a pair split across reads
+  while (partial_len_ > 0 && len > 0) {
+    partial_[partial_len_++] = *data++;
+    len--;
+    if (partial_len_ == SC12_BYTES) {
+      append(partial_, 1);
+      partial_len_ = 0;
+    }
+  }
+  // a read too short to complete the pair
+  if (partial_len_ > 0)
+    return;
+
+  size_t pairs = len / SC12_BYTES;
+  append(data, pairs);
+  data += pairs * SC12_BYTES;
+  len -= pairs * SC12_BYTES;
+
+  std::copy(data, data + len, partial_);
+  partial_len_ = len;
+}
+
+// unpack straight into the block being filled
+void Pipeline::append(const uint8_t *data, size_t pairs) {
+  while (pairs > 0) {
+    size_t n = std::min<size_t>(pairs, BLOCK_SAMPLES - block_.samples);
+    unpack_sc12(data, block_.iq + 2 * block_.samples, n);
+    block_.samples += n;
+    samples_ += n;
+    data += n * SC12_BYTES;
+    pairs -= n;
+    if (block_.samples == BLOCK_SAMPLES)
+      publish();
+  }
+}
+
+void Pipeline::publish() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  block_.time_ns = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+  for (auto &out : outputs_)
+    out->push(block_);
+
+  block_.seq++;
+  block_.samples = 0;
+}
+
+void Pipeline::finish() {
+  if (finished_)
+    return;
+  finished_ = true;
+  if (block_.samples > 0)
+    publish();
+  for (auto &out : outputs_)
+    out->finish();
+}
+
+size_t Pipeline::live_outputs() const {
+  size_t live = 0;
+  for (auto &out : outputs_)
+    live += out->alive();
+  return live;
+}
+
+}  // namespace iq
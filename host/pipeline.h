@@ -0,0 +1,121 @@
+// per-device pipeline: the reader thread feeds raw sc12 bytes in, they are
+// cut into fixed-size sc16 blocks and handed to each output through its own
+// spsc ring, so a slow output can only lose its own blocks (or, with
+// OVERRUN_BLOCK, stall the reader) and never hold up the others.
+//
+// outputs are written from a worker pool shared by every device: an output
+// with queued blocks gets a task that writes a few of them and requeues
+// itself, so threads scale with cpus rather than with outputs. sinks whose
+// writes never wait (shm:) skip the ring and are written by the reader;
+// sinks whose writes can wait on a reader indefinitely (pipes, sockets) get
+// a writer thread of their own, so they cannot starve the pool.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "block.h"
+#include "protocol.h"
+#include "sink.h"
+#include "spsc_ring.h"
+#include "telemetry.h"
+#include "worker_pool.h"
+
+namespace iq {
+
+// "block", "drop-oldest" or "drop-newest"
+bool parse_policy(const std::string &name, OverrunPolicy *policy);
+const char *policy_name(OverrunPolicy policy);
+
+class Consumer {
+ public:
+  Consumer(std::string device, std::unique_ptr<Sink> sink, OverrunPolicy policy, size_t depth, WorkerPool *pool);
+  ~Consumer();
+
+  // reader side; false once the output is gone
+  bool push(const Block &block);
+
+  bool alive() const { return alive_.load(std::memory_order_acquire); }
+  uint64_t overruns() const { return ring_.overruns(); }
+  const std::string &name() const { return sink_->name(); }
+
+  // for telemetry: blocks queued now and as each block arrived, the time
+  // each write_block took, and the sink's detections
+  size_t queued() const { return ring_.size(); }
+  size_t capacity() const { return ring_.capacity(); }
+  const Histogram &queue_depth() const { return queue_depth_; }
+  const Histogram &write_ns() const { return write_ns_; }
+  uint64_t detections() const { return sink_->detections(); }
+
+  // the sink's listeners, for the reader's epoll loop (see Sink::poll_fd)
+  int poll_fd() const { return sink_->poll_fd(); }
+  void service() { sink_->service(); }
+
+  // stop accepting blocks and wait for the queued ones to be written
+  void finish();
+
+ private:
+  void schedule();
+  void drain();
+  void run();
+  bool write(const Block &block);
+
+  std::string device_;
+  std::unique_ptr<Sink> sink_;
+  SpscRing<Block> ring_;
+  WorkerPool *pool_;
+  std::thread writer_;
+  std::atomic<bool> alive_{true};
+  std::atomic<bool> scheduled_{false};
+  std::mutex lock_;
+  std::condition_variable idle_;
+  Block block_;
+  Histogram queue_depth_{0, 12};
+  Histogram write_ns_{10, 30};
+};
+
+class Pipeline {
+ public:
+  Pipeline(std::string device, WorkerPool *pool) : device_(std::move(device)), pool_(pool) {}
+  ~Pipeline() { finish(); }
+
+  void add_output(std::unique_ptr<Sink> sink, OverrunPolicy policy, size_t depth);
+
+  // reader side: any number of bytes, split anywhere
+  void feed(const uint8_t *data, size_t len);
+
+  // publish the partial last block and drain every output
+  void finish();
+
+  // outputs that can still take blocks
+  size_t live_outputs() const;
+
+  const std::vector<std::unique_ptr<Consumer>> &outputs() const { return outputs_; }
+  uint64_t samples() const { return samples_; }
+  // time spent unpacking each read and handing out its blocks
+  const Histogram &feed_ns() const { return feed_ns_; }
+
+ private:
+  void feed_pairs(const uint8_t *data, size_t len);
+  void append(const uint8_t *data, size_t pairs);
+  void publish();
+
+  std::string device_;
+  WorkerPool *pool_;
+  std::vector<std::unique_ptr<Consumer>> outputs_;
+  Block block_ = {};
+  uint8_t partial_[SC12_BYTES];
+  size_t partial_len_ = 0;
+  uint64_t samples_ = 0;
+  bool finished_ = false;
+  Histogram feed_ns_{10, 30};
+};
+
+}  // namespace iq
@@ -0,0 +1,53 @@
+// firmware usb command protocol, mirrored from src/app.c
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace iq {
+
+// artery's cdc vcp ids, which the firmware keeps
+constexpr uint16_t MODULE_VID = 0x2E3C;
+constexpr uint16_t MODULE_PID = 0x5740;
+
+enum : uint32_t {
+  CFG_GPIO_PIN = 0x1000,
+  CFG_DMA = 0x1001,
+  CFG_ADC = 0x1002,
+  TRIGGER_ADC = 0x1003,
+  READ_ADC = 0x1004,
+  SET_GPIO_PIN = 0x1005,
+  READ_VITALS = 0x1006,
+  CFG_CLUTTER = 0x1007,
+  BENCH_CFAR = 0x1008,
+  CFG_TRIGGER = 0x1009,
+  READ_TRIGGERED = 0x100A,
+  READ_VERSION = 0x100B,
+  READ_PROFILE = 0x100C,  // reply: prof_report_t (src/prof.h)
+};
+
+// READ_VERSION reply: (cmd_code, status) then a nul-padded string
+constexpr size_t FW_VERSION_SIZE = 32;
+
+enum : uint32_t {
+  GPIOA = 0x00,
+  GPIOB = 0x01,
+};
+
+enum : uint32_t {
+  GPIO_INPUT = 0x00,
+  GPIO_OUTPUT = 0x10,
+  GPIO_MUX = 0x08,
+  GPIO_ANALOG = 0x03,
+};
+
+// one dma block: 1024 i/q pairs packed as sc12 (3 bytes per pair)
+constexpr size_t BLOCK_SAMPLES = 1024;
+constexpr size_t SC12_BYTES = 3;
+constexpr size_t BLOCK_BYTES = BLOCK_SAMPLES * SC12_BYTES;
+
+// 48 MHz adc clock / (2 channels * (71.5 + 12.5) cycles)
+constexpr double SAMPLE_RATE = 285714.0;
+
+}  // namespace iq
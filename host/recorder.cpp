@@ -0,0 +1,259 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "recorder.h"
+
+namespace iq {
+
+namespace {
+
+// O_DIRECT wants buffers, lengths and offsets aligned to the logical block
+// size; a page covers every device we record to
+constexpr size_t ALIGN = 4096;
+
+bool parse_size(const std::string &text, uint64_t *out) {
+  char *end;
+  double v = strtod(text.c_str(), &end);
+  switch (*end) {
+    case 'k': case 'K': v *= 1 << 10; end++; break;
+    case 'm': case 'M': v *= 1 << 20; end++; break;
+    case 'g': case 'G': v *= 1 << 30; end++; break;
+  }
+  *out = uint64_t(v);
+  return end != text.c_str() && *end == 0 && v >= 0;
+}
+
+bool parse_duration(const std::string &text, double *out) {
+  char *end;
+  double v = strtod(text.c_str(), &end);
+  switch (*end) {
+    case 's': end++; break;
+    case 'm': v *= 60; end++; break;
+    case 'h': v *= 3600; end++; break;
+  }
+  *out = v;
+  return end != text.c_str() && *end == 0 && v >= 0;
+}
+
+}  // namespace
+
+bool parse_record_spec(const std::string &spec, std::string *path, RecordOptions *options, std::string *error) {
+  size_t slash = spec.rfind('/');
+  size_t comma = spec.find(',', slash == std::string::npos ? 0 : slash);
+  *path = spec.substr(0, comma);
+
+  RecordOptions o;
+  bool prealloc_rotate = false;
+  while (comma != std::string::npos) {
+    size_t next = spec.find(',', comma + 1);
+    std::string opt = spec.substr(comma + 1, next == std::string::npos ? std::string::npos : next - comma - 1);
+    comma = next;
+
+    size_t eq = opt.find('=');
+    std::string key = opt.substr(0, eq), value = eq == std::string::npos ? "" : opt.substr(eq + 1);
+    uint64_t size = 0;
+    bool ok = true;
+    if (key == "rotate")
+      ok = parse_size(value, &o.rotate_bytes);
+    else if (key == "every")
+      ok = parse_duration(value, &o.rotate_seconds);
+    else if (key == "direct" && value.empty())
+      o.direct = true;
+    else if (key == "prealloc" && value.empty())
+      prealloc_rotate = true;
+    else if (key == "prealloc")
+      ok = parse_size(value, &o.preallocate);
+    else if (key == "fsync")
+      ok = parse_duration(value, &o.fsync_seconds);
+    else if (key == "chunk" || key == "backlog")
+      ok = parse_size(value, &size) && size > 0;
+    else
+      ok = false;
+    if (!ok) {
+      *error = *path + ": bad option '" + opt + "'";
+      return false;
+    }
+    if (key == "chunk")
+      o.chunk = size;
+    else if (key == "backlog")
+      o.backlog = size;
+  }
+  if (prealloc_rotate)
+    o.preallocate = o.rotate_bytes;
+  *options = o;
+  return true;
+}
+
+std::string rotated_path(const std::string &path, unsigned n) {
+  char num[16];
+  snprintf(num, sizeof(num), "%03u", n);
+  size_t at = path.find("{n}");
+  if (at != std::string::npos)
+    return path.substr(0, at) + num + path.substr(at + 3);
+
+  size_t slash = path.rfind('/');
+  size_t dot = path.rfind('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash) || dot == slash + 1)
+    return path + "." + num;
+  return path.substr(0, dot) + "." + num + path.substr(dot);
+}
+
+bool Recorder::open(const std::string &path, const RecordOptions &options, std::string *error) {
+  path_ = path;
+  options_ = options;
+  options_.chunk = (options.chunk + ALIGN - 1) / ALIGN * ALIGN;
+  size_ = 0;
+  error_.clear();
+
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (options.direct ? O_DIRECT : 0), 0644);
+  if (fd_ < 0) {
+    *error = path + ": " + (options.direct && errno == EINVAL ? "O_DIRECT is not supported here" : strerror(errno));
+    return false;
+  }
+  // filesystems without fallocate just allocate as they go
+  if (options.preallocate > 0 && fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, options.preallocate) != 0 &&
+      errno != EOPNOTSUPP) {
+    *error = path + ": fallocate: " + strerror(errno);
+    ::close(fd_);
+    fd_ = -1;
+    return false;
+  }
+
+  // one chunk being filled, the rest writing or waiting
+  for (size_t k = 0; k < options_.backlog + 1; k++) {
+    void *p;
+    if (posix_memalign(&p, ALIGN, options_.chunk) != 0) {
+      *error = path + ": out of memory";
+      close();
+      return false;
+    }
+    buffers_.push_back(static_cast<uint8_t *>(p));
+  }
+  free_.assign(buffers_.begin() + 1, buffers_.end());
+  current_ = {buffers_[0], 0};
+  closing_ = false;
+  failed_ = false;
+  synced_ = std::chrono::steady_clock::now();
+  thread_ = std::thread([this] { run(); });
+  return true;
+}
+
+bool Recorder::append(const void *data, size_t len) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  while (len > 0) {
+    size_t n = std::min(len, options_.chunk - current_.len);
+    memcpy(current_.data + current_.len, p, n);
+    current_.len += n;
+    size_ += n;
+    p += n;
+    len -= n;
+
+    if (current_.len == options_.chunk) {
+      std::unique_lock<std::mutex> guard(lock_);
+      changed_.wait(guard, [&] { return !free_.empty() || failed_; });
+      if (failed_)
+        return false;
+      queue_.push_back(current_);
+      current_ = {free_.back(), 0};
+      free_.pop_back();
+      changed_.notify_all();
+    }
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  return !failed_;
+}
+
+void Recorder::run() {
+  std::unique_lock<std::mutex> guard(lock_);
+  while (true) {
+    changed_.wait(guard, [&] { return !queue_.empty() || closing_; });
+    if (queue_.empty())
+      return;
+    Chunk chunk = queue_.front();
+    queue_.pop_front();
+    bool skip = failed_;
+
+    guard.unlock();
+    bool ok = skip || write_chunk(chunk);
+    guard.lock();
+
+    if (!ok && !failed_) {
+      failed_ = true;
+      error_ = path_ + ": " + strerror(errno);
+    }
+    free_.push_back(chunk.data);
+    changed_.notify_all();
+  }
+}
+
+bool Recorder::write_chunk(const Chunk &chunk) {
+  // only the tail written on close can be short; it goes through the page cache
+  if (options_.direct && chunk.len % ALIGN != 0 && fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT) != 0)
+    return false;
+
+  const uint8_t *p = chunk.data;
+  size_t len = chunk.len;
+  while (len > 0) {
+    ssize_t n = ::write(fd_, p, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= n;
+  }
+
+  if (options_.fsync_seconds > 0) {
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - synced_).count() >= options_.fsync_seconds) {
+      if (fdatasync(fd_) != 0)
+        return false;
+      synced_ = now;
+    }
+  }
+  return true;
+}
+
+bool Recorder::close(const void *head, size_t head_len) {
+  if (fd_ < 0)
+    return true;
+
+  if (thread_.joinable()) {
+    std::unique_lock<std::mutex> guard(lock_);
+    if (current_.len > 0)
+      queue_.push_back(current_);
+    current_ = {nullptr, 0};
+    closing_ = true;
+    changed_.notify_all();
+    guard.unlock();
+    thread_.join();
+  }
+
+  bool ok = !failed_;
+  if (ok && head_len > 0) {
+    if (options_.direct)
+      fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+    ok = pwrite(fd_, head, head_len, 0) == ssize_t(head_len);
+  }
+  if (ok && options_.fsync_seconds > 0)
+    ok = fdatasync(fd_) == 0;
+  if (!ok && error_.empty())
+    error_ = path_ + ": " + strerror(errno);
+  ::close(fd_);
+  fd_ = -1;
+
+  for (uint8_t *p : buffers_)
+    free(p);
+  buffers_.clear();
+  free_.clear();
+  queue_.clear();
+  return ok;
+}
+
+}  // namespace iq
@@ -0,0 +1,90 @@
+// file writer for long recordings on slow, wear-sensitive storage
+//
+// appends are gathered into large aligned chunks, and a thread of the
+// recorder's own writes each whole chunk with one write(), so the card sees
+// a few big sequential writes per second instead of one per block. up to
+// `backlog` full chunks wait in memory for that thread; past that, append()
+// blocks, and the output's ring upstream decides what gives.
+//
+// options: O_DIRECT (chunks are page-aligned in memory and on disk, so the
+// page cache is bypassed), fallocate() preallocation (KEEP_SIZE, so readers
+// still see only what was written), and fdatasync() at most every
+// fsync_seconds. rotation by size or time is left to the format being
+// written, which knows where its records start (see CaptureWriter).
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace iq {
+
+struct RecordOptions {
+  size_t chunk = 1 << 20;       // bytes per write(); rounded up to 4 KiB
+  size_t backlog = 4;           // full chunks that may wait for the writer
+  bool direct = false;          // O_DIRECT
+  uint64_t preallocate = 0;     // fallocate() this many bytes on open
+  uint64_t rotate_bytes = 0;    // start a new file past this size; 0 never
+  double rotate_seconds = 0;    // ... or after this long; 0 never
+  double fsync_seconds = 0;     // fdatasync() this often and on close; 0 never
+};
+
+// "PATH[,OPTION]..." where OPTION is rotate=SIZE, every=DURATION, direct,
+// prealloc[=SIZE], fsync=DURATION, chunk=SIZE or backlog=N. SIZE takes a
+// k/M/G suffix, DURATION s/m/h. prealloc alone preallocates rotate=.
+bool parse_record_spec(const std::string &spec, std::string *path, RecordOptions *options, std::string *error);
+
+// path for the n-th file of a rotated recording: {n} in the path, or
+// .NNN before the extension
+std::string rotated_path(const std::string &path, unsigned n);
+
+class Recorder {
+ public:
+  ~Recorder() { close(); }
+
+  bool open(const std::string &path, const RecordOptions &options, std::string *error);
+  // copies; blocks while the backlog is full. false after a write error.
+  bool append(const void *data, size_t len);
+  // writes everything out, then head (if any) at offset 0
+  bool close(const void *head = nullptr, size_t head_len = 0);
+
+  bool is_open() const { return fd_ >= 0; }
+  // bytes appended to this file
+  uint64_t size() const { return size_; }
+  const std::string &error() const { return error_; }
+
+ private:
+  struct Chunk {
+    uint8_t *data;
+    size_t len;
+  };
+
+  void run();
+  bool write_chunk(const Chunk &chunk);
+  void fail(const std::string &what);
+
+  int fd_ = -1;
+  std::string path_;
+  RecordOptions options_;
+  uint64_t size_ = 0;
+  std::string error_;
+
+  std::vector<uint8_t *> buffers_;
+  std::vector<uint8_t *> free_;
+  std::deque<Chunk> queue_;
+  Chunk current_ = {nullptr, 0};
+  bool closing_ = false;
+  bool failed_ = false;
+  std::mutex lock_;
+  std::condition_variable changed_;
+  std::thread thread_;
+  std::chrono::steady_clock::time_point synced_;
+};
+
+}  // namespace iq
@@ -0,0 +1,120 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "replay.h"
+
+namespace iq {
+
+namespace {
+
+void to_pairs(const int16_t *iq, size_t samples, uint16_t (*pairs)[2]) {
+  for (size_t k = 0; k < samples; k++) {
+    pairs[k][0] = std::min<int>(std::max<int>(iq[2 * k], 0), 0xfff);
+    pairs[k][1] = std::min<int>(std::max<int>(iq[2 * k + 1], 0), 0xfff);
+  }
+}
+
+}  // namespace
+
+Replay::~Replay() {
+  if (raw_)
+    munmap(const_cast<uint8_t *>(raw_), raw_size_);
+}
+
+bool Replay::open(const std::string &path, std::string *error) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  char magic[sizeof(CAPTURE_MAGIC)] = {};
+  bool capture = fd >= 0 && ::read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+                 memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) == 0;
+  if (fd >= 0)
+    ::close(fd);
+
+  if (capture) {
+    capture_ = std::make_unique<CaptureReader>();
+    if (!capture_->open(path, error))
+      return false;
+    const CaptureHeader &h = capture_->header();
+    if (h.block_samples != BLOCK_SAMPLES) {
+      *error = path + ": replay needs " + std::to_string(BLOCK_SAMPLES) + "-sample records";
+      return false;
+    }
+    blocks_ = capture_->blocks();
+    sample_rate_ = h.sample_rate > 0 ? h.sample_rate : SAMPLE_RATE;
+    firmware_ = std::string(h.firmware, strnlen(h.firmware, sizeof(h.firmware)));
+    uint64_t first = blocks_ ? capture_->record(0).time_ns : 0;
+    offsets_.resize(blocks_);
+    for (uint64_t k = 0; k < blocks_; k++) {
+      uint64_t t = capture_->record(k).time_ns;
+      offsets_[k] = std::max(t > first ? t - first : 0, k ? offsets_[k - 1] : 0);
+    }
+    return true;
+  }
+
+  if (is_sigmf(path)) {
+    sigmf_ = std::make_unique<SigmfReader>();
+    if (!sigmf_->open(path, error))
+      return false;
+    samples_ = sigmf_->samples();
+    sample_rate_ = sigmf_->sample_rate() > 0 ? sigmf_->sample_rate() : SAMPLE_RATE;
+  } else {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      *error = path + ": " + strerror(errno);
+      if (fd >= 0)
+        ::close(fd);
+      return false;
+    }
+    raw_size_ = st.st_size;
+    void *map = raw_size_ ? mmap(nullptr, raw_size_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (map == MAP_FAILED) {
+      *error = path + ": " + (raw_size_ ? std::string("mmap: ") + strerror(errno) : "empty");
+      raw_size_ = 0;
+      return false;
+    }
+    raw_ = static_cast<const uint8_t *>(map);
+    samples_ = raw_size_ / SC12_BYTES;
+  }
+
+  // sigmf capture segments restart the clock after each gap
+  blocks_ = (samples_ + BLOCK_SAMPLES - 1) / BLOCK_SAMPLES;
+  offsets_.resize(blocks_);
+  uint64_t first = sigmf_ ? sigmf_->time_of(0) : 0;
+  for (uint64_t k = 0; k < blocks_; k++) {
+    uint64_t end = std::min((k + 1) * BLOCK_SAMPLES, samples_);
+    uint64_t t = first ? sigmf_->time_of(end - 1) : 0;
+    offsets_[k] = t ? (t > first ? t - first : 0) : uint64_t(end * 1e9 / sample_rate_);
+    offsets_[k] = std::max(offsets_[k], k ? offsets_[k - 1] : 0);
+  }
+  return true;
+}
+
+size_t Replay::read(uint64_t k, uint16_t (*pairs)[2]) const {
+  int16_t iq[2 * BLOCK_SAMPLES];
+  if (capture_) {
+    size_t n = capture_->read(k, iq);
+    to_pairs(iq, n, pairs);
+    return n;
+  }
+  if (sigmf_) {
+    size_t n = sigmf_->read(k * BLOCK_SAMPLES, iq, BLOCK_SAMPLES);
+    to_pairs(iq, n, pairs);
+    return n;
+  }
+  size_t n = std::min<uint64_t>(BLOCK_SAMPLES, samples_ - k * BLOCK_SAMPLES);
+  const uint8_t *in = raw_ + k * BLOCK_BYTES;
+  for (size_t x = 0; x < n; x++, in += SC12_BYTES) {
+    pairs[x][0] = in[0] << 4 | in[1] >> 4;
+    pairs[x][1] = (in[1] & 0xf) << 8 | in[2];
+  }
+  return n;
+}
+
+}  // namespace iq
@@ -0,0 +1,55 @@
+// recordings played back as a module's adc: the simulator's replay=PATH
+// option (see simulator.h) streams them through the live code path, so a
+// field recording can be pushed back through iqd's pipeline, detectors
+// and outputs, or through the host build of the firmware
+//
+// PATH is an iqd capture (capture.h), whose records carry the time each
+// block completed; a sigmf dataset (sigmf.h); or raw sc12 as stream-iq.py
+// writes it (output.iq). the last two are timed at their sample rate.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "capture.h"
+#include "protocol.h"
+#include "sigmf.h"
+
+namespace iq {
+
+class Replay {
+ public:
+  ~Replay();
+
+  bool open(const std::string &path, std::string *error);
+
+  // blocks of BLOCK_SAMPLES pairs; only the last may be short
+  uint64_t blocks() const { return blocks_; }
+  double sample_rate() const { return sample_rate_; }
+  // READ_VERSION of the recorded module, if the recording has it
+  const std::string &firmware() const { return firmware_; }
+
+  // block k as raw 12-bit pairs; returns how many
+  size_t read(uint64_t k, uint16_t (*pairs)[2]) const;
+
+  // when block k completed, from the start of the recording. never
+  // decreases, even where the recording host's clock stepped back.
+  uint64_t offset_ns(uint64_t k) const { return offsets_[k]; }
+
+ private:
+  std::unique_ptr<CaptureReader> capture_;
+  std::unique_ptr<SigmfReader> sigmf_;
+  const uint8_t *raw_ = nullptr;  // mmapped sc12
+  size_t raw_size_ = 0;
+  uint64_t samples_ = 0;
+  uint64_t blocks_ = 0;
+  double sample_rate_ = SAMPLE_RATE;
+  std::string firmware_;
+  std::vector<uint64_t> offsets_;
+};
+
+}  // namespace iq
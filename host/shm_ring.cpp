@@ -0,0 +1,238 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "shm_ring.h"
+
+namespace iq {
+
+namespace {
+
+constexpr size_t PAGE = 4096;
+
+// shared (not FUTEX_PRIVATE) so waits and wakes meet across processes
+void futex_wait(const std::atomic<uint32_t> *word, uint32_t expected, int timeout_ms) {
+  struct timespec ts = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+  syscall(SYS_futex, word, FUTEX_WAIT, expected, timeout_ms < 0 ? nullptr : &ts, nullptr, 0);
+}
+
+void futex_wake(std::atomic<uint32_t> *word) {
+  syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+size_t header_size() { return (sizeof(ShmHeader) + PAGE - 1) / PAGE * PAGE; }
+
+class ShmSink : public Sink {
+ public:
+  explicit ShmSink(std::string name) : name_(std::move(name)) {}
+
+  ShmWriter &writer() { return writer_; }
+
+  bool write(const void *, size_t) override { return false; }
+  bool write_block(const Block &block) override {
+    writer_.publish(block);
+    return true;
+  }
+  bool nonblocking() const override { return true; }
+  const std::string &name() const override { return name_; }
+
+ private:
+  std::string name_;
+  ShmWriter writer_;
+};
+
+}  // namespace
+
+bool ShmWriter::open(const std::string &name, const StreamInfo &info, std::string *error, uint32_t slots) {
+  if (name.empty() || name.find('/') != std::string::npos || slots < 2) {
+    *error = "shm:" + name + ": expected a name without '/'";
+    return false;
+  }
+  name_ = "/" + name;
+  size_ = header_size() + size_t(slots) * sizeof(ShmSlot);
+
+  int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    *error = "shm:" + name + ": " + strerror(errno);
+    return false;
+  }
+  if (ftruncate(fd, size_) != 0) {
+    *error = "shm:" + name + ": " + strerror(errno);
+    ::close(fd);
+    shm_unlink(name_.c_str());
+    return false;
+  }
+  void *map = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    *error = "shm:" + name + ": mmap: " + strerror(errno);
+    shm_unlink(name_.c_str());
+    return false;
+  }
+
+  // ftruncate zero-filled it: every slot version is 0, ie. never written
+  header_ = new (map) ShmHeader;
+  slots_ = reinterpret_cast<ShmSlot *>(static_cast<uint8_t *>(map) + header_size());
+  header_->version = SHM_VERSION;
+  header_->slots = slots;
+  header_->slot_size = sizeof(ShmSlot);
+  header_->header_size = header_size();
+  header_->sample_rate = info.sample_rate;
+  header_->generation = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::system_clock::now().time_since_epoch()).count();
+  strncpy(header_->device_id, info.device_id.c_str(), sizeof(header_->device_id) - 1);
+  strncpy(header_->firmware, info.firmware.c_str(), sizeof(header_->firmware) - 1);
+  header_->head.store(0);
+  header_->futex.store(0);
+  header_->closed.store(0);
+  // the magic goes last: readers that find it find a complete header
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header_->magic, SHM_MAGIC, sizeof(SHM_MAGIC));
+  return true;
+}
+
+void ShmWriter::publish(const Block &block) {
+  uint64_t n = header_->head.load(std::memory_order_relaxed);
+  ShmSlot &slot = slots_[n % header_->slots];
+
+  slot.version.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&slot.block, &block, sizeof(Block));
+  slot.version.store(2 * n + 2, std::memory_order_release);
+
+  header_->head.store(n + 1, std::memory_order_release);
+  header_->futex.fetch_add(1, std::memory_order_release);
+  futex_wake(&header_->futex);
+}
+
+void ShmWriter::close() {
+  if (!header_)
+    return;
+  header_->closed.store(1, std::memory_order_release);
+  header_->futex.fetch_add(1, std::memory_order_release);
+  futex_wake(&header_->futex);
+  shm_unlink(name_.c_str());
+  munmap(header_, size_);
+  header_ = nullptr;
+}
+
+ShmReader::~ShmReader() {
+  if (header_)
+    munmap(const_cast<ShmHeader *>(header_), size_);
+}
+
+bool ShmReader::open(const std::string &name, std::string *error, bool from_oldest) {
+  std::string path = "/" + name;
+  int fd = shm_open(path.c_str(), O_RDONLY | O_CLOEXEC, 0);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    *error = "shm:" + name + ": " + strerror(errno);
+    if (fd >= 0)
+      ::close(fd);
+    return false;
+  }
+  size_ = st.st_size;
+  void *map = size_ >= sizeof(ShmHeader) ? mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    *error = "shm:" + name + ": not an iqd stream";
+    return false;
+  }
+  header_ = static_cast<const ShmHeader *>(map);
+
+  if (memcmp(header_->magic, SHM_MAGIC, sizeof(SHM_MAGIC)) != 0 || header_->version != SHM_VERSION ||
+      header_->slot_size != sizeof(ShmSlot) || header_->header_size + size_t(header_->slots) * sizeof(ShmSlot) > size_) {
+    *error = "shm:" + name + ": not an iqd stream, or a different version";
+    munmap(map, size_);
+    header_ = nullptr;
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  slots_ = reinterpret_cast<const ShmSlot *>(static_cast<const uint8_t *>(map) + header_->header_size);
+
+  uint64_t head = header_->head.load(std::memory_order_acquire);
+  uint64_t oldest = head > header_->slots - 1 ? head - (header_->slots - 1) : 0;
+  next_ = from_oldest ? oldest : head;
+  return true;
+}
+
+ShmReader::Result ShmReader::acquire(const Block **block, int timeout_ms) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  uint32_t slots = header_->slots;
+
+  while (true) {
+    uint32_t futex = header_->futex.load(std::memory_order_acquire);
+    uint64_t head = header_->head.load(std::memory_order_acquire);
+
+    if (next_ < head) {
+      // the slot after head's is the oldest one the publisher is not rewriting
+      uint64_t oldest = head > slots - 1 ? head - (slots - 1) : 0;
+      if (next_ < oldest) {
+        lost_ += oldest - next_;
+        next_ = oldest;
+      }
+      const ShmSlot &slot = slots_[next_ % slots];
+      uint64_t version = slot.version.load(std::memory_order_acquire);
+      if (version != 2 * next_ + 2) {
+        lost_++;
+        next_++;
+        continue;
+      }
+      held_version_ = version;
+      *block = &slot.block;
+      return READY;
+    }
+
+    if (header_->closed.load(std::memory_order_acquire))
+      return CLOSED;
+
+    int wait_ms = -1;
+    if (timeout_ms >= 0) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0)
+        return TIMEOUT;
+      wait_ms = left.count();
+    }
+    futex_wait(&header_->futex, futex, wait_ms);
+  }
+}
+
+bool ShmReader::release() {
+  const ShmSlot &slot = slots_[next_ % header_->slots];
+  std::atomic_thread_fence(std::memory_order_acquire);
+  bool intact = slot.version.load(std::memory_order_relaxed) == held_version_;
+  if (!intact)
+    lost_++;
+  next_++;
+  return intact;
+}
+
+ShmReader::Result ShmReader::read(Block *out, int timeout_ms) {
+  while (true) {
+    const Block *block;
+    Result r = acquire(&block, timeout_ms);
+    if (r != READY)
+      return r;
+    memcpy(out, block, sizeof(Block));
+    if (release())
+      return READY;
+  }
+}
+
+std::unique_ptr<Sink> open_shm_sink(const std::string &name, const StreamInfo &info, std::string *error) {
+  auto sink = std::make_unique<ShmSink>("shm:" + name);
+  if (!sink->writer().open(name, info, error))
+    return nullptr;
+  return sink;
+}
+
+}  // namespace iq
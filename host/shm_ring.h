@@ -0,0 +1,110 @@
+// shared-memory fan-out of a device's blocks to any number of local readers
+//
+// iqd publishes into a posix shm object (/dev/shm/NAME) laid out as a
+// header and a ring of slots; readers map it read-only and never write to
+// it, so a reader can neither slow the publisher nor disturb other readers.
+//
+// each slot has a version word: 2n+1 while block n is being written into
+// it, 2n+2 once it is complete. header.head counts published blocks. a
+// reader wanting block n checks head, reads the slot's version, uses the
+// block in place, and checks the version again: if it moved, the publisher
+// lapped the reader and the block is counted as lost. readers that fall
+// more than a ring behind skip ahead, also counting the loss.
+//
+// the publisher bumps a futex word after each block, so idle readers sleep
+// instead of polling. when the publisher exits it sets closed and unlinks
+// the name; mapped readers drain what is left and then see end of stream.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "block.h"
+#include "sink.h"
+
+namespace iq {
+
+constexpr char SHM_MAGIC[8] = {'I', 'Q', 'S', 'H', 'M', 0, 0, 1};
+constexpr uint32_t SHM_VERSION = 1;
+constexpr uint32_t SHM_DEFAULT_SLOTS = 256;
+
+struct ShmHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t slots;
+  uint32_t slot_size;        // sizeof(ShmSlot); slots start at header_size
+  uint32_t header_size;
+  double sample_rate;
+  uint64_t generation;       // publisher start time, ns
+  char device_id[64];
+  char firmware[64];
+  alignas(64) std::atomic<uint64_t> head;  // blocks published
+  std::atomic<uint32_t> futex;             // bumped after every block
+  std::atomic<uint32_t> closed;
+};
+
+struct alignas(64) ShmSlot {
+  std::atomic<uint64_t> version;
+  Block block;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "shared atomics must be address-free");
+
+class ShmWriter {
+ public:
+  ~ShmWriter() { close(); }
+
+  bool open(const std::string &name, const StreamInfo &info, std::string *error,
+            uint32_t slots = SHM_DEFAULT_SLOTS);
+  // never blocks
+  void publish(const Block &block);
+  // mark the stream closed and unlink the name
+  void close();
+
+ private:
+  std::string name_;
+  ShmHeader *header_ = nullptr;
+  ShmSlot *slots_ = nullptr;
+  size_t size_ = 0;
+};
+
+class ShmReader {
+ public:
+  enum Result { READY, TIMEOUT, CLOSED };
+
+  ~ShmReader();
+
+  // start at the newest block, or at the oldest still in the ring
+  bool open(const std::string &name, std::string *error, bool from_oldest = false);
+  const ShmHeader &header() const { return *header_; }
+
+  // zero-copy: wait up to timeout_ms (-1 forever) for the next block and
+  // point *block at it in the shared ring
+  Result acquire(const Block **block, int timeout_ms);
+  // done with the acquired block; false if it was overwritten meanwhile,
+  // in which case whatever was read from it must be discarded
+  bool release();
+
+  // copying convenience over acquire()/release()
+  Result read(Block *out, int timeout_ms);
+
+  // blocks the publisher overwrote before this reader got to them
+  uint64_t lost() const { return lost_; }
+
+ private:
+  const ShmHeader *header_ = nullptr;
+  const ShmSlot *slots_ = nullptr;
+  size_t size_ = 0;
+  uint64_t next_ = 0;
+  uint64_t lost_ = 0;
+  uint64_t held_version_ = 0;
+};
+
+// "shm:NAME" outputs
+std::unique_ptr<Sink> open_shm_sink(const std::string &name, const StreamInfo &info, std::string *error);
+
+}  // namespace iq
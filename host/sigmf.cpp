@@ -0,0 +1,373 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include "sigmf.h"
+
+namespace iq {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "sigmf _le datatypes are written in host order");
+
+namespace {
+
+constexpr auto META_INTERVAL = std::chrono::seconds(5);
+constexpr int SC16_MID = 2048;
+
+bool ends_with(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string format_datetime(uint64_t ns) {
+  time_t t = ns / 1000000000ull;
+  struct tm tm;
+  char buf[64];
+  gmtime_r(&t, &tm);
+  size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  snprintf(buf + n, sizeof(buf) - n, ".%06lluZ", (unsigned long long)(ns / 1000 % 1000000));
+  return buf;
+}
+
+// iso 8601 utc, as sigmf requires; 0 if unparseable
+uint64_t parse_datetime(const std::string &s) {
+  struct tm tm = {};
+  int consumed = 0;
+  if (sscanf(s.c_str(), "%d-%d-%dT%d:%d:%d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min,
+             &tm.tm_sec, &consumed) != 6)
+    return 0;
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  uint64_t ns = uint64_t(timegm(&tm)) * 1000000000ull;
+
+  const char *p = s.c_str() + consumed;
+  if (*p == '.') {
+    uint64_t scale = 100000000;
+    for (p++; *p >= '0' && *p <= '9'; p++, scale /= 10)
+      ns += (*p - '0') * scale;
+  }
+  return ns;
+}
+
+std::string number(double v) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.17g", v);
+  return buf;
+}
+
+class SigmfSink : public Sink {
+ public:
+  explicit SigmfSink(std::string name) : name_(std::move(name)) {}
+
+  SigmfWriter &writer() { return writer_; }
+
+  // raw bytes carry no block boundaries to segment or annotate
+  bool write(const void *, size_t) override { return false; }
+  bool write_block(const Block &block) override { return writer_.write(block); }
+  const std::string &name() const override { return name_; }
+  uint64_t detections() const override { return writer_.detections(); }
+
+ private:
+  std::string name_;
+  SigmfWriter writer_;
+};
+
+}  // namespace
+
+std::string sigmf_base(const std::string &path) {
+  for (const char *ext : {".sigmf-meta", ".sigmf-data"}) {
+    if (ends_with(path, ext))
+      return path.substr(0, path.size() - strlen(ext));
+  }
+  return path;
+}
+
+bool is_sigmf(const std::string &path) {
+  if (ends_with(path, ".sigmf-meta") || ends_with(path, ".sigmf-data"))
+    return true;
+  struct stat st;
+  return stat((path + ".sigmf-meta").c_str(), &st) == 0;
+}
+
+bool SigmfWriter::open(const std::string &base, SigmfType type, const StreamInfo &info, std::string *error,
+                       bool detect) {
+  base_ = base;
+  type_ = type;
+  info_ = info;
+  data_ = fopen((base + ".sigmf-data").c_str(), "we");
+  if (!data_) {
+    *error = base + ".sigmf-data: " + strerror(errno);
+    return false;
+  }
+  setvbuf(data_, nullptr, _IOFBF, 1 << 20);
+  convert_.resize(BLOCK_SAMPLES * 2 * (type == SIGMF_CF32 ? sizeof(float) : sizeof(int16_t)));
+
+  if (detect) {
+    DetectorConfig config;
+    config.sample_rate = info.sample_rate;
+    detector_ = std::make_unique<Detector>(config);
+  }
+
+  meta_written_ = std::chrono::steady_clock::now();
+  if (!write_meta()) {
+    *error = error_;
+    return false;
+  }
+  return true;
+}
+
+bool SigmfWriter::write(const Block &block) {
+  if (!data_)
+    return false;
+
+  // a new capture segment wherever samples went missing
+  if (samples_ == 0 || block.seq != next_seq_) {
+    end_run();
+    if (samples_ > 0) {
+      std::ostringstream a;
+      a << "{\"core:sample_start\": " << samples_ << ", \"core:sample_count\": 0"
+        << ", \"core:label\": \"dropped\", \"core:comment\": "
+        << json_quote(std::to_string(block.seq - next_seq_) + " blocks lost before this sample") << "}";
+      annotations_.push_back(a.str());
+    }
+    uint64_t start_ns = block.time_ns - uint64_t(block.samples * 1e9 / info_.sample_rate);
+    std::ostringstream c;
+    c << "{\"core:sample_start\": " << samples_ << ", \"core:datetime\": " << json_quote(format_datetime(start_ns))
+      << "}";
+    captures_.push_back(c.str());
+  }
+  next_seq_ = block.seq + 1;
+
+  size_t values = block.samples * 2;
+  if (type_ == SIGMF_CF32) {
+    float *out = reinterpret_cast<float *>(convert_.data());
+    for (size_t k = 0; k < values; k++)
+      out[k] = (block.iq[k] - SC16_MID) * (1.0f / SC16_MID);
+  } else {
+    int16_t *out = reinterpret_cast<int16_t *>(convert_.data());
+    for (size_t k = 0; k < values; k++)
+      out[k] = block.iq[k] - SC16_MID;
+  }
+  size_t bytes = values * (type_ == SIGMF_CF32 ? sizeof(float) : sizeof(int16_t));
+  if (fwrite(convert_.data(), 1, bytes, data_) != bytes) {
+    error_ = base_ + ".sigmf-data: " + strerror(errno);
+    return false;
+  }
+
+  Detection d;
+  if (detector_ && detector_->process(block, &d)) {
+    detections_.fetch_add(1, std::memory_order_relaxed);
+    if (!in_run_) {
+      in_run_ = true;
+      run_start_ = samples_;
+      run_ = d;
+      run_blocks_ = 0;
+    }
+    run_.low_hz = std::min(run_.low_hz, d.low_hz);
+    run_.high_hz = std::max(run_.high_hz, d.high_hz);
+    if (d.snr_db > run_.snr_db) {
+      run_.snr_db = d.snr_db;
+      run_.peak_hz = d.peak_hz;
+    }
+    run_blocks_++;
+    run_end_ = samples_ + block.samples;
+  } else {
+    end_run();
+  }
+  samples_ += block.samples;
+
+  if (std::chrono::steady_clock::now() - meta_written_ >= META_INTERVAL)
+    return write_meta();
+  return true;
+}
+
+void SigmfWriter::end_run() {
+  if (!in_run_)
+    return;
+  in_run_ = false;
+
+  char comment[128];
+  snprintf(comment, sizeof(comment), "peak %.1f Hz, %.1f dB over %u blocks", run_.peak_hz, run_.snr_db, run_blocks_);
+  std::ostringstream a;
+  a << "{\"core:sample_start\": " << run_start_ << ", \"core:sample_count\": " << run_end_ - run_start_
+    << ", \"core:freq_lower_edge\": " << number(run_.low_hz) << ", \"core:freq_upper_edge\": " << number(run_.high_hz)
+    << ", \"core:label\": \"cfar\", \"core:comment\": " << json_quote(comment) << "}";
+  annotations_.push_back(a.str());
+}
+
+bool SigmfWriter::write_meta() {
+  std::ostringstream m;
+  m << "{\n  \"global\": {\n"
+    << "    \"core:datatype\": \"" << (type_ == SIGMF_CF32 ? "cf32_le" : "ci16_le") << "\",\n"
+    << "    \"core:sample_rate\": " << number(info_.sample_rate) << ",\n"
+    << "    \"core:version\": \"1.0.0\",\n"
+    << "    \"core:num_channels\": 1,\n"
+    << "    \"core:hw\": \"Seeed 24GHz radar module, AT32F403A firmware " << info_.firmware << "\",\n"
+    << "    \"core:recorder\": \"iqd\",\n"
+    << "    \"core:description\": "
+    << json_quote("device " + info_.device_id + ", gain stage " + std::to_string(info_.gain) +
+                  ", 12-bit adc centred on 0")
+    << "\n  },\n  \"captures\": [";
+  for (size_t k = 0; k < captures_.size(); k++)
+    m << (k ? ",\n    " : "\n    ") << captures_[k];
+  m << (captures_.empty() ? "],\n" : "\n  ],\n") << "  \"annotations\": [";
+  for (size_t k = 0; k < annotations_.size(); k++)
+    m << (k ? ",\n    " : "\n    ") << annotations_[k];
+  m << (annotations_.empty() ? "]\n}\n" : "\n  ]\n}\n");
+
+  // the meta file is replaced, never rewritten in place
+  std::string path = base_ + ".sigmf-meta", tmp = path + ".tmp";
+  std::string text = m.str();
+  FILE *f = fopen(tmp.c_str(), "we");
+  bool ok = f && fwrite(text.data(), 1, text.size(), f) == text.size();
+  if (f && fclose(f) != 0)
+    ok = false;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    error_ = path + ": " + strerror(errno);
+    return false;
+  }
+  meta_written_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+bool SigmfWriter::close() {
+  if (!data_)
+    return true;
+  end_run();
+  bool ok = fflush(data_) == 0;
+  if (!ok)
+    error_ = base_ + ".sigmf-data: " + strerror(errno);
+  fclose(data_);
+  data_ = nullptr;
+  return write_meta() && ok;
+}
+
+SigmfReader::~SigmfReader() {
+  if (map_)
+    munmap(const_cast<uint8_t *>(map_), size_);
+}
+
+bool SigmfReader::open(const std::string &path, std::string *error) {
+  std::string base = sigmf_base(path);
+  std::ifstream in(base + ".sigmf-meta");
+  if (!in) {
+    *error = base + ".sigmf-meta: " + strerror(errno);
+    return false;
+  }
+  std::stringstream text;
+  text << in.rdbuf();
+  if (!parse_json(text.str(), &meta_, error)) {
+    *error = base + ".sigmf-meta: " + *error;
+    return false;
+  }
+
+  const Json &global = meta_["global"];
+  datatype_ = global["core:datatype"].str();
+  sample_rate_ = global["core:sample_rate"].num();
+  if (datatype_ == "ci16_le")
+    sample_bytes_ = 2 * sizeof(int16_t);
+  else if (datatype_ == "cf32_le")
+    sample_bytes_ = 2 * sizeof(float);
+  else {
+    *error = base + ".sigmf-meta: unsupported core:datatype '" + datatype_ + "' (ci16_le or cf32_le)";
+    return false;
+  }
+  if (global["core:num_channels"].num(1) != 1) {
+    *error = base + ".sigmf-meta: only single-channel datasets are supported";
+    return false;
+  }
+
+  const Json &captures = meta_["captures"];
+  for (size_t k = 0; k < captures.size(); k++)
+    captures_.push_back({uint64_t(captures[k]["core:sample_start"].num()),
+                         parse_datetime(captures[k]["core:datetime"].str())});
+  const Json &annotations = meta_["annotations"];
+  for (size_t k = 0; k < annotations.size(); k++) {
+    const Json &a = annotations[k];
+    annotations_.push_back({uint64_t(a["core:sample_start"].num()), uint64_t(a["core:sample_count"].num()),
+                            a["core:freq_lower_edge"].num(NAN), a["core:freq_upper_edge"].num(NAN),
+                            a["core:label"].str(), a["core:comment"].str()});
+  }
+
+  int fd = ::open((base + ".sigmf-data").c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    *error = base + ".sigmf-data: " + strerror(errno);
+    if (fd >= 0)
+      ::close(fd);
+    return false;
+  }
+  size_ = st.st_size;
+  samples_ = size_ / sample_bytes_;
+  if (size_ > 0) {
+    void *map = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+      *error = base + ".sigmf-data: mmap: " + strerror(errno);
+      ::close(fd);
+      return false;
+    }
+    map_ = static_cast<const uint8_t *>(map);
+  }
+  ::close(fd);
+  return true;
+}
+
+size_t SigmfReader::read(uint64_t start, int16_t *out, size_t count) const {
+  if (start >= samples_)
+    return 0;
+  count = std::min<uint64_t>(count, samples_ - start);
+  size_t values = count * 2;
+
+  if (sample_bytes_ == 2 * sizeof(int16_t)) {
+    const int16_t *in = reinterpret_cast<const int16_t *>(map_) + start * 2;
+    for (size_t k = 0; k < values; k++)
+      out[k] = std::min(std::max(in[k] + SC16_MID, 0), 4095);
+  } else {
+    const float *in = reinterpret_cast<const float *>(map_) + start * 2;
+    for (size_t k = 0; k < values; k++)
+      out[k] = std::min(std::max(std::lround(in[k] * SC16_MID) + SC16_MID, 0l), 4095l);
+  }
+  return count;
+}
+
+uint64_t SigmfReader::time_of(uint64_t sample) const {
+  // the last segment starting at or before the sample
+  auto it = std::upper_bound(captures_.begin(), captures_.end(), sample,
+                             [](uint64_t s, const Capture &c) { return s < c.sample_start; });
+  if (it == captures_.begin() || (it - 1)->time_ns == 0)
+    return 0;
+  --it;
+  return it->time_ns + uint64_t((sample - it->sample_start) * 1e9 / sample_rate_);
+}
+
+uint64_t SigmfReader::seek_time(uint64_t time_ns) const {
+  for (size_t k = 0; k < captures_.size(); k++) {
+    const Capture &c = captures_[k];
+    uint64_t end = k + 1 < captures_.size() ? captures_[k + 1].sample_start : samples_;
+    if (c.time_ns == 0)
+      continue;
+    if (time_ns <= c.time_ns)
+      return c.sample_start;
+    uint64_t sample = c.sample_start + uint64_t(std::ceil((time_ns - c.time_ns) * sample_rate_ / 1e9));
+    if (sample < end)
+      return sample;
+  }
+  return samples_;
+}
+
+std::unique_ptr<Sink> open_sigmf_sink(const std::string &base, SigmfType type, const StreamInfo &info,
+                                      std::string *error) {
+  auto sink = std::make_unique<SigmfSink>((type == SIGMF_CF32 ? "sigmf-cf32:" : "sigmf:") + base);
+  if (!sink->writer().open(base, type, info, error))
+    return nullptr;
+  return sink;
+}
+
+}  // namespace iq
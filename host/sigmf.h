@@ -0,0 +1,131 @@
+// sigmf datasets: BASE.sigmf-data plus BASE.sigmf-meta
+//
+// the writer converts blocks as they stream (ci16_le: x - 2048, cf32_le:
+// (x - 2048) / 2048) and keeps the metadata beside them: a capture segment
+// at the start and after every gap in block sequence numbers, a "dropped"
+// annotation for each gap, and "cfar" annotations from a detector run over
+// every block. the meta file is rewritten (write + rename) every few
+// seconds and on close, so it is always valid json.
+//
+// the reader mmaps a dataset, parses its metadata and hands samples back
+// as sc16 (0..4095), the same as every other source on the host side.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block.h"
+#include "detector.h"
+#include "json.h"
+#include "sink.h"
+
+namespace iq {
+
+enum SigmfType {
+  SIGMF_CI16,  // ci16_le
+  SIGMF_CF32,  // cf32_le
+};
+
+class SigmfWriter {
+ public:
+  ~SigmfWriter() { close(); }
+
+  // base is the path without the .sigmf-* extension
+  bool open(const std::string &base, SigmfType type, const StreamInfo &info, std::string *error,
+            bool detect = true);
+  bool write(const Block &block);
+  bool close();
+
+  const std::string &error() const { return error_; }
+  // blocks the detector fired on
+  uint64_t detections() const { return detections_.load(std::memory_order_relaxed); }
+
+ private:
+  void end_run();
+  bool write_meta();
+
+  FILE *data_ = nullptr;
+  std::string base_;
+  SigmfType type_ = SIGMF_CI16;
+  StreamInfo info_;
+  std::string error_;
+  std::vector<uint8_t> convert_;
+  uint64_t samples_ = 0;
+  uint64_t next_seq_ = 0;
+  std::vector<std::string> captures_;     // rendered json objects
+  std::vector<std::string> annotations_;
+  std::chrono::steady_clock::time_point meta_written_;
+
+  // consecutive blocks with detections become one annotation
+  std::unique_ptr<Detector> detector_;
+  bool in_run_ = false;
+  uint64_t run_start_ = 0;
+  uint64_t run_end_ = 0;
+  Detection run_ = {};
+  uint32_t run_blocks_ = 0;
+  std::atomic<uint64_t> detections_{0};
+};
+
+class SigmfReader {
+ public:
+  struct Capture {
+    uint64_t sample_start;
+    uint64_t time_ns;  // 0 when the segment has no core:datetime
+  };
+  struct Annotation {
+    uint64_t sample_start;
+    uint64_t sample_count;
+    double freq_lower;
+    double freq_upper;
+    std::string label;
+    std::string comment;
+  };
+
+  ~SigmfReader();
+
+  // path is BASE, BASE.sigmf-meta or BASE.sigmf-data
+  bool open(const std::string &path, std::string *error);
+
+  const Json &meta() const { return meta_; }
+  const std::string &datatype() const { return datatype_; }
+  double sample_rate() const { return sample_rate_; }
+  uint64_t samples() const { return samples_; }
+  const std::vector<Capture> &captures() const { return captures_; }
+  const std::vector<Annotation> &annotations() const { return annotations_; }
+
+  // samples [start, start + count) as sc16; returns how many were read
+  size_t read(uint64_t start, int16_t *out, size_t count) const;
+
+  // wall-clock time of a sample, from the capture segments (0 if unknown)
+  uint64_t time_of(uint64_t sample) const;
+  // first sample at or after time_ns
+  uint64_t seek_time(uint64_t time_ns) const;
+
+ private:
+  Json meta_;
+  std::string datatype_;
+  double sample_rate_ = 0;
+  size_t sample_bytes_ = 0;
+  uint64_t samples_ = 0;
+  std::vector<Capture> captures_;
+  std::vector<Annotation> annotations_;
+  const uint8_t *map_ = nullptr;
+  size_t size_ = 0;
+};
+
+// BASE for any of BASE, BASE.sigmf-meta and BASE.sigmf-data
+std::string sigmf_base(const std::string &path);
+// path names a sigmf dataset (by extension, or BASE.sigmf-meta exists)
+bool is_sigmf(const std::string &path);
+
+// "sigmf:BASE" (ci16_le) and "sigmf-cf32:BASE" outputs
+std::unique_ptr<Sink> open_sigmf_sink(const std::string &base, SigmfType type, const StreamInfo &info,
+                                      std::string *error);
+
+}  // namespace iq
@@ -0,0 +1,547 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <thread>
+
+#include "app.h"
+#include "async_transport.h"
+#include "fake_hal.h"
+#include "simulator.h"
+
+namespace iq {
+
+namespace {
+
+constexpr size_t PACKET_SIZE = 64;  // USBD_CDC_OUT_MAXPACKET_SIZE
+constexpr size_t NOISE_TABLE = 1 << 16;
+
+uint64_t next_random(uint64_t *state) {
+  // xorshift64*
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1Dull;
+}
+
+double uniform(uint64_t *state) { return (next_random(state) >> 11) * (1.0 / (1ull << 53)); }
+
+// unit gaussians, drawn from at random per sample: far cheaper than
+// box-muller per sample, and indistinguishable for a 12-bit adc
+const std::vector<float> &noise_table() {
+  static const std::vector<float> table = [] {
+    std::vector<float> t(NOISE_TABLE);
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t k = 0; k < NOISE_TABLE; k += 2) {
+      double u = std::max(uniform(&state), 1e-300), v = uniform(&state);
+      double r = std::sqrt(-2 * std::log(u));
+      t[k] = r * std::cos(2 * M_PI * v);
+      t[k + 1] = r * std::sin(2 * M_PI * v);
+    }
+    return t;
+  }();
+  return table;
+}
+
+// the firmware's sc12 packing (app_pack_block without clutter)
+void pack(const uint16_t (*pairs)[2], size_t count, uint8_t *out) {
+  for (size_t k = 0; k < count; k++) {
+    out[3 * k] = pairs[k][0] >> 4;
+    out[3 * k + 1] = (pairs[k][0] & 0xf) << 4 | pairs[k][1] >> 8;
+    out[3 * k + 2] = pairs[k][1] & 0xff;
+  }
+}
+
+bool is_socket(int fd) {
+  struct stat st;
+  return fstat(fd, &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+void sleep_until(const struct timespec &t) {
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, nullptr) == EINTR) {
+  }
+}
+
+struct timespec add_ns(struct timespec t, uint64_t ns) {
+  ns += t.tv_nsec;
+  t.tv_sec += ns / 1000000000ull;
+  t.tv_nsec = ns % 1000000000ull;
+  return t;
+}
+
+int64_t diff_ns(const struct timespec &a, const struct timespec &b) {
+  return (a.tv_sec - b.tv_sec) * 1000000000ll + (a.tv_nsec - b.tv_nsec);
+}
+
+ssize_t put(int fd, bool socket, const void *p, size_t len) {
+  return socket ? send(fd, p, len, MSG_NOSIGNAL) : ::write(fd, p, len);
+}
+
+bool put_all(int fd, bool socket, const uint8_t *p, size_t len, const std::atomic<bool> &stop) {
+  while (len > 0) {
+    ssize_t n = put(fd, socket, p, len);
+    if (n > 0) {
+      p += n;
+      len -= n;
+      continue;
+    }
+    if (n < 0 && errno != EAGAIN && errno != EINTR)
+      return false;
+    struct pollfd pfd = {fd, POLLOUT, 0};
+    poll(&pfd, 1, 100);
+    if (stop.load())
+      return false;
+  }
+  return true;
+}
+
+class SimTransport : public Transport {
+ public:
+  SimTransport(int host, int sim, const SimConfig &config) : host_(host), sim_(sim), simulator_(config) {
+    // the host reads the end of a replay as the module going away
+    thread_ = std::thread([this] {
+      simulator_.serve(sim_, stop_);
+      shutdown(sim_, SHUT_RDWR);
+    });
+  }
+  ~SimTransport() override {
+    stop_.store(true);
+    shutdown(host_, SHUT_RDWR);
+    thread_.join();
+    close(host_);
+    close(sim_);
+  }
+
+  int fd() const override { return host_; }
+  ssize_t read(void *buf, size_t len) override { return ::read(host_, buf, len); }
+  ssize_t write(const void *buf, size_t len) override { return send(host_, buf, len, MSG_NOSIGNAL); }
+
+ private:
+  int host_;
+  int sim_;
+  Simulator simulator_;
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+// sim:async: the socketpair's far end drained by a thread standing in for
+// libusb's event thread, each read a completed bulk transfer
+class AsyncSimTransport : public AsyncTransport {
+ public:
+  AsyncSimTransport(int host, int sim, const SimConfig &config)
+      : AsyncTransport(config.ring), host_(host), sim_(sim), simulator_(config) {
+    thread_ = std::thread([this] {
+      simulator_.serve(sim_, stop_);
+      shutdown(sim_, SHUT_RDWR);
+    });
+    completions_ = std::thread([this, size = config.async] {
+      std::vector<uint8_t> transfer(size);
+      while (!stop_.load()) {
+        struct pollfd pfd = {host_, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0)
+          continue;
+        ssize_t n = ::read(host_, transfer.data(), transfer.size());
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+          continue;
+        if (n <= 0) {
+          hangup();
+          return;
+        }
+        push(transfer.data(), n);
+      }
+    });
+  }
+  ~AsyncSimTransport() override {
+    stop_.store(true);
+    shutdown(host_, SHUT_RDWR);
+    thread_.join();
+    completions_.join();
+    close(host_);
+    close(sim_);
+  }
+
+  ssize_t transmit(const void *buf, size_t len) override { return send(host_, buf, len, MSG_NOSIGNAL); }
+
+ private:
+  int host_;
+  int sim_;
+  Simulator simulator_;
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+  std::thread completions_;
+};
+
+}  // namespace
+
+bool parse_sim_spec(const std::string &spec, SimConfig *config, std::string *error) {
+  SimConfig c;
+  size_t at = 0;
+  while (at < spec.size()) {
+    size_t comma = spec.find(',', at);
+    std::string opt = spec.substr(at, comma == std::string::npos ? std::string::npos : comma - at);
+    at = comma == std::string::npos ? spec.size() : comma + 1;
+    if (opt.empty())
+      continue;
+
+    size_t eq = opt.find('=');
+    std::string key = opt.substr(0, eq), value = eq == std::string::npos ? "" : opt.substr(eq + 1);
+    const char *v = value.c_str();
+    char *end = nullptr;
+    bool ok = true;
+    if (key == "target") {
+      SimTarget t = {strtod(v, &end), 200};
+      if (*end == '@')
+        t.amplitude = strtod(end + 1, &end);
+      ok = end != v && *end == 0;
+      c.targets.push_back(t);
+    } else if (key == "noise") {
+      c.noise = strtod(v, &end);
+    } else if (key == "dc") {
+      c.dc_i = strtod(v, &end);
+      ok = *end == ':';
+      if (ok)
+        c.dc_q = strtod(end + 1, &end);
+    } else if (key == "rate") {
+      c.rate = strtod(v, &end);
+      ok = c.rate > 0;
+    } else if (key == "fast" && value.empty()) {
+      c.fast = true;
+    } else if (key == "drop") {
+      c.drop = strtod(v, &end);
+    } else if (key == "short") {
+      c.short_writes = strtod(v, &end);
+    } else if (key == "seed") {
+      c.seed = strtoul(v, &end, 0);
+    } else if (key == "version") {
+      c.version = value;
+    } else if (key == "firmware" && value.empty()) {
+      c.firmware = true;
+    } else if (key == "replay" && !value.empty()) {
+      auto replay = std::make_shared<Replay>();
+      if (!replay->open(value, error))
+        return false;
+      c.replay = replay;
+    } else if (key == "speed") {
+      c.speed = strtod(v, &end);
+      ok = c.speed > 0;
+    } else if (key == "loop" && value.empty()) {
+      c.loop = true;
+    } else if (key == "async") {
+      c.async = value.empty() ? 32768 : strtoul(v, &end, 0);
+      ok = c.async > 0;
+    } else if (key == "ring") {
+      c.ring = strtoul(v, &end, 0);
+      ok = c.ring > 0;
+    } else {
+      ok = false;
+    }
+    if (!ok || (end && (end == v || *end != 0))) {
+      *error = "sim: bad option '" + opt + "'";
+      return false;
+    }
+  }
+  if (c.replay && !c.replay->firmware().empty() && spec.find("version=") == std::string::npos)
+    c.version = c.replay->firmware();
+  *config = c;
+  return true;
+}
+
+void Simulator::sample(uint16_t (*pairs)[2]) {
+  const std::vector<float> &noise = noise_table();
+  // tones as rotating phasors, restarted from the exact phase each block so
+  // rounding never accumulates
+  std::vector<std::complex<double>> z(config_.targets.size()), w(config_.targets.size());
+  for (size_t t = 0; t < z.size(); t++) {
+    double step = 2 * M_PI * config_.targets[t].doppler_hz / config_.rate;
+    z[t] = std::polar(config_.targets[t].amplitude, std::fmod(step * double(sample_), 2 * M_PI));
+    w[t] = std::polar(1.0, step);
+  }
+
+  for (size_t k = 0; k < BLOCK_SAMPLES; k++) {
+    double i = config_.dc_i, q = config_.dc_q;
+    for (size_t t = 0; t < z.size(); t++) {
+      i += z[t].real();
+      q += z[t].imag();
+      z[t] *= w[t];
+    }
+    uint64_t r = next_random(&rng_);
+    i += config_.noise * noise[r & (NOISE_TABLE - 1)];
+    q += config_.noise * noise[(r >> 16) & (NOISE_TABLE - 1)];
+
+    pairs[k][0] = std::lround(std::min(std::max(i, 0.0), 4095.0));
+    pairs[k][1] = std::lround(std::min(std::max(q, 0.0), 4095.0));
+  }
+  sample_ += BLOCK_SAMPLES;
+}
+
+void Simulator::synthesise(uint8_t *out) {
+  uint16_t pairs[BLOCK_SAMPLES][2];
+  sample(pairs);
+  pack(pairs, BLOCK_SAMPLES, out);
+}
+
+size_t Simulator::replay_next(uint16_t (*pairs)[2], struct timespec *due) {
+  const Replay &r = *config_.replay;
+  if (replay_block_ >= r.blocks()) {
+    if (!config_.loop || r.blocks() == 0)
+      return 0;
+    // the next pass follows one block period after the last block
+    replay_base_ns_ += r.offset_ns(r.blocks() - 1) + uint64_t(BLOCK_SAMPLES * 1e9 / r.sample_rate());
+    replay_block_ = 0;
+  }
+  uint64_t k = replay_block_++;
+  *due = add_ns(replay_start_, uint64_t((replay_base_ns_ + r.offset_ns(k)) / config_.speed));
+  return r.read(k, pairs);
+}
+
+void Simulator::serve(int fd, const std::atomic<bool> &stop) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  bool socket = is_socket(fd);
+  rng_ = 0x853C49E6748FEA9Bull ^ (uint64_t(config_.seed) << 1 | 1);
+  fault_rng_ = 0xDA942042E4DD58B5ull ^ (uint64_t(config_.seed) << 1 | 1);
+  sent_ = dropped_ = 0;
+  sample_ = 0;
+  replay_block_ = replay_base_ns_ = 0;
+  if (config_.firmware) {
+    serve_firmware(fd, stop);
+    return;
+  }
+
+  uint32_t packet[PACKET_SIZE / 4 + FW_VERSION_SIZE / 4];
+  while (!stop.load()) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0)
+      continue;
+    ssize_t n = ::read(fd, packet, PACKET_SIZE);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+      continue;
+    if (n <= 0)
+      return;
+    if (n < 4)
+      continue;
+
+    // replies reuse the packet: cmd_code, then status in args[0]
+    size_t reply = 8;
+    switch (packet[0]) {
+      case CFG_GPIO_PIN:
+        packet[1] = n >= 16 && packet[1] <= GPIOB ? 0 : 1;
+        break;
+      case CFG_DMA:
+      case CFG_ADC:
+      case TRIGGER_ADC:
+        packet[1] = 0;
+        break;
+      case READ_VERSION:
+        packet[1] = 0;
+        memset(&packet[2], 0, FW_VERSION_SIZE);
+        strncpy(reinterpret_cast<char *>(&packet[2]), config_.version.c_str(), FW_VERSION_SIZE - 1);
+        reply += FW_VERSION_SIZE;
+        break;
+      case READ_ADC:
+        if (!stream(fd, stop))
+          return;
+        continue;
+      default:
+        continue;
+    }
+    if (!put_all(fd, socket, reinterpret_cast<uint8_t *>(packet), reply, stop))
+      return;
+  }
+}
+
+// READ_ADC: paced like the adc's dma, which keeps running while usb is
+// stalled, so blocks that fall due during a stall are lost, as on hardware.
+// a replay starts from its beginning each session and loses nothing.
+bool Simulator::stream(int fd, const std::atomic<bool> &stop) {
+  uint8_t block[BLOCK_BYTES];
+  uint64_t block_ns = uint64_t(BLOCK_SAMPLES * 1e9 / config_.rate);
+  struct timespec due;
+  clock_gettime(CLOCK_MONOTONIC, &due);
+  replay_start_ = due;
+  replay_block_ = replay_base_ns_ = 0;
+
+  while (!stop.load()) {
+    size_t len = BLOCK_BYTES;
+    if (config_.replay) {
+      uint16_t pairs[BLOCK_SAMPLES][2];
+      size_t n = replay_next(pairs, &due);
+      if (n == 0)
+        return false;
+      if (!config_.fast)
+        sleep_until(due);
+      pack(pairs, n, block);
+      len = n * SC12_BYTES;
+    } else {
+      if (!config_.fast) {
+        sleep_until(due);
+        due = add_ns(due, block_ns);
+      }
+      synthesise(block);
+    }
+
+    if (config_.drop > 0 && uniform(&fault_rng_) < config_.drop)
+      dropped_++;
+    else if (!write_block(fd, block, len, stop))
+      return false;
+    else
+      sent_++;
+
+    if (!config_.fast && !config_.replay) {
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      int64_t behind = diff_ns(now, due) / int64_t(block_ns);
+      if (behind > 1) {
+        sample_ += behind * BLOCK_SAMPLES;
+        dropped_ += behind;
+        due = add_ns(due, behind * block_ns);
+      }
+    }
+
+    // the firmware ignores commands while streaming; a fresh CFG_GPIO_PIN
+    // stands in for the reset a real module needs before the next session
+    uint32_t packet[PACKET_SIZE / 4];
+    ssize_t n = ::read(fd, packet, sizeof(packet));
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+      return false;
+    if (n >= 4 && packet[0] == CFG_GPIO_PIN) {
+      uint32_t reply[2] = {CFG_GPIO_PIN, n >= 16 && packet[1] <= GPIOB ? 0u : 1u};
+      return put_all(fd, is_socket(fd), reinterpret_cast<uint8_t *>(reply), sizeof(reply), stop);
+    }
+  }
+  return false;
+}
+
+bool Simulator::write_block(int fd, const uint8_t *block, size_t len, const std::atomic<bool> &stop) {
+  bool socket = is_socket(fd);
+  if (config_.short_writes <= 0 || uniform(&fault_rng_) >= config_.short_writes)
+    return put_all(fd, socket, block, len, stop);
+
+  // two to four pieces, cut anywhere (mostly mid-pair), with a pause
+  // between them so the host's reads really do come back short
+  size_t cuts[4] = {0}, pieces = 2 + next_random(&fault_rng_) % 3;
+  for (size_t k = 1; k < pieces; k++)
+    cuts[k] = 1 + next_random(&fault_rng_) % (len - 1);
+  std::sort(cuts, cuts + pieces);
+  for (size_t k = 0; k < pieces; k++) {
+    size_t end = k + 1 < pieces ? cuts[k + 1] : len;
+    if (!put_all(fd, socket, block + cuts[k], end - cuts[k], stop))
+      return false;
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  return true;
+}
+
+// the firmware build answers; the simulator is its adc and its usb cable.
+// pacing, drops and short writes work as in stream(), applied to whatever
+// the firmware sends while streaming
+void Simulator::serve_firmware(int fd, const std::atomic<bool> &stop) {
+  FakeHal &hal = fake_hal();
+  bool socket = is_socket(fd), gone = false, ended = false;
+  uint64_t block_ns = uint64_t(BLOCK_SAMPLES * 1e9 / config_.rate);
+  struct timespec due;
+  clock_gettime(CLOCK_MONOTONIC, &due);
+
+  hal_init();
+  app_init();
+  hal.tx = [&](const uint8_t *data, size_t len) {
+    if (gone)
+      return true;
+    if (!app_streaming())
+      gone = !put_all(fd, socket, data, len, stop);
+    else if (config_.drop > 0 && uniform(&fault_rng_) < config_.drop)
+      dropped_++;
+    else if (!(gone = !write_block(fd, data, len, stop)))
+      sent_++;
+    return true;
+  };
+  // the firmware waits on the dma flag; this waits for the block to fall due.
+  // it packs whole blocks, so a replay's short last block is left out.
+  hal.adc = [&](uint16_t (*pairs)[2], size_t) {
+    if (config_.replay) {
+      if (replay_block_ == 0 && replay_base_ns_ == 0)
+        clock_gettime(CLOCK_MONOTONIC, &replay_start_);
+      struct timespec block_due;
+      size_t n = replay_next(pairs, &block_due);
+      if (n > 0 && n < BLOCK_SAMPLES && config_.loop && replay_block_ > 1)
+        n = replay_next(pairs, &block_due);
+      if (n < BLOCK_SAMPLES) {
+        ended = true;
+        return false;
+      }
+      if (!config_.fast)
+        sleep_until(block_due);
+      return true;
+    }
+    if (!config_.fast) {
+      sleep_until(due);
+      due = add_ns(due, block_ns);
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      int64_t behind = diff_ns(now, due) / int64_t(block_ns);
+      if (behind > 1) {
+        sample_ += behind * BLOCK_SAMPLES;
+        dropped_ += behind;
+        due = add_ns(due, behind * block_ns);
+      }
+    }
+    sample(pairs);
+    return true;
+  };
+
+  uint8_t packet[PACKET_SIZE];
+  while (!stop.load() && !gone && !ended) {
+    if (!app_streaming() && hal.rx.empty()) {
+      struct pollfd pfd = {fd, POLLIN, 0};
+      if (poll(&pfd, 1, 100) <= 0)
+        continue;
+    }
+    ssize_t n = ::read(fd, packet, sizeof(packet));
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+      break;
+    if (n >= 4) {
+      uint32_t cmd;
+      memcpy(&cmd, packet, 4);
+      // a fresh CFG_GPIO_PIN stands in for the reset between sessions
+      if (app_streaming() && cmd == CFG_GPIO_PIN) {
+        hal_init();
+        app_init();
+        clock_gettime(CLOCK_MONOTONIC, &due);
+        replay_block_ = replay_base_ns_ = 0;
+      }
+      // like the endpoint, hold one packet until the firmware reads it
+      if (hal.rx.empty())
+        hal.rx.emplace_back(packet, packet + n);
+    }
+    app_poll();
+  }
+  hal.tx = nullptr;
+  hal.adc = nullptr;
+}
+
+std::unique_ptr<Transport> open_sim(const std::string &spec, std::string *error) {
+  SimConfig config;
+  if (!parse_sim_spec(spec.compare(0, 4, "sim:") == 0 ? spec.substr(4) : "", &config, error))
+    return nullptr;
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+    *error = spec + ": " + strerror(errno);
+    return nullptr;
+  }
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  if (config.async > 0)
+    return std::make_unique<AsyncSimTransport>(fds[0], fds[1], config);
+  return std::make_unique<SimTransport>(fds[0], fds[1], config);
+}
+
+}  // namespace iq
@@ -0,0 +1,130 @@
+// software radar module: answers the firmware's command set (src/app.c)
+// and streams sc12 blocks synthesised from doppler targets, noise and a dc
+// offset, so the host side can be run and measured without hardware
+//
+// a spec is a comma-separated list of options, any of which may be left out:
+//
+//   target=HZ[@AMP]   a doppler tone (repeatable); AMP in adc counts (200)
+//   noise=RMS         gaussian noise per channel, adc counts (8)
+//   dc=I:Q            the static offset the tones ride on (2048:2048)
+//   rate=PAIRS        i/q pairs per second (285714)
+//   fast              no pacing: send as fast as the host reads
+//   drop=P            probability that a block is lost before it is sent
+//   short=P           probability that a block goes out in several short
+//                     writes split mid-pair, as usb packets can arrive
+//   seed=N            for the noise and the injected faults
+//   version=STRING    READ_VERSION reply ("sim")
+//   firmware          answer with the firmware's own command handling and
+//                     packing (src/app.c built for the host, on the fake
+//                     drivers in fake_hal.h), the signal standing in for
+//                     the adc. READ_VITALS, READ_TRIGGERED, CFG_CLUTTER and
+//                     BENCH_CFAR then work too, and READ_VERSION reports the
+//                     build. one firmware simulator per process.
+//   replay=PATH       stream a recording instead of the synthetic signal
+//                     (see replay.h): an iqd capture, a sigmf dataset or
+//                     raw sc12. captures are paced by their recorded block
+//                     times, the others at their sample rate. the host
+//                     sees the recording end as the module going away.
+//                     no block is dropped for falling behind, so the host
+//                     gets exactly the recorded samples. READ_VERSION then
+//                     reports the recorded firmware where known.
+//   speed=N           replay at N times the recorded pace (1); with fast,
+//                     as fast as the host reads
+//   loop              replay from the start again at the end
+//   async[=BYTES]     sim: devices only; hand the stream over through AsyncTransport, as
+//                     the libusb backend does: a completion thread takes it
+//                     in bulk transfers of up to BYTES (32768) and pushes
+//                     them into the ring, dropping whole pairs when it is
+//                     full and hanging up when the simulator goes away
+//   ring=BYTES        async: the ring between transfers and reads (4 MiB)
+//
+// like the firmware, each read from the host is taken as one usb packet:
+// a command and its arguments. unknown commands are ignored, and so are
+// packets while streaming, except that a CFG_GPIO_PIN starts a new session
+// (where a real module would need `make reset`).
+
+#pragma once
+
+#include <time.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "protocol.h"
+#include "replay.h"
+#include "transport.h"
+
+namespace iq {
+
+struct SimTarget {
+  double doppler_hz;
+  double amplitude;
+};
+
+struct SimConfig {
+  std::vector<SimTarget> targets;
+  double noise = 8;
+  double dc_i = 2048;
+  double dc_q = 2048;
+  double rate = SAMPLE_RATE;
+  bool fast = false;
+  double drop = 0;
+  double short_writes = 0;
+  uint32_t seed = 1;
+  std::string version = "sim";
+  bool firmware = false;
+  std::shared_ptr<const Replay> replay;
+  double speed = 1;
+  bool loop = false;
+  size_t async = 0;  // bytes per transfer; 0 reads the socketpair directly
+  size_t ring = 4 << 20;
+};
+
+bool parse_sim_spec(const std::string &spec, SimConfig *config, std::string *error);
+
+class Simulator {
+ public:
+  explicit Simulator(const SimConfig &config)
+      : config_(config), rng_(0x853C49E6748FEA9Bull ^ (uint64_t(config.seed) << 1 | 1)) {}
+
+  // speak the protocol on fd (a pty master or a socket) until the host
+  // hangs up, stop is set or a replay ends
+  void serve(int fd, const std::atomic<bool> &stop);
+
+  // blocks sent and blocks dropped by injection, for the last serve()
+  uint64_t sent() const { return sent_; }
+  uint64_t dropped() const { return dropped_; }
+
+  // next block of the signal, packed as the firmware packs it
+  void synthesise(uint8_t *out);
+
+  // next block of the signal as raw 12-bit pairs, as the adc's dma leaves it
+  void sample(uint16_t (*pairs)[2]);
+
+ private:
+  // false once the session is over: the host is gone or the replay ended
+  bool stream(int fd, const std::atomic<bool> &stop);
+  // next replayed block and when it falls due; 0 pairs at the end
+  size_t replay_next(uint16_t (*pairs)[2], struct timespec *due);
+  void serve_firmware(int fd, const std::atomic<bool> &stop);
+  bool write_block(int fd, const uint8_t *block, size_t len, const std::atomic<bool> &stop);
+
+  SimConfig config_;
+  uint64_t sample_ = 0;
+  uint64_t rng_;             // noise; seeded here for sample() and again by serve()
+  uint64_t fault_rng_ = 0;   // drops and short writes, so faults never change the signal
+  uint64_t sent_ = 0;
+  uint64_t dropped_ = 0;
+  uint64_t replay_block_ = 0;
+  uint64_t replay_base_ns_ = 0;  // recording time at the start of this pass
+  struct timespec replay_start_ = {};
+};
+
+// "sim[:SPEC]" devices: a simulator on a thread of its own, on the far end
+// of a socketpair, so iqd and benchmarks need no pty or second process
+std::unique_ptr<Transport> open_sim(const std::string &spec, std::string *error);
+
+}  // namespace iq
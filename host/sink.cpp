@@ -0,0 +1,137 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "netstream.h"
+#include "shm_ring.h"
+#include "sigmf.h"
+#include "sink.h"
+
+namespace iq {
+
+namespace {
+
+class FdSink : public Sink {
+ public:
+  FdSink(std::string name, int fd, bool owned) : name_(std::move(name)), fd_(fd), owned_(owned) {
+    struct stat st;
+    stalls_ = fstat(fd_, &st) != 0 || !(S_ISREG(st.st_mode) || S_ISBLK(st.st_mode));
+  }
+  ~FdSink() override {
+    if (owned_)
+      close(fd_);
+  }
+
+  bool write(const void *data, size_t len) override {
+    const char *p = static_cast<const char *>(data);
+    while (len > 0) {
+      ssize_t n = ::write(fd_, p, len);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  const std::string &name() const override { return name_; }
+  bool may_stall() const override { return stalls_; }
+
+ private:
+  std::string name_;
+  int fd_;
+  bool owned_;
+  bool stalls_;
+};
+
+int connect_tcp(const std::string &hostport, std::string *error) {
+  size_t colon = hostport.rfind(':');
+  if (colon == std::string::npos) {
+    *error = "tcp:" + hostport + ": expected HOST:PORT";
+    return -1;
+  }
+  std::string host = hostport.substr(0, colon), port = hostport.substr(colon + 1);
+
+  struct addrinfo hints = {}, *res;
+  hints.ai_socktype = SOCK_STREAM;
+  int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+  if (rc != 0) {
+    *error = "tcp:" + hostport + ": " + gai_strerror(rc);
+    return -1;
+  }
+
+  int fd = -1;
+  for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+      break;
+    if (fd >= 0)
+      close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  if (fd < 0)
+    *error = "tcp:" + hostport + ": " + strerror(errno);
+  return fd;
+}
+
+int connect_unix(const std::string &path, std::string *error) {
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    *error = "unix:" + path + ": path too long";
+    return -1;
+  }
+  memcpy(addr.sun_path, path.c_str(), path.size());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+    *error = "unix:" + path + ": " + strerror(errno);
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+}  // namespace
+
+std::unique_ptr<Sink> open_sink(const std::string &spec, const StreamInfo &info, std::string *error) {
+  if (spec == "-")
+    return std::make_unique<FdSink>("stdout", STDOUT_FILENO, false);
+  if (spec.compare(0, 8, "capture:") == 0)
+    return open_capture_sink(spec.substr(8), CAPTURE_SC12, info, error);
+  if (spec.compare(0, 6, "sigmf:") == 0)
+    return open_sigmf_sink(sigmf_base(spec.substr(6)), SIGMF_CI16, info, error);
+  if (spec.compare(0, 11, "sigmf-cf32:") == 0)
+    return open_sigmf_sink(sigmf_base(spec.substr(11)), SIGMF_CF32, info, error);
+  if (spec.compare(0, 4, "shm:") == 0)
+    return open_shm_sink(spec.substr(4), info, error);
+  if (spec.compare(0, 6, "serve:") == 0)
+    return open_server_sink(spec.substr(6), info, error);
+
+  int fd;
+  if (spec.compare(0, 4, "tcp:") == 0) {
+    fd = connect_tcp(spec.substr(4), error);
+  } else if (spec.compare(0, 5, "unix:") == 0) {
+    fd = connect_unix(spec.substr(5), error);
+  } else {
+    std::string path = spec.compare(0, 5, "file:") == 0 ? spec.substr(5) : spec;
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+      *error = path + ": " + strerror(errno);
+  }
+  if (fd < 0)
+    return nullptr;
+  return std::make_unique<FdSink>(spec, fd, true);
+}
+
+}  // namespace iq
@@ -0,0 +1,55 @@
+// sc16 output destinations
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "block.h"
+
+namespace iq {
+
+class Sink {
+ public:
+  virtual ~Sink() = default;
+
+  // blocking; false once the destination is gone
+  virtual bool write(const void *data, size_t len) = 0;
+  virtual const std::string &name() const = 0;
+
+  // pipelines hand over whole blocks; sinks that record more than the
+  // samples (seq, timestamps) override this
+  virtual bool write_block(const Block &block) {
+    return write(block.iq, block.samples * 2 * sizeof(int16_t));
+  }
+
+  // write_block never waits (shm:); the reader thread calls it directly
+  // rather than queueing blocks for a worker to copy
+  virtual bool nonblocking() const { return false; }
+
+  // write_block can wait for as long as whoever reads the destination likes
+  // (pipes, sockets); the pipeline gives such outputs a thread of their own
+  // so a stalled reader cannot hold a pool worker
+  virtual bool may_stall() const { return false; }
+
+  // sinks with sockets of their own (serve:) hand their owner an epoll fd,
+  // readable when service() has connects or requests to take; service()
+  // never blocks and may run while another thread is in write_block
+  virtual int poll_fd() const { return -1; }
+  virtual void service() {}
+
+  // blocks in which the sink's own detector found something (sigmf:,
+  // serve:), for telemetry; read from other threads while writes go on
+  virtual uint64_t detections() const { return 0; }
+};
+
+// "-" (stdout), "file:PATH" or a bare path, "tcp:HOST:PORT", "unix:PATH",
+// "capture:PATH" for an indexed capture file (see capture.h), or
+// "sigmf:BASE" / "sigmf-cf32:BASE" for a sigmf dataset (see sigmf.h),
+// "shm:NAME" for local readers of a shared-memory ring (see shm_ring.h), or
+// "serve:[HOST:]PORT" to serve tcp and udp clients (see netstream.h)
+std::unique_ptr<Sink> open_sink(const std::string &spec, const StreamInfo &info, std::string *error);
+
+}  // namespace iq
@@ -0,0 +1,142 @@
+// lock-free single-producer/single-consumer ring of fixed-size items
+//
+// head_ and tail_ are free-running 64-bit counters. the producer owns head_;
+// the consumer owns tail_, except under OVERRUN_DROP_OLDEST, where a producer
+// facing a full ring advances tail_ itself. the consumer therefore copies an
+// item out first and then claims it with a compare-exchange on tail_; if the
+// producer got there first, the copy is discarded and the next item is tried.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace iq {
+
+enum OverrunPolicy {
+  OVERRUN_BLOCK,        // producer waits for room
+  OVERRUN_DROP_OLDEST,  // producer discards the oldest queued item
+  OVERRUN_DROP_NEWEST,  // producer discards the item it is pushing
+};
+
+template <typename T>
+class SpscRing {
+  static_assert(std::is_trivially_copyable<T>::value, "items are copied with memcpy");
+
+ public:
+  SpscRing(size_t capacity, OverrunPolicy policy) : slots_(capacity), policy_(policy) {}
+
+  size_t capacity() const { return slots_.size(); }
+  size_t size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+  OverrunPolicy policy() const { return policy_; }
+
+  // items discarded because the ring was full
+  uint64_t overruns() const { return overruns_.load(std::memory_order_relaxed); }
+
+  // producer; false when the item was dropped or the ring was closed
+  bool push(const T &item) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+
+    while (head - tail >= slots_.size()) {
+      if (closed_.load(std::memory_order_acquire))
+        return false;
+      switch (policy_) {
+        case OVERRUN_DROP_NEWEST:
+          overruns_.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        case OVERRUN_DROP_OLDEST:
+          if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel))
+            overruns_.fetch_add(1, std::memory_order_relaxed);
+          tail = tail_.load(std::memory_order_acquire);
+          break;
+        case OVERRUN_BLOCK:
+          wait_for(space_, [&] { return head - tail_.load(std::memory_order_acquire) < slots_.size(); });
+          tail = tail_.load(std::memory_order_acquire);
+          break;
+      }
+    }
+
+    memcpy(&slots_[head % slots_.size()], &item, sizeof(T));
+    head_.store(head + 1, std::memory_order_release);
+    notify(data_);
+    return true;
+  }
+
+  // consumer; false when nothing is queued
+  bool try_pop(T &item) {
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    while (tail != head_.load(std::memory_order_acquire)) {
+      memcpy(&item, &slots_[tail % slots_.size()], sizeof(T));
+      if (tail_.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel)) {
+        notify(space_);
+        return true;
+      }
+      // the producer dropped this item while we were copying it
+    }
+    return false;
+  }
+
+  // consumer; waits for an item, false once closed and drained
+  bool pop(T &item) {
+    while (!try_pop(item)) {
+      if (closed_.load(std::memory_order_acquire) && size() == 0)
+        return false;
+      wait_for(data_, [&] { return size() > 0 || closed_.load(std::memory_order_acquire); });
+    }
+    return true;
+  }
+
+  // wake both sides; push() fails and pop() drains then fails
+  void close() {
+    closed_.store(true, std::memory_order_release);
+    notify(data_);
+    notify(space_);
+  }
+
+ private:
+  // sleeping is the slow path: spin first, and only touch the mutex when
+  // the other side has announced it is (or is about to be) asleep
+  struct Waiter {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::atomic<int> sleepers{0};
+  };
+
+  template <typename Ready>
+  void wait_for(Waiter &w, Ready ready) {
+    for (int spin = 0; spin < 64; spin++) {
+      if (ready())
+        return;
+    }
+    std::unique_lock<std::mutex> guard(w.lock);
+    w.sleepers.fetch_add(1, std::memory_order_seq_cst);
+    // the timeout bounds the cost of a wakeup lost to the unlocked notify check
+    w.cv.wait_for(guard, std::chrono::milliseconds(10), ready);
+    w.sleepers.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void notify(Waiter &w) {
+    if (w.sleepers.load(std::memory_order_seq_cst) > 0) {
+      std::lock_guard<std::mutex> guard(w.lock);
+      w.cv.notify_all();
+    }
+  }
+
+  std::vector<T> slots_;
+  OverrunPolicy policy_;
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  alignas(64) std::atomic<uint64_t> overruns_{0};
+  std::atomic<bool> closed_{false};
+  Waiter data_;
+  Waiter space_;
+};
+
+}  // namespace iq
@@ -0,0 +1,307 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+#include "json.h"
+#include "netstream.h"
+#include "telemetry.h"
+
+namespace iq {
+
+namespace {
+
+constexpr size_t MAX_CLIENTS = 16;
+constexpr size_t MAX_REQUEST = 4096;
+// a scraper that has not sent its request or taken the reply by then is dropped
+constexpr auto CLIENT_TIMEOUT = std::chrono::seconds(5);
+
+std::string number(double v) {
+  if (std::isnan(v))
+    return "NaN";
+  if (std::isinf(v))
+    return v > 0 ? "+Inf" : "-Inf";
+  char buf[32];
+  // counters print as integers
+  snprintf(buf, sizeof(buf), v == std::floor(v) && std::fabs(v) < 1e15 ? "%.0f" : "%.9g", v);
+  return buf;
+}
+
+std::string label_value(const std::string &s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '\\' || c == '"')
+      out += '\\';
+    if (c == '\n')
+      out += "\\n";
+    else
+      out += c;
+  }
+  return out;
+}
+
+std::string labels_text(const Metrics::Labels &labels, const std::string &le = "") {
+  std::string out;
+  for (auto &l : labels)
+    out += (out.empty() ? "" : ",") + l.first + "=\"" + label_value(l.second) + "\"";
+  if (!le.empty())
+    out += (out.empty() ? "" : ",") + std::string("le=\"") + le + "\"";
+  return out.empty() ? out : "{" + out + "}";
+}
+
+// json has no infinities; an empty or overflowing histogram reports null
+std::string json_number(double v) { return std::isfinite(v) ? number(v) : "null"; }
+
+}  // namespace
+
+Histogram::Histogram(int lo, int hi) : lo_(lo), hi_(hi), buckets_(hi - lo + 2) {}
+
+void Histogram::record(uint64_t value) {
+  int k = 0;
+  if (value > 1)
+    k = 64 - __builtin_clzll(value - 1);  // smallest k with value <= 2^k
+  k = std::min(std::max(k, lo_), hi_ + 1) - lo_;
+  buckets_[k].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+double Histogram::quantile(double q) const {
+  uint64_t total = 0;
+  for (auto &b : buckets_)
+    total += b.load(std::memory_order_relaxed);
+  if (total == 0)
+    return 0;
+  uint64_t want = std::max<uint64_t>(1, uint64_t(std::ceil(q * total))), seen = 0;
+  for (int k = 0; k <= hi_ - lo_; k++) {
+    seen += bucket(k);
+    if (seen >= want)
+      return std::ldexp(1.0, lo_ + k);
+  }
+  return INFINITY;
+}
+
+Metrics::Family &Metrics::family(const std::string &name, const std::string &help, const char *type) {
+  for (auto &f : families_)
+    if (f.name == name)
+      return f;
+  families_.push_back({name, help, type, {}});
+  return families_.back();
+}
+
+void Metrics::counter(const std::string &name, const std::string &help, const Labels &labels, double value) {
+  Sample s;
+  s.labels = labels;
+  s.value = value;
+  family(name, help, "counter").samples.push_back(std::move(s));
+}
+
+void Metrics::gauge(const std::string &name, const std::string &help, const Labels &labels, double value) {
+  Sample s;
+  s.labels = labels;
+  s.value = value;
+  family(name, help, "gauge").samples.push_back(std::move(s));
+}
+
+void Metrics::histogram(const std::string &name, const std::string &help, const Labels &labels,
+                        const Histogram &h, double scale) {
+  Sample s;
+  s.labels = labels;
+  uint64_t cumulative = 0;
+  for (int k = 0; k <= h.hi() - h.lo(); k++) {
+    cumulative += h.bucket(k);
+    s.buckets.emplace_back(std::ldexp(scale, h.lo() + k), cumulative);
+  }
+  cumulative += h.bucket(h.hi() - h.lo() + 1);
+  s.buckets.emplace_back(INFINITY, cumulative);
+  // the buckets are read one at a time while the streams record, so the
+  // count is taken from them rather than from count(), which may be ahead
+  s.count = cumulative;
+  s.sum = h.sum() * scale;
+  s.p50 = h.quantile(0.5) * scale;
+  s.p90 = h.quantile(0.9) * scale;
+  s.p99 = h.quantile(0.99) * scale;
+  s.max = h.quantile(1) * scale;
+  family(name, help, "histogram").samples.push_back(std::move(s));
+}
+
+std::string Metrics::prometheus() const {
+  std::string out;
+  for (auto &f : families_) {
+    out += "# HELP " + f.name + " " + f.help + "\n# TYPE " + f.name + " " + f.type + "\n";
+    for (auto &s : f.samples) {
+      if (s.buckets.empty()) {
+        out += f.name + labels_text(s.labels) + " " + number(s.value) + "\n";
+        continue;
+      }
+      for (auto &b : s.buckets)
+        out += f.name + "_bucket" + labels_text(s.labels, number(b.first)) + " " + number(b.second) + "\n";
+      out += f.name + "_sum" + labels_text(s.labels) + " " + number(s.sum) + "\n";
+      out += f.name + "_count" + labels_text(s.labels) + " " + number(s.count) + "\n";
+    }
+  }
+  return out;
+}
+
+std::string Metrics::json() const {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  std::ostringstream out;
+  char time[32];
+  snprintf(time, sizeof(time), "%lld.%03ld", (long long)ts.tv_sec, ts.tv_nsec / 1000000);
+  out << "{\"time\": " << time;
+  for (auto &f : families_) {
+    out << ", " << json_quote(f.name) << ": [";
+    for (size_t k = 0; k < f.samples.size(); k++) {
+      const Sample &s = f.samples[k];
+      out << (k ? ", {" : "{");
+      for (auto &l : s.labels)
+        out << json_quote(l.first) << ": " << json_quote(l.second) << ", ";
+      if (s.buckets.empty())
+        out << "\"value\": " << json_number(s.value) << "}";
+      else
+        out << "\"count\": " << s.count << ", \"sum\": " << json_number(s.sum) << ", \"p50\": " << json_number(s.p50)
+            << ", \"p90\": " << json_number(s.p90) << ", \"p99\": " << json_number(s.p99)
+            << ", \"max\": " << json_number(s.max) << "}";
+    }
+    out << "]";
+  }
+  out << "}";
+  return out.str();
+}
+
+MetricsServer::~MetricsServer() {
+  for (auto &c : clients_)
+    close(c.fd);
+  if (listen_fd_ >= 0)
+    close(listen_fd_);
+  if (epfd_ >= 0)
+    close(epfd_);
+}
+
+bool MetricsServer::listen(const std::string &hostport, std::string *error) {
+  listen_fd_ = bind_socket(hostport, SOCK_STREAM, error);
+  if (listen_fd_ < 0)
+    return false;
+  epfd_ = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = listen_fd_;
+  epoll_ctl(epfd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+  return true;
+}
+
+void MetricsServer::accept_clients() {
+  int fd;
+  while ((fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    if (clients_.size() >= MAX_CLIENTS) {
+      close(fd);
+      continue;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+    clients_.push_back({fd, {}, {}, 0, std::chrono::steady_clock::now()});
+  }
+}
+
+// false once the client is done with
+bool MetricsServer::read_request(Client &c, const std::function<Metrics()> &collect) {
+  char buf[1024];
+  ssize_t n;
+  while ((n = recv(c.fd, buf, sizeof(buf), 0)) > 0) {
+    c.request.append(buf, n);
+    if (c.request.size() > MAX_REQUEST)
+      return false;
+  }
+  if (n < 0 && errno != EAGAIN && errno != EINTR)
+    return false;
+  // a client may shut down its side once the request is sent
+  if (c.request.find("\r\n\r\n") == std::string::npos && c.request.find("\n\n") == std::string::npos)
+    return n != 0;
+
+  std::istringstream line(c.request.substr(0, c.request.find('\n')));
+  std::string method, path;
+  line >> method >> path;
+  std::string status = "200 OK", type, body;
+  if (method != "GET" && method != "HEAD") {
+    status = "405 Method Not Allowed";
+    type = "text/plain";
+    body = "GET only\n";
+  } else if (path == "/metrics" || path.rfind("/metrics?", 0) == 0) {
+    type = "text/plain; version=0.0.4; charset=utf-8";
+    body = collect().prometheus();
+  } else if (path == "/metrics.json") {
+    type = "application/json";
+    body = collect().json() + "\n";
+  } else {
+    status = "404 Not Found";
+    type = "text/plain";
+    body = "/metrics or /metrics.json\n";
+  }
+  c.response = "HTTP/1.0 " + status + "\r\nContent-Type: " + type + "\r\nContent-Length: " +
+               std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+  if (method != "HEAD")
+    c.response += body;
+
+  struct epoll_event ev = {};
+  ev.events = EPOLLOUT;
+  ev.data.fd = c.fd;
+  epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+  return send_response(c);
+}
+
+// false once the response is out, or the client gone
+bool MetricsServer::send_response(Client &c) {
+  while (c.sent < c.response.size()) {
+    ssize_t n = send(c.fd, c.response.data() + c.sent, c.response.size() - c.sent, MSG_NOSIGNAL);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+      return true;
+    if (n <= 0)
+      return false;
+    c.sent += n;
+  }
+  return false;
+}
+
+void MetricsServer::service(const std::function<Metrics()> &collect) {
+  struct epoll_event events[MAX_CLIENTS + 1];
+  int n = epoll_wait(epfd_, events, MAX_CLIENTS + 1, 0);
+  for (int k = 0; k < n; k++) {
+    if (events[k].data.fd == listen_fd_) {
+      accept_clients();
+      continue;
+    }
+    for (auto &c : clients_) {
+      if (c.fd != events[k].data.fd)
+        continue;
+      bool open = c.response.empty() ? read_request(c, collect) : send_response(c);
+      if (!open) {
+        close(c.fd);
+        c.fd = -1;
+      }
+      break;
+    }
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  clients_.erase(std::remove_if(clients_.begin(), clients_.end(),
+                                [&](Client &c) {
+                                  if (c.fd >= 0 && now - c.opened > CLIENT_TIMEOUT) {
+                                    close(c.fd);
+                                    c.fd = -1;
+                                  }
+                                  return c.fd < 0;
+                                }),
+                 clients_.end());
+}
+
+}  // namespace iq
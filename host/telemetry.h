@@ -0,0 +1,124 @@
+// live counters for iqd's dashboards and alerts (iqd -m, -l)
+//
+// Histogram is a set of log2 buckets that the streaming threads record into
+// without locks and anyone may read. Metrics is one snapshot of counters,
+// gauges and histograms, rendered in prometheus' text format or as one line
+// of json. MetricsServer answers http scrapes from iqd's epoll loop:
+//
+//   GET /metrics        prometheus text format (0.0.4)
+//   GET /metrics.json   the same snapshot as json
+//
+// histograms of nanoseconds are exported in seconds, as prometheus expects.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace iq {
+
+class Histogram {
+ public:
+  // buckets for values up to 2^lo, 2^(lo+1) ... 2^hi, and one above
+  Histogram(int lo, int hi);
+
+  void record(uint64_t value);
+
+  int lo() const { return lo_; }
+  int hi() const { return hi_; }
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+  // values in bucket k, for k in 0..hi-lo+1; the last is the overflow
+  uint64_t bucket(int k) const { return buckets_[k].load(std::memory_order_relaxed); }
+
+  // upper bound of the bucket holding quantile q (0..1); 0 when empty
+  double quantile(double q) const;
+
+ private:
+  int lo_, hi_;
+  std::vector<std::atomic<uint64_t>> buckets_;
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+};
+
+// the time since a steady_clock point, for Histogram::record
+inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+class Metrics {
+ public:
+  using Labels = std::vector<std::pair<std::string, std::string>>;
+
+  // a family's samples must all be added with the same help text; families
+  // are rendered in the order they first appear
+  void counter(const std::string &name, const std::string &help, const Labels &labels, double value);
+  void gauge(const std::string &name, const std::string &help, const Labels &labels, double value);
+  // scale converts the recorded unit to the exported one (1e-9 for ns -> s)
+  void histogram(const std::string &name, const std::string &help, const Labels &labels, const Histogram &h,
+                 double scale = 1);
+
+  std::string prometheus() const;
+  // {"time": UNIX_SECONDS, "NAME": [{LABELS..., "value": V}, ...], ...};
+  // histograms give count, sum and the p50, p90, p99 and max bucket bounds
+  std::string json() const;
+
+ private:
+  struct Sample {
+    Labels labels;
+    double value = 0;
+    std::vector<std::pair<double, uint64_t>> buckets;  // histograms: (le, cumulative count)
+    uint64_t count = 0;
+    double sum = 0;
+    double p50 = 0, p90 = 0, p99 = 0, max = 0;
+  };
+  struct Family {
+    std::string name, help, type;
+    std::vector<Sample> samples;
+  };
+
+  Family &family(const std::string &name, const std::string &help, const char *type);
+
+  std::vector<Family> families_;
+};
+
+class MetricsServer {
+ public:
+  ~MetricsServer();
+
+  // listen on tcp [HOST:]PORT
+  bool listen(const std::string &hostport, std::string *error);
+
+  // an epoll descriptor over the listener and its clients, for the caller's
+  // own loop: readable when service() has something to do
+  int fd() const { return epfd_; }
+
+  // accept, read requests and answer them, never blocking; collect is
+  // called for each scrape. also closes clients idle for too long, so call
+  // it once a second or so even without events.
+  void service(const std::function<Metrics()> &collect);
+
+ private:
+  struct Client {
+    int fd;
+    std::string request;
+    std::string response;
+    size_t sent = 0;
+    std::chrono::steady_clock::time_point opened;
+  };
+
+  void accept_clients();
+  bool read_request(Client &c, const std::function<Metrics()> &collect);
+  bool send_response(Client &c);
+
+  int listen_fd_ = -1;
+  int epfd_ = -1;
+  std::vector<Client> clients_;
+};
+
+}  // namespace iq
@@ -0,0 +1,36 @@
+// byte-stream transport to a radar module
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace iq {
+
+class Transport {
+ public:
+  virtual ~Transport() = default;
+
+  // descriptor that polls readable when read() has data
+  virtual int fd() const = 0;
+
+  // non-blocking; -1 with errno EAGAIN when nothing is ready
+  virtual ssize_t read(void *buf, size_t len) = 0;
+  virtual ssize_t write(const void *buf, size_t len) = 0;
+
+  // bytes the module sent that were lost before read() (a full host-side
+  // buffer), for telemetry; transports that cannot lose any report 0
+  virtual uint64_t dropped_bytes() const { return 0; }
+};
+
+// cdc-acm tty in raw, non-blocking mode
+std::unique_ptr<Transport> open_tty(const std::string &path, std::string *error);
+
+// "unix:PATH": a stream socket with a module (or iqsim) on the other end
+std::unique_ptr<Transport> open_unix(const std::string &path, std::string *error);
+
+}  // namespace iq
@@ -0,0 +1,76 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "transport.h"
+
+namespace iq {
+
+namespace {
+
+// a tty, or a socket standing in for one
+class TtyTransport : public Transport {
+ public:
+  TtyTransport(int fd, bool socket) : fd_(fd), socket_(socket) {}
+  ~TtyTransport() override { close(fd_); }
+
+  int fd() const override { return fd_; }
+  ssize_t read(void *buf, size_t len) override { return ::read(fd_, buf, len); }
+  ssize_t write(const void *buf, size_t len) override {
+    return socket_ ? ::send(fd_, buf, len, MSG_NOSIGNAL) : ::write(fd_, buf, len);
+  }
+
+ private:
+  int fd_;
+  bool socket_;
+};
+
+}  // namespace
+
+std::unique_ptr<Transport> open_tty(const std::string &path, std::string *error) {
+  int fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    *error = path + ": " + strerror(errno);
+    return nullptr;
+  }
+
+  // raw mode, so the tty layer never translates or line-buffers samples.
+  // VMIN = 1 makes an empty non-blocking read fail with EAGAIN instead of
+  // returning 0, which is reserved for hangup.
+  struct termios tio;
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  tcflush(fd, TCIOFLUSH);
+
+  return std::make_unique<TtyTransport>(fd, false);
+}
+
+std::unique_ptr<Transport> open_unix(const std::string &path, std::string *error) {
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    *error = "unix:" + path + ": path too long";
+    return nullptr;
+  }
+  memcpy(addr.sun_path, path.c_str(), path.size());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+    *error = "unix:" + path + ": " + strerror(errno);
+    if (fd >= 0)
+      close(fd);
+    return nullptr;
+  }
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  return std::make_unique<TtyTransport>(fd, true);
+}
+
+}  // namespace iq
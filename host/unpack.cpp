@@ -0,0 +1,268 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UNPACK_X86
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define UNPACK_NEON
+#endif
+
+#include "unpack.h"
+
+namespace iq {
+
+namespace {
+
+inline void unpack_one(const uint8_t *in, int &i, int &q) {
+  i = (in[0] << 4) | (in[1] >> 4);
+  q = ((in[1] & 0xf) << 8) | in[2];
+}
+
+bool always() { return true; }
+
+void scalar_s16(const uint8_t *in, int16_t *out, size_t samples, int16_t dc_i, int16_t dc_q, int shift) {
+  int i, q;
+  for (size_t x = 0; x < samples; x++, in += 3, out += 2) {
+    unpack_one(in, i, q);
+    out[0] = (int16_t)((i - dc_i) * (1 << shift));
+    out[1] = (int16_t)((q - dc_q) * (1 << shift));
+  }
+}
+
+void scalar_f32(const uint8_t *in, float *out, size_t samples, float dc_i, float dc_q, float scale) {
+  int i, q;
+  for (size_t x = 0; x < samples; x++, in += 3, out += 2) {
+    unpack_one(in, i, q);
+    out[0] = ((float)i - dc_i) * scale;
+    out[1] = ((float)q - dc_q) * scale;
+  }
+}
+
+#ifdef UNPACK_X86
+
+// 4 pairs (12 bytes) -> 8 lanes. each lane gathers the two bytes holding its
+// 12 bits big-end first: i = (d0 << 8 | d1) >> 4, q = (d1 << 8 | d2) & 0xfff
+#define SC12_SHUFFLE 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+
+bool have_sse41() { return __builtin_cpu_supports("sse4.1"); }
+bool have_avx2() { return __builtin_cpu_supports("avx2"); }
+
+__attribute__((target("sse4.1"))) inline __m128i sse41_unpack4(const uint8_t *in) {
+  const __m128i shuffle = _mm_setr_epi8(SC12_SHUFFLE);
+  __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in), shuffle);
+  return _mm_blend_epi16(_mm_srli_epi16(v, 4), _mm_and_si128(v, _mm_set1_epi16(0x0fff)), 0xaa);
+}
+
+__attribute__((target("sse4.1")))
+void sse41_s16(const uint8_t *in, int16_t *out, size_t samples, int16_t dc_i, int16_t dc_q, int shift) {
+  const __m128i dc = _mm_setr_epi16(dc_i, dc_q, dc_i, dc_q, dc_i, dc_q, dc_i, dc_q);
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  size_t x = 0;
+  // each 16-byte load covers 4 pairs plus 4 bytes of the next
+  for (; x + 6 <= samples; x += 4, in += 12, out += 8) {
+    __m128i v = _mm_sll_epi16(_mm_sub_epi16(sse41_unpack4(in), dc), count);
+    _mm_storeu_si128((__m128i *)out, v);
+  }
+  scalar_s16(in, out, samples - x, dc_i, dc_q, shift);
+}
+
+__attribute__((target("sse4.1")))
+void sse41_f32(const uint8_t *in, float *out, size_t samples, float dc_i, float dc_q, float scale) {
+  const __m128 dc = _mm_setr_ps(dc_i, dc_q, dc_i, dc_q);
+  const __m128 k = _mm_set1_ps(scale);
+  size_t x = 0;
+  for (; x + 6 <= samples; x += 4, in += 12, out += 8) {
+    __m128i v = sse41_unpack4(in);
+    __m128 lo = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(v));
+    __m128 hi = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_unpackhi_epi64(v, v)));
+    _mm_storeu_ps(out, _mm_mul_ps(_mm_sub_ps(lo, dc), k));
+    _mm_storeu_ps(out + 4, _mm_mul_ps(_mm_sub_ps(hi, dc), k));
+  }
+  scalar_f32(in, out, samples - x, dc_i, dc_q, scale);
+}
+
+// 8 pairs (24 bytes) -> 16 lanes, one 4-pair group per 128-bit half
+__attribute__((target("avx2"))) inline __m256i avx2_unpack8(const uint8_t *in) {
+  const __m256i shuffle = _mm256_setr_epi8(SC12_SHUFFLE, SC12_SHUFFLE);
+  __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)in)),
+                                      _mm_loadu_si128((const __m128i *)(in + 12)), 1);
+  v = _mm256_shuffle_epi8(v, shuffle);
+  return _mm256_blend_epi16(_mm256_srli_epi16(v, 4), _mm256_and_si256(v, _mm256_set1_epi16(0x0fff)), 0xaa);
+}
+
+__attribute__((target("avx2")))
+void avx2_s16(const uint8_t *in, int16_t *out, size_t samples, int16_t dc_i, int16_t dc_q, int shift) {
+  const __m256i dc = _mm256_setr_epi16(dc_i, dc_q, dc_i, dc_q, dc_i, dc_q, dc_i, dc_q,
+                                       dc_i, dc_q, dc_i, dc_q, dc_i, dc_q, dc_i, dc_q);
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  size_t x = 0;
+  for (; x + 10 <= samples; x += 8, in += 24, out += 16) {
+    __m256i v = _mm256_sll_epi16(_mm256_sub_epi16(avx2_unpack8(in), dc), count);
+    _mm256_storeu_si256((__m256i *)out, v);
+  }
+  scalar_s16(in, out, samples - x, dc_i, dc_q, shift);
+}
+
+__attribute__((target("avx2")))
+void avx2_f32(const uint8_t *in, float *out, size_t samples, float dc_i, float dc_q, float scale) {
+  const __m256 dc = _mm256_setr_ps(dc_i, dc_q, dc_i, dc_q, dc_i, dc_q, dc_i, dc_q);
+  const __m256 k = _mm256_set1_ps(scale);
+  size_t x = 0;
+  for (; x + 10 <= samples; x += 8, in += 24, out += 16) {
+    __m256i v = avx2_unpack8(in);
+    __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+    __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+    _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_sub_ps(lo, dc), k));
+    _mm256_storeu_ps(out + 8, _mm256_mul_ps(_mm256_sub_ps(hi, dc), k));
+  }
+  scalar_f32(in, out, samples - x, dc_i, dc_q, scale);
+}
+
+#endif  // UNPACK_X86
+
+#ifdef UNPACK_NEON
+
+// vld3 de-interleaves 16 pairs into d0/d1/d2 planes
+inline void neon_unpack16(const uint8_t *in, int16x8x2_t &lo, int16x8x2_t &hi) {
+  uint8x16x3_t d = vld3q_u8(in);
+  uint8x16_t low_nibble = vandq_u8(d.val[1], vdupq_n_u8(0x0f));
+  uint8x16_t high_nibble = vshrq_n_u8(d.val[1], 4);
+
+  lo.val[0] = vreinterpretq_s16_u16(vorrq_u16(vshll_n_u8(vget_low_u8(d.val[0]), 4), vmovl_u8(vget_low_u8(high_nibble))));
+  hi.val[0] = vreinterpretq_s16_u16(vorrq_u16(vshll_n_u8(vget_high_u8(d.val[0]), 4), vmovl_u8(vget_high_u8(high_nibble))));
+  lo.val[1] = vreinterpretq_s16_u16(vorrq_u16(vshll_n_u8(vget_low_u8(low_nibble), 8), vmovl_u8(vget_low_u8(d.val[2]))));
+  hi.val[1] = vreinterpretq_s16_u16(vorrq_u16(vshll_n_u8(vget_high_u8(low_nibble), 8), vmovl_u8(vget_high_u8(d.val[2]))));
+}
+
+void neon_s16(const uint8_t *in, int16_t *out, size_t samples, int16_t dc_i, int16_t dc_q, int shift) {
+  const int16x8_t di = vdupq_n_s16(dc_i), dq = vdupq_n_s16(dc_q), count = vdupq_n_s16(shift);
+  size_t x = 0;
+  for (; x + 16 <= samples; x += 16, in += 48, out += 32) {
+    int16x8x2_t lo, hi;
+    neon_unpack16(in, lo, hi);
+    lo.val[0] = vshlq_s16(vsubq_s16(lo.val[0], di), count);
+    lo.val[1] = vshlq_s16(vsubq_s16(lo.val[1], dq), count);
+    hi.val[0] = vshlq_s16(vsubq_s16(hi.val[0], di), count);
+    hi.val[1] = vshlq_s16(vsubq_s16(hi.val[1], dq), count);
+    vst2q_s16(out, lo);
+    vst2q_s16(out + 16, hi);
+  }
+  scalar_s16(in, out, samples - x, dc_i, dc_q, shift);
+}
+
+inline void neon_store_f32(float *out, int16x8x2_t v, float32x4_t di, float32x4_t dq, float32x4_t k) {
+  float32x4x2_t a, b;
+  a.val[0] = vmulq_f32(vsubq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[0]))), di), k);
+  a.val[1] = vmulq_f32(vsubq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[1]))), dq), k);
+  b.val[0] = vmulq_f32(vsubq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[0]))), di), k);
+  b.val[1] = vmulq_f32(vsubq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[1]))), dq), k);
+  vst2q_f32(out, a);
+  vst2q_f32(out + 8, b);
+}
+
+void neon_f32(const uint8_t *in, float *out, size_t samples, float dc_i, float dc_q, float scale) {
+  const float32x4_t di = vdupq_n_f32(dc_i), dq = vdupq_n_f32(dc_q), k = vdupq_n_f32(scale);
+  size_t x = 0;
+  for (; x + 16 <= samples; x += 16, in += 48, out += 32) {
+    int16x8x2_t lo, hi;
+    neon_unpack16(in, lo, hi);
+    neon_store_f32(out, lo, di, dq, k);
+    neon_store_f32(out + 16, hi, di, dq, k);
+  }
+  scalar_f32(in, out, samples - x, dc_i, dc_q, scale);
+}
+
+#endif  // UNPACK_NEON
+
+// slowest first; the last supported entry wins
+const UnpackKernel kernels[] = {
+  {"scalar", always, scalar_s16, scalar_f32},
+#ifdef UNPACK_X86
+  {"sse4.1", have_sse41, sse41_s16, sse41_f32},
+  {"avx2", have_avx2, avx2_s16, avx2_f32},
+#endif
+#ifdef UNPACK_NEON
+  {"neon", always, neon_s16, neon_f32},
+#endif
+};
+
+constexpr size_t kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+const UnpackKernel *select_kernel() {
+  const char *name = getenv("IQ_UNPACK");
+  const UnpackKernel *best = &kernels[0];
+  for (auto &k : kernels) {
+    if (!k.supported())
+      continue;
+    if (name && strcmp(name, k.name) == 0)
+      return &k;
+    best = &k;
+  }
+  return best;
+}
+
+// selected on first use from whichever worker thread gets there first
+std::atomic<const UnpackKernel *> active{nullptr};
+
+}  // namespace
+
+const UnpackKernel *unpack_kernels(size_t *count) {
+  *count = kernel_count;
+  return kernels;
+}
+
+const UnpackKernel &unpack_kernel() {
+  const UnpackKernel *k = active.load(std::memory_order_acquire);
+  if (!k) {
+    // racing selections pick the same kernel; keep whichever landed first
+    const UnpackKernel *expected = nullptr;
+    k = select_kernel();
+    if (!active.compare_exchange_strong(expected, k, std::memory_order_acq_rel))
+      k = expected;
+  }
+  return *k;
+}
+
+bool unpack_use(const std::string &name) {
+  for (auto &k : kernels) {
+    if (name == k.name && k.supported()) {
+      active.store(&k, std::memory_order_release);
+      return true;
+    }
+  }
+  return false;
+}
+
+void unpack_sc12(const uint8_t *in, int16_t *out, size_t samples) {
+  unpack_kernel().s16(in, out, samples, 0, 0, 0);
+}
+
+void unpack_sc12(const uint8_t *in, int16_t *out, size_t samples, int16_t dc_i, int16_t dc_q, int shift) {
+  unpack_kernel().s16(in, out, samples, dc_i, dc_q, shift);
+}
+
+void unpack_sc12(const uint8_t *in, float *out, size_t samples, float dc_i, float dc_q, float scale) {
+  unpack_kernel().f32(in, out, samples, dc_i, dc_q, scale);
+}
+
+void unpack_sc12(const uint8_t *in, std::complex<float> *out, size_t samples, float dc_i, float dc_q, float scale) {
+  // std::complex<float> is layout-compatible with float[2]
+  unpack_kernel().f32(in, reinterpret_cast<float *>(out), samples, dc_i, dc_q, scale);
+}
+
+void estimate_dc(const uint8_t *in, size_t samples, float *dc_i, float *dc_q) {
+  uint64_t sum_i = 0, sum_q = 0;
+  int i, q;
+  for (size_t x = 0; x < samples; x++, in += 3) {
+    unpack_one(in, i, q);
+    sum_i += i;
+    sum_q += q;
+  }
+  *dc_i = samples ? (float)((double)sum_i / samples) : 0;
+  *dc_q = samples ? (float)((double)sum_q / samples) : 0;
+}
+
+}  // namespace iq
@@ -0,0 +1,46 @@
+// sc12 -> sc16 / float unpacking
+//
+// the firmware packs each 12-bit i/q pair into 3 bytes:
+//   d0 = I >> 4, d1 = (I & 0xf) << 4 | Q >> 8, d2 = Q & 0xff
+//
+// scalar, sse4.1, avx2 and neon kernels are built in; the fastest one the
+// cpu supports is picked on first use (override with IQ_UNPACK=<name>).
+
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace iq {
+
+struct UnpackKernel {
+  const char *name;
+  bool (*supported)();
+  // out = (x - dc) << shift
+  void (*s16)(const uint8_t *in, int16_t *out, size_t samples, int16_t dc_i, int16_t dc_q, int shift);
+  // out = (x - dc) * scale
+  void (*f32)(const uint8_t *in, float *out, size_t samples, float dc_i, float dc_q, float scale);
+};
+
+// every kernel compiled in, supported or not
+const UnpackKernel *unpack_kernels(size_t *count);
+
+// kernel used by the unpack_sc12() overloads
+const UnpackKernel &unpack_kernel();
+
+// force a kernel by name; false if unknown or unsupported on this cpu
+bool unpack_use(const std::string &name);
+
+// unpack `samples` i/q pairs into 2 * samples interleaved values
+void unpack_sc12(const uint8_t *in, int16_t *out, size_t samples);
+void unpack_sc12(const uint8_t *in, int16_t *out, size_t samples, int16_t dc_i, int16_t dc_q, int shift);
+void unpack_sc12(const uint8_t *in, float *out, size_t samples, float dc_i = 0, float dc_q = 0, float scale = 1);
+void unpack_sc12(const uint8_t *in, std::complex<float> *out, size_t samples,
+                 float dc_i = 0, float dc_q = 0, float scale = 1);
+
+// mean i and q of a packed buffer, for dc removal
+void estimate_dc(const uint8_t *in, size_t samples, float *dc_i, float *dc_q);
+
+}  // namespace iq
@@ -0,0 +1,273 @@
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef HAVE_LIBUSB
+#include <libusb.h>
+#endif
+
+#include "async_transport.h"
+#include "modules.h"
+#include "protocol.h"
+#include "usb.h"
+
+namespace iq {
+
+namespace {
+
+#ifdef HAVE_LIBUSB
+
+constexpr uint8_t EPT_BULK_IN = 0x81;
+constexpr uint8_t EPT_BULK_OUT = 0x01;
+constexpr int INTERFACES = 2;  // cdc comm + data
+
+// one context and event thread shared by every open module
+class UsbContext {
+ public:
+  static libusb_context *acquire() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (users_++ == 0) {
+      if (libusb_init(&ctx_) != 0) {
+        users_--;
+        return nullptr;
+      }
+      running_ = true;
+      thread_ = std::thread([] {
+        while (running_) {
+          struct timeval tv = {0, 100000};
+          libusb_handle_events_timeout_completed(ctx_, &tv, nullptr);
+        }
+      });
+    }
+    return ctx_;
+  }
+
+  static void release() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (--users_ == 0) {
+      running_ = false;
+      thread_.join();
+      libusb_exit(ctx_);
+      ctx_ = nullptr;
+    }
+  }
+
+ private:
+  static std::mutex lock_;
+  static std::thread thread_;
+  static libusb_context *ctx_;
+  static int users_;
+  static volatile bool running_;
+};
+
+std::mutex UsbContext::lock_;
+std::thread UsbContext::thread_;
+libusb_context *UsbContext::ctx_ = nullptr;
+int UsbContext::users_ = 0;
+volatile bool UsbContext::running_ = false;
+
+class UsbTransport : public AsyncTransport {
+ public:
+  UsbTransport(libusb_device_handle *handle, const UsbOptions &options)
+      : AsyncTransport(options.ring_size), handle_(handle) {
+    for (int k = 0; k < options.transfers; k++) {
+      Transfer t;
+      t.buffer.resize(options.transfer_size);
+      t.xfer = libusb_alloc_transfer(0);
+      libusb_fill_bulk_transfer(t.xfer, handle_, EPT_BULK_IN, t.buffer.data(), t.buffer.size(),
+                                on_complete, this, 0);
+      transfers_.push_back(std::move(t));
+    }
+  }
+
+  ~UsbTransport() override {
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      stopping_ = true;
+      for (auto &t : transfers_)
+        libusb_cancel_transfer(t.xfer);
+      idle_.wait(guard, [this] { return in_flight_ == 0; });
+    }
+    for (auto &t : transfers_)
+      libusb_free_transfer(t.xfer);
+    for (int k = 0; k < INTERFACES; k++) {
+      libusb_release_interface(handle_, k);
+      libusb_attach_kernel_driver(handle_, k);
+    }
+    libusb_close(handle_);
+    UsbContext::release();
+  }
+
+  bool start() {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (auto &t : transfers_) {
+      if (libusb_submit_transfer(t.xfer) != 0)
+        return false;
+      in_flight_++;
+    }
+    return true;
+  }
+
+  // commands are a few bytes, so a synchronous transfer is fine
+  ssize_t transmit(const void *buf, size_t len) override {
+    int sent = 0;
+    int rc = libusb_bulk_transfer(handle_, EPT_BULK_OUT, (unsigned char *)buf, len, &sent, 1000);
+    if (rc != 0 && sent == 0) {
+      errno = rc == LIBUSB_ERROR_TIMEOUT ? EAGAIN : EIO;
+      return -1;
+    }
+    return sent;
+  }
+
+ private:
+  struct Transfer {
+    libusb_transfer *xfer;
+    std::vector<uint8_t> buffer;
+  };
+
+  static void LIBUSB_CALL on_complete(libusb_transfer *xfer) {
+    UsbTransport *self = static_cast<UsbTransport *>(xfer->user_data);
+
+    if (xfer->status == LIBUSB_TRANSFER_COMPLETED || xfer->status == LIBUSB_TRANSFER_TIMED_OUT)
+      self->push(xfer->buffer, xfer->actual_length);
+    else if (xfer->status != LIBUSB_TRANSFER_CANCELLED)
+      self->hangup();
+
+    std::lock_guard<std::mutex> guard(self->lock_);
+    bool resubmit = !self->stopping_ && (xfer->status == LIBUSB_TRANSFER_COMPLETED ||
+                                         xfer->status == LIBUSB_TRANSFER_TIMED_OUT);
+    if (!resubmit || libusb_submit_transfer(xfer) != 0) {
+      if (--self->in_flight_ == 0)
+        self->idle_.notify_all();
+    }
+  }
+
+  libusb_device_handle *handle_;
+  std::vector<Transfer> transfers_;
+  std::mutex lock_;
+  std::condition_variable idle_;
+  int in_flight_ = 0;
+  bool stopping_ = false;
+};
+
+std::string port_path(libusb_device *dev) {
+  uint8_t ports[8];
+  int n = libusb_get_port_numbers(dev, ports, sizeof(ports));
+  std::string path = std::to_string(libusb_get_bus_number(dev));
+  for (int k = 0; k < n; k++)
+    path += (k == 0 ? "-" : ".") + std::to_string(ports[k]);
+  return path;
+}
+
+bool matches(libusb_device *dev, libusb_device_handle *handle, const std::string &want) {
+  if (want.empty() || want == port_path(dev))
+    return true;
+  struct libusb_device_descriptor desc;
+  unsigned char serial[64] = {0};
+  return libusb_get_device_descriptor(dev, &desc) == 0 && desc.iSerialNumber &&
+         libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, serial, sizeof(serial)) > 0 &&
+         want == reinterpret_cast<char *>(serial);
+}
+
+#endif  // HAVE_LIBUSB
+
+}  // namespace
+
+std::unique_ptr<Transport> open_usb(const std::string &selector, const UsbOptions &options, std::string *error) {
+  std::string want = selector.compare(0, 4, "usb:") == 0 ? selector.substr(4) : "";
+
+#ifdef HAVE_LIBUSB
+  libusb_context *ctx = UsbContext::acquire();
+  if (!ctx) {
+    *error = selector + ": libusb_init failed";
+    return nullptr;
+  }
+
+  libusb_device **list;
+  ssize_t count = libusb_get_device_list(ctx, &list);
+  libusb_device_handle *handle = nullptr;
+  std::string port;
+  for (ssize_t k = 0; k < count && !handle; k++) {
+    struct libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(list[k], &desc) != 0 ||
+        desc.idVendor != MODULE_VID || desc.idProduct != MODULE_PID)
+      continue;
+    if (libusb_open(list[k], &handle) != 0) {
+      handle = nullptr;
+      continue;
+    }
+    if (!matches(list[k], handle, want)) {
+      libusb_close(handle);
+      handle = nullptr;
+      continue;
+    }
+    port = port_path(list[k]);
+  }
+  libusb_free_device_list(list, 1);
+
+  if (!handle) {
+    UsbContext::release();
+    *error = selector + ": no matching module";
+    return nullptr;
+  }
+
+  bool claimed = true;
+  bool detached[INTERFACES] = {};
+  for (int k = 0; k < INTERFACES && claimed; k++) {
+    if (libusb_kernel_driver_active(handle, k) == 1) {
+      if (libusb_detach_kernel_driver(handle, k) != 0) {
+        claimed = false;
+        break;
+      }
+      detached[k] = true;
+    }
+    if (libusb_claim_interface(handle, k) != 0)
+      claimed = false;
+  }
+
+  if (claimed) {
+    auto transport = std::make_unique<UsbTransport>(handle, options);
+    if (transport->start())
+      return transport;
+    *error = selector + ": could not submit bulk transfers";
+    return nullptr;
+  }
+
+  // someone else owns the interfaces; hand cdc-acm back and go through it instead
+  for (int k = 0; k < INTERFACES; k++) {
+    libusb_release_interface(handle, k);
+    if (detached[k])
+      libusb_attach_kernel_driver(handle, k);
+  }
+  libusb_close(handle);
+  UsbContext::release();
+  std::string tty = module_tty(port);
+  if (tty.empty()) {
+    *error = selector + ": cannot claim interfaces and no tty found for port " + port;
+    return nullptr;
+  }
+  fprintf(stderr, "%s: kernel driver busy, falling back to %s\n", selector.c_str(), tty.c_str());
+  return open_tty(tty, error);
+#else
+  // without libusb only the tty path exists; sysfs still maps serials and ports to it
+  (void)options;
+  std::string tty;
+  for (auto &m : list_modules()) {
+    if (want.empty() || want == m.serial || want == m.port) {
+      tty = m.tty;
+      break;
+    }
+  }
+  if (tty.empty()) {
+    *error = selector + ": built without libusb, and no cdc-acm tty found for this selector";
+    return nullptr;
+  }
+  return open_tty(tty, error);
+#endif
+}
+
+}  // namespace iq
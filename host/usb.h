@@ -0,0 +1,23 @@
+// libusb bulk transport with several transfers kept in flight
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "transport.h"
+
+namespace iq {
+
+struct UsbOptions {
+  int transfers = 8;            // bulk-in transfers kept in flight
+  size_t transfer_size = 32768; // bytes per transfer
+  size_t ring_size = 4 << 20;   // buffered bytes between transfers and reads
+};
+
+// selector is "usb" (first module found), "usb:SERIAL" or "usb:BUS-PORT[.PORT...]".
+// when the cdc-acm driver cannot be detached (or libusb is not built in) the
+// module's tty is opened instead.
+std::unique_ptr<Transport> open_usb(const std::string &selector, const UsbOptions &options, std::string *error);
+
+}  // namespace iq
@@ -0,0 +1,34 @@
+// fixed set of threads running posted tasks in fifo order
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace iq {
+
+class WorkerPool {
+ public:
+  // threads == 0 picks one per cpu
+  explicit WorkerPool(size_t threads = 0);
+  // runs every task already posted, then joins
+  ~WorkerPool();
+
+  void post(std::function<void()> task);
+  size_t size() const { return threads_.size(); }
+
+ private:
+  void run();
+
+  std::mutex lock_;
+  std::condition_variable ready_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace iq
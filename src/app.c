@@ -0,0 +1,346 @@
+/**
+  **************************************************************************
+  * @file     app.c
+  * @brief    usb command dispatch, sc12 packing and the READ_* streams.
+  *           everything hardware-specific goes through hal.h.
+  **************************************************************************
+  */
+
+#include <string.h>
+#include "app.h"
+#include "hal.h"
+#include "vitals.h"
+#include "clutter.h"
+#include "bench.h"
+#include "trigger.h"
+#include "prof.h"
+
+#define CFG_GPIO_PIN 0x1000
+#define CFG_DMA 0x1001
+#define CFG_ADC 0x1002
+#define TRIGGER_ADC 0x1003
+#define READ_ADC 0x1004
+#define READ_VITALS 0x1006
+#define CFG_CLUTTER 0x1007
+#define BENCH_CFAR 0x1008
+#define CFG_TRIGGER 0x1009
+#define READ_TRIGGERED 0x100A
+#define READ_VERSION 0x100B
+#define READ_PROFILE 0x100C
+
+/* set by the makefile from git describe */
+#ifndef FW_VERSION
+#define FW_VERSION "unknown"
+#endif
+#define FW_VERSION_SIZE 32
+
+struct usb_cmd_t {
+  uint32_t cmd_code;
+  uint32_t args[];
+};
+
+/* word-aligned, since commands are read in place through usb_cmd_t */
+static uint32_t usb_buffer[4096 / 4];
+
+/* commands received while streaming land here, since usb_buffer is in flight */
+static uint32_t stream_cmd_buffer[HAL_USB_PACKET_SIZE / 4];
+
+/* the READ_* command being streamed, or 0 */
+static uint32_t streaming;
+
+/**
+  * @brief  pack 12-bit i/q pairs into 3 bytes each, subtracting the clutter
+  *         estimate first when the clutter stage is enabled
+  * @param  block: i/q pairs
+  * @param  out: packed output, 3 bytes per pair
+  * @param  count: number of pairs in block
+  * @retval none
+  */
+void app_pack_block(const volatile uint16_t (*block)[2], uint8_t *out, uint32_t count)
+{
+  uint32_t x;
+  int32_t i, q, offset_i, offset_q;
+
+  if(!clutter_enabled()) {
+    for(x = 0; x < count; x++) {
+      out[x*3+0] = (block[x][0]>>4)&0xff;
+      out[x*3+1] = ((block[x][0]&0xf)<<4) | ((block[x][1]>>8)&0xf);
+      out[x*3+2] = (block[x][1]&0xff);
+    }
+    return;
+  }
+
+  offset_i = clutter_offset(0);
+  offset_q = clutter_offset(1);
+  for(x = 0; x < count; x++) {
+    i = block[x][0] + offset_i;
+    q = block[x][1] + offset_q;
+    i = i < 0 ? 0 : (i > 0xfff ? 0xfff : i);
+    q = q < 0 ? 0 : (q > 0xfff ? 0xfff : q);
+    out[x*3+0] = (i>>4)&0xff;
+    out[x*3+1] = ((i&0xf)<<4) | ((q>>8)&0xf);
+    out[x*3+2] = (q&0xff);
+  }
+}
+
+/**
+  * @brief  send, retrying until the endpoint takes the data
+  */
+static void usb_send(const void *data, uint16_t len)
+{
+  while(hal_usb_write((const uint8_t *)data, len) != 0);
+}
+
+/**
+  * @brief  apply control commands sent while streaming. these are not
+  *         acknowledged, since a response would land inside the sample stream.
+  *         for the same reason READ_PROFILE only ends the stream; sent again
+  *         once the stream has drained, it returns the profile.
+  * @param  none
+  * @retval none
+  */
+static void stream_poll_commands(void)
+{
+  struct usb_cmd_t * cmd = (struct usb_cmd_t *)stream_cmd_buffer;
+  uint16_t len = hal_usb_read((uint8_t *)stream_cmd_buffer);
+
+  if(len >= 12 && cmd->cmd_code == CFG_CLUTTER)
+    clutter_config(cmd->args[0], cmd->args[1]);
+  else if(len >= 16 && cmd->cmd_code == CFG_TRIGGER)
+    trigger_config(cmd->args[0], cmd->args[1], cmd->args[2]);
+  else if(len >= 4 && cmd->cmd_code == READ_PROFILE)
+    streaming = 0;
+}
+
+/**
+  * @brief  one block of READ_ADC: track static clutter, then pack 12-bit i+q
+  */
+static void stream_adc(void)
+{
+  const volatile uint16_t (*block)[2] = hal_adc_block();
+  uint32_t start, t;
+
+  if(!block)
+    return;
+  start = t = PROF_START();
+  clutter_update(block, HAL_ADC_BLOCK_PAIRS);
+  PROF_END(PROF_CLUTTER, t);
+  t = PROF_START();
+  app_pack_block(block, (uint8_t *)usb_buffer, HAL_ADC_BLOCK_PAIRS);
+  PROF_END(PROF_PACK, t);
+  hal_adc_release();
+  t = PROF_START();
+  usb_send(usb_buffer, HAL_ADC_BLOCK_PAIRS * 3);
+  PROF_END(PROF_USB_SEND, t);
+  PROF_END(PROF_BLOCK, start);
+
+  stream_poll_commands();
+}
+
+/**
+  * @brief  one step of READ_TRIGGERED: every block goes into the pre-trigger
+  *         ring, and usb takes frames from it only when it is free
+  */
+static void stream_triggered(void)
+{
+  const volatile uint16_t (*block)[2] = hal_adc_block();
+  struct trigger_frame_t * frame;
+  uint32_t energy = 0, start = 0, t;
+
+  if(block) {
+    start = t = PROF_START();
+    clutter_update(block, HAL_ADC_BLOCK_PAIRS);
+    energy = clutter_energy(block, HAL_ADC_BLOCK_PAIRS);
+    PROF_END(PROF_CLUTTER, t);
+    t = PROF_START();
+    app_pack_block(block, trigger_next_slot(), HAL_ADC_BLOCK_PAIRS);
+    PROF_END(PROF_PACK, t);
+    hal_adc_release();
+  }
+
+  // never wait on usb here, or blocks would be missed
+  t = PROF_START();
+  if(block)
+    trigger_commit(energy);
+  frame = trigger_pending();
+  if(frame && hal_usb_write((const uint8_t *)frame, sizeof(struct trigger_frame_t)) == 0)
+    trigger_sent();
+  if(block || frame)
+    PROF_END(PROF_TRIGGER, t);
+  if(block)
+    PROF_END(PROF_BLOCK, start);
+
+  stream_poll_commands();
+}
+
+/**
+  * @brief  one block of READ_VITALS, with a report every few output samples
+  */
+static void stream_vitals(void)
+{
+  const volatile uint16_t (*block)[2] = hal_adc_block();
+  uint32_t start, t;
+  int ready;
+
+  if(!block)
+    return;
+  start = PROF_START();
+  ready = vitals_process_block(block, HAL_ADC_BLOCK_PAIRS);
+  PROF_END(PROF_VITALS, start);
+  hal_adc_release();
+  if(ready) {
+    t = PROF_START();
+    usb_send(vitals_report(), sizeof(struct vitals_report_t));
+    PROF_END(PROF_USB_SEND, t);
+  }
+  PROF_END(PROF_BLOCK, start);
+
+  stream_poll_commands();
+}
+
+/**
+  * @brief  handle one command packet. replies are (cmd_code, status, ...)
+  *         written back over the command.
+  */
+static void dispatch(struct usb_cmd_t *cmd, uint16_t data_len)
+{
+  int status;
+
+  switch(cmd->cmd_code) {
+    case CFG_GPIO_PIN:
+      /* shorter packets would configure from the last command's arguments */
+      if(data_len >= 16) {
+        status = hal_gpio_config(cmd->args[0], cmd->args[1], cmd->args[2]);
+        if(data_len >= 20)
+          hal_gpio_write(cmd->args[0], cmd->args[1], cmd->args[3]);
+      } else {
+        status = 1;
+      }
+      cmd->args[0] = status;
+      usb_send(cmd, 8);
+      break;
+
+    case CFG_DMA:
+      hal_dma_config();
+      cmd->args[0] = 0;
+      usb_send(cmd, 8);
+      break;
+
+    case CFG_ADC:
+      hal_adc_config();
+      cmd->args[0] = 0;
+      usb_send(cmd, 8);
+      break;
+
+    case TRIGGER_ADC:
+      hal_adc_trigger();
+      cmd->args[0] = 0;
+      usb_send(cmd, 8);
+      break;
+
+    case CFG_CLUTTER:
+      if(data_len >= 12) {
+        clutter_config(cmd->args[0], cmd->args[1]);
+        cmd->args[0] = 0;
+      } else {
+        cmd->args[0] = 1;
+      }
+      usb_send(cmd, 8);
+      break;
+
+    case CFG_TRIGGER:
+      if(data_len >= 16) {
+        trigger_config(cmd->args[0], cmd->args[1], cmd->args[2]);
+        cmd->args[0] = 0;
+      } else {
+        cmd->args[0] = 1;
+      }
+      usb_send(cmd, 8);
+      break;
+
+    case READ_VERSION:
+      // (cmd_code, status, nul-padded version string)
+      cmd->args[0] = 0;
+      memset(&cmd->args[1], 0, FW_VERSION_SIZE);
+      strncpy((char *)&cmd->args[1], FW_VERSION, FW_VERSION_SIZE - 1);
+      usb_send(cmd, 8 + FW_VERSION_SIZE);
+      break;
+
+    case BENCH_CFAR:
+      bench_cfar((struct bench_cfar_result_t *)&cmd->args[1]);
+      cmd->args[0] = 0;
+      usb_send(cmd, 8 + sizeof(struct bench_cfar_result_t));
+      break;
+
+    case READ_PROFILE:
+      prof_report((struct prof_report_t *)&cmd->args[1]);
+      if(data_len >= 8 && (cmd->args[0] & PROF_RESET))
+        prof_reset();
+      cmd->args[0] = 0;
+      usb_send(cmd, 8 + sizeof(struct prof_report_t));
+      break;
+
+    case READ_ADC:
+      streaming = READ_ADC;
+      break;
+
+    case READ_TRIGGERED:
+      trigger_start(READ_TRIGGERED);
+      streaming = READ_TRIGGERED;
+      break;
+
+    case READ_VITALS:
+      vitals_init(READ_VITALS);
+      streaming = READ_VITALS;
+      break;
+
+    default:
+      // unhandled
+      break;
+  }
+}
+
+/**
+  * @brief  start over, waiting for commands
+  * @param  none
+  * @retval none
+  */
+void app_init(void)
+{
+  streaming = 0;
+}
+
+/**
+  * @brief  the READ_* command being streamed, or 0 while taking commands
+  */
+uint32_t app_streaming(void)
+{
+  return streaming;
+}
+
+/**
+  * @brief  handle one command or one stream step; the main loop calls this
+  *         forever
+  * @param  none
+  * @retval none
+  */
+void app_poll(void)
+{
+  uint16_t data_len;
+
+  switch(streaming) {
+    case READ_ADC:
+      stream_adc();
+      return;
+    case READ_TRIGGERED:
+      stream_triggered();
+      return;
+    case READ_VITALS:
+      stream_vitals();
+      return;
+  }
+
+  data_len = hal_usb_read((uint8_t *)usb_buffer);
+  if(data_len >= 4)
+    dispatch((struct usb_cmd_t *)usb_buffer, data_len);
+}
@@ -0,0 +1,32 @@
+/**
+  **************************************************************************
+  * @file     app.h
+  * @brief    usb command dispatch and streaming header file
+  **************************************************************************
+  */
+
+#ifndef __APP_H
+#define __APP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+  * @brief app_poll handles one command, or one step of the stream a READ_*
+  *        command started. streams never end on hardware; app_init returns
+  *        to waiting for commands, as a reset would.
+  */
+void app_init(void);
+void app_poll(void);
+uint32_t app_streaming(void);
+
+void app_pack_block(const volatile uint16_t (*block)[2], uint8_t *out, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,5 +1,6 @@
 #include "at32f403a_407_int.h"
 #include "at32f403a_407_board.h"
+#include "prof.h"
 
 extern __IO uint16_t dma_trans_complete_flag;
 
@@ -115,11 +116,20 @@ void SysTick_Handler(void)
   */
 void DMA1_Channel1_IRQHandler(void)
 {
+  static uint32_t last_block;
+  uint32_t start = PROF_START();
+
   if(dma_flag_get(DMA1_FDT1_FLAG) != RESET)
   {
     dma_flag_clear(DMA1_FDT1_FLAG);
+    if(dma_trans_complete_flag)
+      prof_overrun();
     dma_trans_complete_flag = 1;
+    if(last_block)
+      PROF_END(PROF_DMA_PERIOD, last_block);
+    last_block = start;
   }
+  PROF_END(PROF_DMA_ISR, start);
 }
 
 
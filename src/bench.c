@@ -0,0 +1,57 @@
+/**
+  **************************************************************************
+  * @file     bench.c
+  * @brief    kernel benchmarks, timed with hal_cycles: the dwt cycle counter
+  *           on target, nanoseconds on the host
+  **************************************************************************
+  */
+
+#include <math.h>
+#include "hal.h"
+#include "bench.h"
+#include "cfar.h"
+
+static float bench_power[BENCH_CFAR_CELLS];
+static float bench_threshold[BENCH_CFAR_CELLS];
+static float bench_scratch[64];
+
+/**
+  * @brief  fill the spectrum with unit-mean exponential noise and four targets
+  */
+static void bench_spectrum(void)
+{
+  uint32_t x, lcg = 1234;
+
+  for(x = 0; x < BENCH_CFAR_CELLS; x++) {
+    lcg = lcg * 1664525 + 1013904223;
+    bench_power[x] = -logf(((lcg >> 8) + 1) * (1.0f / 16777217.0f));
+  }
+  bench_power[BENCH_CFAR_CELLS / 8] += 40.0f;
+  bench_power[BENCH_CFAR_CELLS / 3] += 40.0f;
+  bench_power[BENCH_CFAR_CELLS / 2 + 7] += 40.0f;
+  bench_power[BENCH_CFAR_CELLS - BENCH_CFAR_CELLS / 5] += 40.0f;
+}
+
+/**
+  * @brief  time one pass of each cfar variant over a 1024-cell spectrum
+  * @param  result: cycle counts and detection counts per variant
+  * @retval none
+  */
+void bench_cfar(struct bench_cfar_result_t *result)
+{
+  struct cfar_config_t cfg = {CFAR_CA, 16, 2, 24, CFAR_CIRCULAR, 10.7f};
+  uint32_t variant, start;
+
+  hal_cycles_init();
+  bench_spectrum();
+  result->cells = BENCH_CFAR_CELLS;
+
+  for(variant = CFAR_CA; variant <= CFAR_OS; variant++) {
+    cfg.variant = variant;
+    cfg.scale = variant == CFAR_OS ? 6.0f : 10.7f;
+    start = hal_cycles();
+    result->detections[variant] = cfar_run(&cfg, bench_power, BENCH_CFAR_CELLS,
+                                           bench_threshold, 0, 0, bench_scratch);
+    result->cycles[variant] = hal_cycles() - start;
+  }
+}
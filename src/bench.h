@@ -0,0 +1,34 @@
+/**
+  **************************************************************************
+  * @file     bench.h
+  * @brief    on-target kernel benchmarks header file
+  **************************************************************************
+  */
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define BENCH_CFAR_CELLS                 1024
+
+/**
+  * @brief per-variant results, indexed by CFAR_CA / CFAR_GO / CFAR_OS
+  */
+struct bench_cfar_result_t {
+  uint32_t cells;
+  uint32_t cycles[3];
+  uint32_t detections[3];
+};
+
+void bench_cfar(struct bench_cfar_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
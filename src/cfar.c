@@ -0,0 +1,246 @@
+/**
+  **************************************************************************
+  * @file     cfar.c
+  * @brief    constant-false-alarm-rate detector
+  *
+  *           the training windows slide along the spectrum one cell at a
+  *           time, so each variant costs o(1) (ca/go: running sums) or
+  *           o(train) (os: a sorted window kept up to date by insertion)
+  *           per cell rather than re-scanning every window.
+  *
+  *           windows must not overlap the cell under test from the other
+  *           side, i.e. 2 * (guard + train) + 1 <= n.
+  **************************************************************************
+  */
+
+#include <string.h>
+#include "cfar.h"
+
+#if defined(ARM_MATH_CM4) && !defined(CFAR_USE_CMSIS)
+#define CFAR_USE_CMSIS
+#endif
+
+#ifdef CFAR_USE_CMSIS
+#include "arm_math.h"
+#endif
+
+struct window_t {
+  float sum;
+  uint32_t count;
+};
+
+struct cfar_state_t {
+  const struct cfar_config_t *cfg;
+  const float *x;
+  int32_t n;
+  struct window_t lag;
+  struct window_t lead;
+  float *sorted;
+  uint32_t sorted_count;
+};
+
+/**
+  * @brief  map a window index onto the spectrum
+  * @retval index, or -1 when it falls off a non-circular spectrum
+  */
+static int32_t cfar_index(const struct cfar_state_t *s, int32_t i)
+{
+  if(s->cfg->flags & CFAR_CIRCULAR) {
+    if(i < 0)
+      i += s->n;
+    else if(i >= s->n)
+      i -= s->n;
+    return i;
+  }
+  return (i < 0 || i >= s->n) ? -1 : i;
+}
+
+static uint32_t sorted_find(const float *sorted, uint32_t count, float v)
+{
+  uint32_t lo = 0, hi = count, mid;
+  while(lo < hi) {
+    mid = (lo + hi) / 2;
+    if(sorted[mid] < v)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void cfar_add(struct cfar_state_t *s, struct window_t *w, int32_t i)
+{
+  uint32_t pos;
+  float v;
+
+  if((i = cfar_index(s, i)) < 0)
+    return;
+  v = s->x[i];
+  w->sum += v;
+  w->count++;
+
+  if(s->sorted) {
+    pos = sorted_find(s->sorted, s->sorted_count, v);
+    memmove(&s->sorted[pos + 1], &s->sorted[pos], (s->sorted_count - pos) * sizeof(float));
+    s->sorted[pos] = v;
+    s->sorted_count++;
+  }
+}
+
+/**
+  * @brief  re-add a window from scratch
+  * @param  first: lowest spectrum index still in the window
+  * @param  cells: window length
+  * @retval none
+  */
+static void cfar_resum(const struct cfar_state_t *s, struct window_t *w, int32_t first, int32_t cells)
+{
+  int32_t i, k;
+
+  w->sum = 0;
+  for(k = 0; k < cells; k++) {
+    if((i = cfar_index(s, first + k)) >= 0)
+      w->sum += s->x[i];
+  }
+}
+
+static void cfar_remove(struct cfar_state_t *s, struct window_t *w, int32_t i)
+{
+  int32_t first = i + 1;
+  uint32_t pos;
+  float v;
+
+  if((i = cfar_index(s, i)) < 0)
+    return;
+  v = s->x[i];
+  w->sum -= v;
+  w->count--;
+
+  // a strong cell leaving cancels almost all of the sum and leaves float
+  // rounding from its stay behind (enough to go negative at 1e8 over unit
+  // noise); rebuild from the remaining cells instead
+  if(v > w->sum)
+    cfar_resum(s, w, first, s->cfg->train - 1);
+
+  if(s->sorted) {
+    pos = sorted_find(s->sorted, s->sorted_count, v);
+    s->sorted_count--;
+    memmove(&s->sorted[pos], &s->sorted[pos + 1], (s->sorted_count - pos) * sizeof(float));
+  }
+}
+
+static float cfar_noise(const struct cfar_state_t *s)
+{
+  const struct cfar_config_t *cfg = s->cfg;
+  uint32_t count = s->lag.count + s->lead.count;
+  float lag, lead;
+  uint32_t k;
+
+  if(count == 0)
+    return 0;
+
+  switch(cfg->variant) {
+    case CFAR_GO:
+      if(s->lag.count == 0)
+        return s->lead.sum / s->lead.count;
+      if(s->lead.count == 0)
+        return s->lag.sum / s->lag.count;
+      lag = s->lag.sum / s->lag.count;
+      lead = s->lead.sum / s->lead.count;
+      return lag > lead ? lag : lead;
+
+    case CFAR_OS:
+      // rank is defined for a full window; scale it down at the edges
+      k = cfg->rank * count / (2 * cfg->train);
+      if(k >= s->sorted_count)
+        k = s->sorted_count - 1;
+      return s->sorted[k];
+
+    case CFAR_CA:
+    default:
+      return (s->lag.sum + s->lead.sum) / count;
+  }
+}
+
+/**
+  * @brief  squared magnitude of interleaved complex samples
+  * @param  iq: n interleaved i/q pairs
+  * @param  power: n output cells
+  * @param  n: number of cells
+  * @retval none
+  */
+void cfar_power(const float *iq, float *power, uint32_t n)
+{
+#ifdef CFAR_USE_CMSIS
+  arm_cmplx_mag_squared_f32(iq, power, n);
+#else
+  uint32_t x;
+  for(x = 0; x < n; x++)
+    power[x] = iq[2*x] * iq[2*x] + iq[2*x+1] * iq[2*x+1];
+#endif
+}
+
+/**
+  * @brief  run a cfar detector over a power spectrum
+  * @param  cfg: detector configuration
+  * @param  power: n power cells
+  * @param  n: number of cells
+  * @param  threshold: n output thresholds
+  * @param  hits: output indices of cells above threshold, may be NULL
+  * @param  max_hits: capacity of hits
+  * @param  scratch: CFAR_SCRATCH_SIZE(cfg) floats, may be NULL for ca/go
+  * @retval number of detections (may exceed max_hits); 0 without touching
+  *         threshold when the windows do not fit in n or os has no scratch
+  */
+uint32_t cfar_run(const struct cfar_config_t *cfg, const float *power, uint32_t n,
+                  float *threshold, uint32_t *hits, uint32_t max_hits, float *scratch)
+{
+  struct cfar_state_t s;
+  int32_t i, t = cfg->train, g = cfg->guard;
+  uint32_t x, detections = 0;
+
+  // cfar_index() wraps a circular window only once
+  if(t == 0 || 2 * (cfg->guard + cfg->train) + 1 > n)
+    return 0;
+  if(cfg->variant == CFAR_OS && scratch == NULL)
+    return 0;
+
+  memset(&s, 0, sizeof(s));
+  s.cfg = cfg;
+  s.x = power;
+  s.n = n;
+  s.sorted = cfg->variant == CFAR_OS ? scratch : NULL;
+
+  // seed both windows around cell 0
+  for(i = 1; i <= t; i++) {
+    cfar_add(&s, &s.lag, -g - i);
+    cfar_add(&s, &s.lead, g + i);
+  }
+
+  for(i = 0; i < (int32_t)n; i++) {
+    if(i > 0) {
+      cfar_remove(&s, &s.lag, i - g - t - 1);
+      cfar_add(&s, &s.lag, i - g - 1);
+      cfar_remove(&s, &s.lead, i + g);
+      cfar_add(&s, &s.lead, i + g + t);
+    }
+    threshold[i] = cfar_noise(&s);
+  }
+
+#ifdef CFAR_USE_CMSIS
+  arm_scale_f32(threshold, cfg->scale, threshold, n);
+#else
+  for(x = 0; x < n; x++)
+    threshold[x] *= cfg->scale;
+#endif
+
+  for(x = 0; x < n; x++) {
+    if(power[x] > threshold[x]) {
+      if(hits && detections < max_hits)
+        hits[detections] = x;
+      detections++;
+    }
+  }
+
+  return detections;
+}
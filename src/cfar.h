@@ -0,0 +1,57 @@
+/**
+  **************************************************************************
+  * @file     cfar.h
+  * @brief    constant-false-alarm-rate detector header file
+  *
+  *           shared by the firmware (built against cmsis-dsp when
+  *           ARM_MATH_CM4 is defined) and the host tools (scalar fallback).
+  *           defining CFAR_USE_CMSIS builds the cmsis-dsp path anywhere, as
+  *           the golden-vector suite does on the host.
+  *           nothing here allocates; callers own every buffer.
+  **************************************************************************
+  */
+
+#ifndef __CFAR_H
+#define __CFAR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+  * @brief detector variants
+  */
+#define CFAR_CA                          0  /*!< cell averaging: mean of both windows */
+#define CFAR_GO                          1  /*!< greatest-of: larger of the two window means */
+#define CFAR_OS                          2  /*!< ordered statistic: k-th smallest training cell */
+
+/**
+  * @brief config flags
+  */
+#define CFAR_CIRCULAR                    0x01  /*!< windows wrap around (fft spectra) */
+
+struct cfar_config_t {
+  uint32_t variant;   /*!< CFAR_CA, CFAR_GO or CFAR_OS */
+  uint32_t train;     /*!< training cells on each side of the cell under test */
+  uint32_t guard;     /*!< guard cells on each side of the cell under test */
+  uint32_t rank;      /*!< CFAR_OS only: rank (0-based) among all 2 * train cells */
+  uint32_t flags;     /*!< CFAR_CIRCULAR */
+  float scale;        /*!< threshold = scale * noise estimate */
+};
+
+/**
+  * @brief scratch floats needed by cfar_run() for a given config
+  */
+#define CFAR_SCRATCH_SIZE(cfg)           ((cfg)->variant == CFAR_OS ? 2 * (cfg)->train : 0)
+
+void cfar_power(const float *iq, float *power, uint32_t n);
+uint32_t cfar_run(const struct cfar_config_t *cfg, const float *power, uint32_t n,
+                  float *threshold, uint32_t *hits, uint32_t max_hits, float *scratch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
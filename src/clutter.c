@@ -0,0 +1,117 @@
+/**
+  **************************************************************************
+  * @file     clutter.c
+  * @brief    static clutter estimation and subtraction
+  *
+  *           walls and furniture return a constant i/q vector, so static
+  *           clutter sits at zero doppler. each dma block is averaged
+  *           coherently and an exponential average of those block means
+  *           tracks the clutter vector, which is then subtracted from the
+  *           samples before they are packed. this is a one-pole high-pass on
+  *           the block means; slow human motion survives it at a cost of one
+  *           division per block.
+  **************************************************************************
+  */
+
+#include "clutter.h"
+
+#define ADC_MID_SCALE                    2048
+
+static uint32_t clutter_flags;
+static uint32_t clutter_shift = CLUTTER_DEFAULT_SHIFT;
+static int clutter_seeded;
+
+/* estimate per channel (i, q) in q16 adc counts */
+static int32_t clutter_est[2];
+
+/**
+  * @brief  configure the clutter stage
+  * @param  flags: CLUTTER_ENABLE | CLUTTER_FREEZE | CLUTTER_RESET
+  * @param  shift: learning rate as a right shift, 0 (block-by-block) to CLUTTER_MAX_SHIFT
+  * @retval none
+  */
+void clutter_config(uint32_t flags, uint32_t shift)
+{
+  if(shift > CLUTTER_MAX_SHIFT)
+    shift = CLUTTER_MAX_SHIFT;
+
+  if(flags & CLUTTER_RESET)
+    clutter_seeded = 0;
+
+  clutter_flags = flags & (CLUTTER_ENABLE | CLUTTER_FREEZE);
+  clutter_shift = shift;
+}
+
+int clutter_enabled(void)
+{
+  return (clutter_flags & CLUTTER_ENABLE) != 0;
+}
+
+/**
+  * @brief  fold one dma block into the clutter estimate
+  * @param  block: i/q pairs
+  * @param  count: number of pairs in block
+  * @retval none
+  */
+void clutter_update(const volatile uint16_t (*block)[2], uint32_t count)
+{
+  uint32_t x, ch;
+  int32_t sum[2] = {0, 0};
+  int32_t mean;
+
+  if((clutter_flags & CLUTTER_FREEZE) && clutter_seeded)
+    return;
+
+  for(x = 0; x < count; x++) {
+    sum[0] += block[x][0];
+    sum[1] += block[x][1];
+  }
+
+  for(ch = 0; ch < 2; ch++) {
+    mean = (int32_t)(((int64_t)sum[ch] << 16) / count);
+    if(!clutter_seeded)
+      clutter_est[ch] = mean;
+    else
+      clutter_est[ch] += (mean - clutter_est[ch]) >> clutter_shift;
+  }
+  clutter_seeded = 1;
+}
+
+/**
+  * @brief  offset to add to a raw sample to remove the clutter estimate
+  *         while keeping the result centered in the 12-bit range
+  * @param  channel: 0 for i, 1 for q
+  * @retval offset in adc counts
+  */
+int32_t clutter_offset(uint32_t channel)
+{
+  if(!clutter_seeded)
+    return 0;
+  return ADC_MID_SCALE - ((clutter_est[channel & 1] + 0x8000) >> 16);
+}
+
+/**
+  * @brief  cheap motion energy of a block: mean absolute deviation of i and
+  *         q from the clutter estimate
+  * @param  block: i/q pairs
+  * @param  count: number of pairs in block
+  * @retval energy in 1/16 adc counts
+  */
+uint32_t clutter_energy(const volatile uint16_t (*block)[2], uint32_t count)
+{
+  uint32_t x, sum = 0;
+  int32_t d, ci, cq;
+
+  if(count == 0)
+    return 0;
+
+  ci = (clutter_est[0] + 0x8000) >> 16;
+  cq = (clutter_est[1] + 0x8000) >> 16;
+  for(x = 0; x < count; x++) {
+    d = (int32_t)block[x][0] - ci;
+    sum += d < 0 ? -d : d;
+    d = (int32_t)block[x][1] - cq;
+    sum += d < 0 ? -d : d;
+  }
+  return (sum << 4) / count;
+}
@@ -0,0 +1,41 @@
+/**
+  **************************************************************************
+  * @file     clutter.h
+  * @brief    static clutter estimation and subtraction header file
+  **************************************************************************
+  */
+
+#ifndef __CLUTTER_H
+#define __CLUTTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+  * @brief CFG_CLUTTER flags (args[0])
+  */
+#define CLUTTER_ENABLE                   0x01  /*!< subtract the estimate from streamed samples */
+#define CLUTTER_FREEZE                   0x02  /*!< stop updating the estimate */
+#define CLUTTER_RESET                    0x04  /*!< re-seed the estimate from the next block */
+
+/**
+  * @brief learning rate, as a right shift of the per-block update (args[1]).
+  *        one block is ~3.6 ms, so the default shift of 8 averages ~0.9 s.
+  */
+#define CLUTTER_DEFAULT_SHIFT            8
+#define CLUTTER_MAX_SHIFT                15
+
+void clutter_config(uint32_t flags, uint32_t shift);
+int clutter_enabled(void);
+void clutter_update(const volatile uint16_t (*block)[2], uint32_t count);
+int32_t clutter_offset(uint32_t channel);
+uint32_t clutter_energy(const volatile uint16_t (*block)[2], uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
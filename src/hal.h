@@ -0,0 +1,71 @@
+/**
+  **************************************************************************
+  * @file     hal.h
+  * @brief    the drivers the application logic (app.c) runs on
+  *
+  *           hal_at32.c implements these on the at32f403a; host/fake_hal.cpp
+  *           implements them with fake adc/dma/usb drivers, so app.c and the
+  *           dsp modules build and run natively on a workstation.
+  **************************************************************************
+  */
+
+#ifndef __HAL_H
+#define __HAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+  * @brief largest usb packet a command can arrive in (USBD_CDC_OUT_MAXPACKET_SIZE)
+  */
+#define HAL_USB_PACKET_SIZE              64
+
+/**
+  * @brief one dma block: i/q pairs, sampled alternately from two adc channels
+  */
+#define HAL_ADC_BLOCK_PAIRS              1024
+
+void hal_init(void);
+
+/**
+  * @brief gpio: group 0 is GPIOA, 1 is GPIOB. return 0, or 1 for a bad group.
+  */
+int hal_gpio_config(uint32_t group, uint32_t pins, uint32_t mode);
+int hal_gpio_write(uint32_t group, uint32_t pins, uint32_t level);
+
+/**
+  * @brief adc and dma: once both are configured and the adc is triggered, the
+  *        dma fills one block after another in a loop. hal_adc_block returns
+  *        the block that just completed, or 0 while the next one is still
+  *        filling; the caller hands it back with hal_adc_release.
+  */
+void hal_dma_config(void);
+void hal_adc_config(void);
+void hal_adc_trigger(void);
+const volatile uint16_t (*hal_adc_block(void))[2];
+void hal_adc_release(void);
+
+/**
+  * @brief usb cdc: hal_usb_read copies out one received packet and returns
+  *        its length, or 0 if none arrived. hal_usb_write returns 0 once the
+  *        data is queued, nonzero while the endpoint is still busy.
+  */
+uint16_t hal_usb_read(uint8_t *buf);
+int hal_usb_write(const uint8_t *buf, uint16_t len);
+
+/**
+  * @brief free-running cycle counter for benchmarks and profiling, counting
+  *        at hal_cycles_hz. hal_init starts it.
+  */
+void hal_cycles_init(void);
+uint32_t hal_cycles(void);
+uint32_t hal_cycles_hz(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
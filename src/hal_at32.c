@@ -0,0 +1,265 @@
+/**
+  **************************************************************************
+  * @file     hal_at32.c
+  * @brief    hal.h on the at32f403a: clocks, gpio, adc1 with dma1 channel 1,
+  *           and the usb cdc vcp
+  **************************************************************************
+  */
+
+#include "at32f403a_407_board.h"
+#include "at32f403a_407_clock.h"
+#include "usbd_core.h"
+#include "cdc_class.h"
+#include "cdc_desc.h"
+#include "usbd_int.h"
+#include "hal.h"
+
+#if USBD_CDC_OUT_MAXPACKET_SIZE > HAL_USB_PACKET_SIZE
+#error "usb packets no longer fit HAL_USB_PACKET_SIZE"
+#endif
+
+usbd_core_type usb_core_dev;
+
+__IO uint16_t adc1_ordinary_valuetab[HAL_ADC_BLOCK_PAIRS][2] = {0};
+__IO uint16_t dma_trans_complete_flag = 0;
+
+/**
+  * @brief  usb 48M clock select
+  * @param  clk_s:USB_CLK_HICK, USB_CLK_HEXT
+  * @retval none
+  */
+static void usb_clock48m_select(usb_clk48_s clk_s)
+{
+  crm_usb_clock_source_select(CRM_USB_CLOCK_SOURCE_HICK);
+
+  /* enable the acc calibration ready interrupt */
+  crm_periph_clock_enable(CRM_ACC_PERIPH_CLOCK, TRUE);
+
+  /* update the c1\c2\c3 value */
+  acc_write_c1(7980);
+  acc_write_c2(8000);
+  acc_write_c3(8020);
+
+  /* open acc calibration */
+  acc_calibration_mode_enable(ACC_CAL_HICKTRIM, TRUE);
+}
+
+static void init_gpio(void)
+{
+  gpio_init_type gpio_initstructure;
+
+  crm_periph_clock_enable(CRM_GPIOA_PERIPH_CLOCK, TRUE);
+  crm_periph_clock_enable(CRM_GPIOB_PERIPH_CLOCK, TRUE);
+
+  gpio_default_para_init(&gpio_initstructure);
+  gpio_init(GPIOA, &gpio_initstructure);
+
+  gpio_default_para_init(&gpio_initstructure);
+  gpio_init(GPIOB, &gpio_initstructure);
+}
+
+static gpio_type * gpio_group(uint32_t group)
+{
+  switch(group) {
+    case 0:
+      return GPIOA;
+    case 1:
+      return GPIOB;
+    default:
+      return 0;
+  }
+}
+
+/**
+  * @brief  clocks, gpio and usb; the adc and dma wait for their commands
+  * @param  none
+  * @retval none
+  */
+void hal_init(void)
+{
+  system_clock_config();
+  init_gpio();
+
+  nvic_priority_group_config(NVIC_PRIORITY_GROUP_4);
+  at32_board_init();
+  usb_clock48m_select(USB_CLK_HICK);
+  crm_periph_clock_enable(CRM_USB_PERIPH_CLOCK, TRUE);
+  nvic_irq_enable(USBFS_L_CAN1_RX0_IRQn, 0, 0);
+  usbd_core_init(&usb_core_dev, USB, &cdc_class_handler, &cdc_desc_handler, 0);
+  usbd_connect(&usb_core_dev);
+  hal_cycles_init();
+}
+
+int hal_gpio_config(uint32_t group, uint32_t pins, uint32_t mode)
+{
+  gpio_type * gpio = gpio_group(group);
+  gpio_init_type gpio_initstructure;
+
+  if(!gpio)
+    return 1;
+  gpio_default_para_init(&gpio_initstructure);
+  gpio_initstructure.gpio_mode = (gpio_mode_type)mode;
+  gpio_initstructure.gpio_pins = pins;
+  gpio_init(gpio, &gpio_initstructure);
+  return 0;
+}
+
+int hal_gpio_write(uint32_t group, uint32_t pins, uint32_t level)
+{
+  gpio_type * gpio = gpio_group(group);
+
+  if(!gpio)
+    return 1;
+  if(level)
+    gpio_bits_set(gpio, pins);
+  else
+    gpio_bits_reset(gpio, pins);
+  return 0;
+}
+
+/**
+  * @brief  dma configuration: adc1 into adc1_ordinary_valuetab, in a loop,
+  *         with an interrupt per full buffer
+  * @param  none
+  * @retval none
+  */
+void hal_dma_config(void)
+{
+  dma_init_type dma_init_struct;
+  crm_periph_clock_enable(CRM_DMA1_PERIPH_CLOCK, TRUE);
+  nvic_irq_enable(DMA1_Channel1_IRQn, 0, 0);
+  dma_reset(DMA1_CHANNEL1);
+  dma_default_para_init(&dma_init_struct);
+  dma_init_struct.buffer_size = HAL_ADC_BLOCK_PAIRS * 2;
+  dma_init_struct.direction = DMA_DIR_PERIPHERAL_TO_MEMORY;
+  dma_init_struct.memory_base_addr = (uint32_t)adc1_ordinary_valuetab;
+  dma_init_struct.memory_data_width = DMA_MEMORY_DATA_WIDTH_HALFWORD;
+  dma_init_struct.memory_inc_enable = TRUE;
+  dma_init_struct.peripheral_base_addr = (uint32_t)&(ADC1->odt);
+  dma_init_struct.peripheral_data_width = DMA_PERIPHERAL_DATA_WIDTH_HALFWORD;
+  dma_init_struct.peripheral_inc_enable = FALSE;
+  dma_init_struct.priority = DMA_PRIORITY_HIGH;
+  dma_init_struct.loop_mode_enable = TRUE;
+  dma_init(DMA1_CHANNEL1, &dma_init_struct);
+
+  dma_interrupt_enable(DMA1_CHANNEL1, DMA_FDT_INT, TRUE);
+  dma_channel_enable(DMA1_CHANNEL1, TRUE);
+}
+
+/**
+  * @brief  adc configuration.
+  * @param  none
+  * @retval none
+  */
+void hal_adc_config(void)
+{
+  adc_base_config_type adc_base_struct;
+  crm_periph_clock_enable(CRM_ADC1_PERIPH_CLOCK, TRUE);
+  crm_adc_clock_div_set(CRM_ADC_DIV_2);
+
+  adc_combine_mode_select(ADC_INDEPENDENT_MODE);
+  adc_base_default_para_init(&adc_base_struct);
+  adc_base_struct.sequence_mode = TRUE;
+  adc_base_struct.repeat_mode = TRUE;
+  adc_base_struct.data_align = ADC_RIGHT_ALIGNMENT;
+  adc_base_struct.ordinary_channel_length = 2;
+
+  adc_base_config(ADC1, &adc_base_struct);
+
+
+  // opamp output stage 1?
+  adc_ordinary_channel_set(ADC1, ADC_CHANNEL_6, 1, ADC_SAMPLETIME_71_5);
+  adc_ordinary_channel_set(ADC1, ADC_CHANNEL_7, 2, ADC_SAMPLETIME_71_5);
+
+  // opamp output stage 2?
+  // adc_ordinary_channel_set(ADC1, ADC_CHANNEL_8, 1, ADC_SAMPLETIME_71_5);
+  // adc_ordinary_channel_set(ADC1, ADC_CHANNEL_9, 2, ADC_SAMPLETIME_71_5);
+
+  adc_ordinary_conversion_trigger_set(ADC1, ADC12_ORDINARY_TRIG_SOFTWARE, TRUE);
+  adc_dma_mode_enable(ADC1, TRUE);
+
+  adc_enable(ADC1, TRUE);
+  adc_calibration_init(ADC1);
+  while(adc_calibration_init_status_get(ADC1));
+  adc_calibration_start(ADC1);
+  while(adc_calibration_status_get(ADC1));
+}
+
+void hal_adc_trigger(void)
+{
+  adc_ordinary_software_trigger_enable(ADC1, TRUE);
+}
+
+/**
+  * @brief  the dma interrupt (at32f403a_407_int.c) sets the flag per block
+  */
+const volatile uint16_t (*hal_adc_block(void))[2]
+{
+  return dma_trans_complete_flag ? adc1_ordinary_valuetab : 0;
+}
+
+void hal_adc_release(void)
+{
+  dma_trans_complete_flag = 0;
+}
+
+uint16_t hal_usb_read(uint8_t *buf)
+{
+  return usb_vcp_get_rxdata(&usb_core_dev, buf);
+}
+
+int hal_usb_write(const uint8_t *buf, uint16_t len)
+{
+  return usb_vcp_send_data(&usb_core_dev, (uint8_t *)buf, len) != SUCCESS;
+}
+
+/**
+  * @brief  start the dwt cycle counter. it is never zeroed, since profiled
+  *         zones may be open in the dma interrupt.
+  */
+void hal_cycles_init(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t hal_cycles(void)
+{
+  return DWT->CYCCNT;
+}
+
+uint32_t hal_cycles_hz(void)
+{
+  return system_core_clock;
+}
+
+/**
+  * @brief  this function handles usb interrupt.
+  * @param  none
+  * @retval none
+  */
+void USBFS_L_CAN1_RX0_IRQHandler(void)
+{
+  usbd_irq_handler(&usb_core_dev);
+}
+
+/**
+  * @brief  usb delay millisecond function.
+  * @param  ms: number of millisecond delay
+  * @retval none
+  */
+void usb_delay_ms(uint32_t ms)
+{
+  /* user can define self delay function */
+  delay_ms(ms);
+}
+
+/**
+  * @brief  usb delay microsecond function.
+  * @param  us: number of microsecond delay
+  * @retval none
+  */
+void usb_delay_us(uint32_t us)
+{
+  delay_us(us);
+}
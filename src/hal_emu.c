@@ -0,0 +1,272 @@
+/**
+  **************************************************************************
+  * @file     hal_emu.c
+  * @brief    hal.h on the renode model of the at32f403a (emu/at32f403a.repl)
+  *
+  *           clocks, gpio and the adc go through the same drivers as
+  *           hal_at32.c. the model has no usb device, so usart1 carries the
+  *           command and stream bytes instead (a pty on the host). its adc
+  *           replays a sample file but cannot raise dma requests, so the
+  *           dma's block copy is done here, paced by the cycle counter:
+  *           blocks that fall due while the main loop is busy are skipped
+  *           and counted as overruns, as the dma would overwrite them.
+  **************************************************************************
+  */
+
+#include <string.h>
+#include "at32f403a_407_board.h"
+#include "at32f403a_407_clock.h"
+#include "hal.h"
+#include "prof.h"
+
+/**
+  * @brief a command ends when usart1 has been idle this long (1 ms)
+  */
+#define EMU_RX_IDLE_DIV                  1000
+
+/**
+  * @brief adc1 register, emulator only: write n to skip n samples
+  */
+#define EMU_ADC_SKIP                     (*(__IO uint32_t *)(ADC1_BASE + 0x80))
+
+/* at32f403a_407_int.c's dma interrupt never fires here, but still links */
+__IO uint16_t dma_trans_complete_flag = 0;
+
+static uint16_t adc_block[HAL_ADC_BLOCK_PAIRS][2];
+static uint8_t adc_ready;
+static uint8_t adc_running;
+static uint32_t adc_due;
+static uint32_t adc_period;
+static uint32_t last_block;
+
+static uint8_t rx_packet[HAL_USB_PACKET_SIZE];
+static uint16_t rx_len;
+static uint32_t rx_last;
+
+static gpio_type * gpio_group(uint32_t group)
+{
+  switch(group) {
+    case 0:
+      return GPIOA;
+    case 1:
+      return GPIOB;
+    default:
+      return 0;
+  }
+}
+
+/**
+  * @brief  usart1 on pa9 (tx) and pa10 (rx)
+  * @param  none
+  * @retval none
+  */
+static void init_usart(void)
+{
+  gpio_init_type gpio_initstructure;
+
+  crm_periph_clock_enable(CRM_USART1_PERIPH_CLOCK, TRUE);
+
+  gpio_default_para_init(&gpio_initstructure);
+  gpio_initstructure.gpio_mode = GPIO_MODE_MUX;
+  gpio_initstructure.gpio_pins = GPIO_PINS_9;
+  gpio_init(GPIOA, &gpio_initstructure);
+  gpio_initstructure.gpio_mode = GPIO_MODE_INPUT;
+  gpio_initstructure.gpio_pins = GPIO_PINS_10;
+  gpio_init(GPIOA, &gpio_initstructure);
+
+  usart_init(USART1, 115200, USART_DATA_8BITS, USART_STOP_1_BIT);
+  usart_transmitter_enable(USART1, TRUE);
+  usart_receiver_enable(USART1, TRUE);
+  usart_enable(USART1, TRUE);
+}
+
+/**
+  * @brief  clocks, gpio and usart1; the adc waits for its commands
+  * @param  none
+  * @retval none
+  */
+void hal_init(void)
+{
+  gpio_init_type gpio_initstructure;
+
+  system_clock_config();
+
+  crm_periph_clock_enable(CRM_GPIOA_PERIPH_CLOCK, TRUE);
+  crm_periph_clock_enable(CRM_GPIOB_PERIPH_CLOCK, TRUE);
+  gpio_default_para_init(&gpio_initstructure);
+  gpio_init(GPIOA, &gpio_initstructure);
+  gpio_default_para_init(&gpio_initstructure);
+  gpio_init(GPIOB, &gpio_initstructure);
+
+  init_usart();
+  hal_cycles_init();
+  adc_period = (uint32_t)((uint64_t)system_core_clock * HAL_ADC_BLOCK_PAIRS * 7 / 2000000);
+}
+
+int hal_gpio_config(uint32_t group, uint32_t pins, uint32_t mode)
+{
+  gpio_type * gpio = gpio_group(group);
+  gpio_init_type gpio_initstructure;
+
+  if(!gpio)
+    return 1;
+  gpio_default_para_init(&gpio_initstructure);
+  gpio_initstructure.gpio_mode = (gpio_mode_type)mode;
+  gpio_initstructure.gpio_pins = pins;
+  gpio_init(gpio, &gpio_initstructure);
+  return 0;
+}
+
+int hal_gpio_write(uint32_t group, uint32_t pins, uint32_t level)
+{
+  gpio_type * gpio = gpio_group(group);
+
+  if(!gpio)
+    return 1;
+  if(level)
+    gpio_bits_set(gpio, pins);
+  else
+    gpio_bits_reset(gpio, pins);
+  return 0;
+}
+
+/**
+  * @brief  nothing to set up: hal_adc_block copies the blocks itself
+  */
+void hal_dma_config(void)
+{
+  adc_ready = 0;
+}
+
+/**
+  * @brief  adc configuration, as in hal_at32.c
+  * @param  none
+  * @retval none
+  */
+void hal_adc_config(void)
+{
+  adc_base_config_type adc_base_struct;
+  crm_periph_clock_enable(CRM_ADC1_PERIPH_CLOCK, TRUE);
+  crm_adc_clock_div_set(CRM_ADC_DIV_2);
+
+  adc_combine_mode_select(ADC_INDEPENDENT_MODE);
+  adc_base_default_para_init(&adc_base_struct);
+  adc_base_struct.sequence_mode = TRUE;
+  adc_base_struct.repeat_mode = TRUE;
+  adc_base_struct.data_align = ADC_RIGHT_ALIGNMENT;
+  adc_base_struct.ordinary_channel_length = 2;
+  adc_base_config(ADC1, &adc_base_struct);
+
+  adc_ordinary_channel_set(ADC1, ADC_CHANNEL_6, 1, ADC_SAMPLETIME_71_5);
+  adc_ordinary_channel_set(ADC1, ADC_CHANNEL_7, 2, ADC_SAMPLETIME_71_5);
+  adc_ordinary_conversion_trigger_set(ADC1, ADC12_ORDINARY_TRIG_SOFTWARE, TRUE);
+  adc_dma_mode_enable(ADC1, TRUE);
+
+  adc_enable(ADC1, TRUE);
+  adc_calibration_init(ADC1);
+  while(adc_calibration_init_status_get(ADC1));
+  adc_calibration_start(ADC1);
+  while(adc_calibration_status_get(ADC1));
+}
+
+/**
+  * @brief  the model restarts its sample file on the trigger
+  */
+void hal_adc_trigger(void)
+{
+  adc_ordinary_software_trigger_enable(ADC1, TRUE);
+  adc_running = 1;
+  adc_ready = 0;
+  adc_due = hal_cycles() + adc_period;
+}
+
+/**
+  * @brief  where the dma would complete a block: once one is due, copy it
+  *         out of the adc, after skipping any that were missed
+  */
+const volatile uint16_t (*hal_adc_block(void))[2]
+{
+  uint32_t now, late, missed, x;
+
+  if(adc_ready)
+    return adc_block;
+  now = hal_cycles();
+  if(!adc_running || (int32_t)(now - adc_due) < 0)
+    return 0;
+
+  late = now - adc_due;
+  missed = late / adc_period;
+  if(missed) {
+    EMU_ADC_SKIP = missed * HAL_ADC_BLOCK_PAIRS * 2;
+    for(x = 0; x < missed; x++)
+      prof_overrun();
+  }
+  for(x = 0; x < HAL_ADC_BLOCK_PAIRS; x++) {
+    adc_block[x][0] = (uint16_t)ADC1->odt;
+    adc_block[x][1] = (uint16_t)ADC1->odt;
+  }
+  adc_due += (missed + 1) * adc_period;
+
+  if(last_block)
+    prof_record(PROF_DMA_PERIOD, now - last_block);
+  last_block = now;
+  adc_ready = 1;
+  return adc_block;
+}
+
+void hal_adc_release(void)
+{
+  adc_ready = 0;
+}
+
+/**
+  * @brief  usart1 has no packets: a command is the bytes received until the
+  *         line goes idle, as the host writes each command in one go
+  */
+uint16_t hal_usb_read(uint8_t *buf)
+{
+  uint16_t len;
+
+  while(usart_flag_get(USART1, USART_RDBF_FLAG) != RESET && rx_len < HAL_USB_PACKET_SIZE) {
+    rx_packet[rx_len++] = (uint8_t)usart_data_receive(USART1);
+    rx_last = hal_cycles();
+  }
+  if(!rx_len ||
+     (rx_len < HAL_USB_PACKET_SIZE && hal_cycles() - rx_last < system_core_clock / EMU_RX_IDLE_DIV))
+    return 0;
+
+  len = rx_len;
+  memcpy(buf, rx_packet, len);
+  rx_len = 0;
+  return len;
+}
+
+int hal_usb_write(const uint8_t *buf, uint16_t len)
+{
+  uint16_t x;
+
+  for(x = 0; x < len; x++) {
+    while(usart_flag_get(USART1, USART_TDBE_FLAG) == RESET);
+    usart_data_transmit(USART1, buf[x]);
+  }
+  return 0;
+}
+
+/**
+  * @brief  the dwt cycle counter, which the model counts in instructions
+  */
+void hal_cycles_init(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t hal_cycles(void)
+{
+  return DWT->CYCCNT;
+}
+
+uint32_t hal_cycles_hz(void)
+{
+  return system_core_clock;
+}
@@ -0,0 +1,66 @@
+/**
+  **************************************************************************
+  * @file     prof.c
+  * @brief    per-zone cycle profiling of the stream path
+  *
+  *           recording is a handful of instructions, so zones can stay in
+  *           release builds. a reset or report from the main loop can race
+  *           the dma interrupt's zones by one sample, which is fine here.
+  **************************************************************************
+  */
+
+#include <string.h>
+#include "prof.h"
+
+static struct prof_zone_t zones[PROF_ZONES];
+static volatile uint32_t overruns;
+
+/**
+  * @brief  add one duration to a zone
+  * @param  zone: PROF_*
+  * @param  cycles: duration in hal_cycles
+  * @retval none
+  */
+void prof_record(uint32_t zone, uint32_t cycles)
+{
+  struct prof_zone_t *z = &zones[zone];
+  uint32_t bucket = cycles ? 31 - __builtin_clz(cycles) : 0;
+  uint32_t sum_lo = z->sum_lo + cycles;
+
+  if(z->count == 0 || cycles < z->min)
+    z->min = cycles;
+  if(cycles > z->max)
+    z->max = cycles;
+  z->sum_hi += sum_lo < z->sum_lo;
+  z->sum_lo = sum_lo;
+  z->hist[bucket < PROF_BUCKETS ? bucket : PROF_BUCKETS - 1]++;
+  z->count++;
+}
+
+/**
+  * @brief  count a dma block that completed while the last was still held
+  */
+void prof_overrun(void)
+{
+  overruns++;
+}
+
+void prof_reset(void)
+{
+  memset(zones, 0, sizeof(zones));
+  overruns = 0;
+}
+
+/**
+  * @brief  copy out every zone
+  * @param  report: filled in
+  * @retval none
+  */
+void prof_report(struct prof_report_t *report)
+{
+  report->zones = PROF_ZONES;
+  report->cycles_hz = hal_cycles_hz();
+  report->overruns = overruns;
+  report->reserved = 0;
+  memcpy(report->zone, zones, sizeof(zones));
+}
@@ -0,0 +1,90 @@
+/**
+  **************************************************************************
+  * @file     prof.h
+  * @brief    per-zone cycle profiling of the stream path header file
+  *
+  *           a zone is timed with the hal cycle counter (the dwt on target):
+  *
+  *             uint32_t t = PROF_START();
+  *             app_pack_block(...);
+  *             PROF_END(PROF_PACK, t);
+  *
+  *           each zone keeps a count, min, max, sum and a log2 histogram.
+  *           READ_PROFILE returns them. build with PROF=0 (-DPROF_DISABLE)
+  *           to compile the zones out.
+  **************************************************************************
+  */
+
+#ifndef __PROF_H
+#define __PROF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "hal.h"
+
+/**
+  * @brief zones. the dma ones are recorded in the dma interrupt, the rest
+  *        by the main loop; each zone only ever from one of the two.
+  */
+#define PROF_DMA_ISR                     0  /*!< dma interrupt handler */
+#define PROF_DMA_PERIOD                  1  /*!< between dma block interrupts */
+#define PROF_BLOCK                       2  /*!< main loop work per block, all stages */
+#define PROF_CLUTTER                     3  /*!< clutter_update (and clutter_energy) */
+#define PROF_PACK                        4  /*!< sc12 packing */
+#define PROF_USB_SEND                    5  /*!< waiting for usb to take a block */
+#define PROF_TRIGGER                     6  /*!< trigger ring commit and send */
+#define PROF_VITALS                      7  /*!< vitals_process_block */
+#define PROF_ZONES                       8
+
+/**
+  * @brief histogram bucket k counts durations of [2^k, 2^(k+1)) cycles;
+  *        bucket 0 also takes 0, the last everything from 2^23 up
+  */
+#define PROF_BUCKETS                     24
+
+/**
+  * @brief READ_PROFILE args[0] flags
+  */
+#define PROF_RESET                       0x01  /*!< clear the zones once read */
+
+struct prof_zone_t {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint32_t sum_lo;  /*!< sum of all durations, 64 bits */
+  uint32_t sum_hi;
+  uint32_t hist[PROF_BUCKETS];
+};
+
+/**
+  * @brief READ_PROFILE reply, after (cmd_code, status)
+  */
+struct prof_report_t {
+  uint32_t zones;          /*!< PROF_ZONES */
+  uint32_t cycles_hz;      /*!< cycle counter rate */
+  uint32_t overruns;       /*!< dma blocks completed before the last was released */
+  uint32_t reserved;
+  struct prof_zone_t zone[PROF_ZONES];
+};
+
+#ifndef PROF_DISABLE
+#define PROF_START()                     hal_cycles()
+#define PROF_END(zone, start)            prof_record((zone), hal_cycles() - (start))
+#else
+#define PROF_START()                     0
+#define PROF_END(zone, start)            ((void)(start))
+#endif
+
+void prof_record(uint32_t zone, uint32_t cycles);
+void prof_overrun(void);
+void prof_reset(void);
+void prof_report(struct prof_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
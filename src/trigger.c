@@ -0,0 +1,171 @@
+/**
+  **************************************************************************
+  * @file     trigger.c
+  * @brief    event-triggered capture with a pre-trigger ring
+  *
+  *           every packed block goes into a ring in sram. while idle the
+  *           ring just holds the most recent history. when a block's energy
+  *           crosses the threshold, the pre-trigger history and the next
+  *           post_blocks blocks are queued for usb, oldest first, each with
+  *           a trigger_frame_t header. if usb falls behind, the oldest
+  *           unsent block is dropped and flagged.
+  *
+  *           usb keeps reading the last frame it was handed until the next
+  *           write is accepted, so that frame is never packed into: when its
+  *           slot comes round again it is swapped for a spare frame.
+  **************************************************************************
+  */
+
+#include "trigger.h"
+
+static struct trigger_frame_t ring[TRIGGER_RING_BLOCKS + 1];
+static uint8_t slot[TRIGGER_RING_BLOCKS];    /* block b lives in ring[slot[b % TRIGGER_RING_BLOCKS]] */
+static uint8_t spare;                        /* the frame no slot maps to */
+static struct trigger_frame_t *in_flight;    /* last frame handed to usb */
+
+static uint32_t trigger_cmd_code;
+static uint32_t trigger_threshold = 0xffffffff;
+static uint32_t trigger_pre = 4;
+static uint32_t trigger_post = 16;
+
+/* absolute block counters */
+static uint32_t written;       /* blocks committed so far */
+static uint32_t next_send;     /* next block to hand to usb */
+static uint32_t event_end;     /* one past the last block of the active event */
+static uint32_t event_trigger; /* block that fired the active event */
+static uint32_t event_seq;
+static int event_active;
+static int dropped;
+
+static struct trigger_frame_t * trigger_frame(uint32_t block)
+{
+  return &ring[slot[block % TRIGGER_RING_BLOCKS]];
+}
+
+/**
+  * @brief  configure the trigger
+  * @param  threshold: detector energy, in 1/16 adc counts, that fires an event
+  * @param  pre_blocks: history blocks sent before the trigger block (clamped to TRIGGER_MAX_PRE_BLOCKS)
+  * @param  post_blocks: blocks sent after the trigger block
+  * @retval none
+  */
+void trigger_config(uint32_t threshold, uint32_t pre_blocks, uint32_t post_blocks)
+{
+  trigger_threshold = threshold;
+  trigger_pre = pre_blocks > TRIGGER_MAX_PRE_BLOCKS ? TRIGGER_MAX_PRE_BLOCKS : pre_blocks;
+  trigger_post = post_blocks;
+}
+
+/**
+  * @brief  reset the ring and start watching for events
+  * @param  cmd_code: command code stamped into each frame
+  * @retval none
+  */
+void trigger_start(uint32_t cmd_code)
+{
+  uint32_t x, k;
+
+  // a frame from the last run may still be on its way out
+  spare = in_flight ? in_flight - ring : TRIGGER_RING_BLOCKS;
+  for(x = 0, k = 0; x < TRIGGER_RING_BLOCKS; x++, k++) {
+    if(k == spare)
+      k++;
+    slot[x] = k;
+  }
+
+  trigger_cmd_code = cmd_code;
+  written = 0;
+  next_send = 0;
+  event_end = 0;
+  event_seq = 0;
+  event_active = 0;
+  dropped = 0;
+}
+
+/**
+  * @brief  slot the next block should be packed into
+  */
+uint8_t * trigger_next_slot(void)
+{
+  uint8_t *s = &slot[written % TRIGGER_RING_BLOCKS], x;
+
+  if(&ring[*s] == in_flight) {
+    x = *s;
+    *s = spare;
+    spare = x;
+  }
+  return ring[*s].data;
+}
+
+/**
+  * @brief  commit the block packed into trigger_next_slot()
+  * @param  energy: detector energy of the block, 1/16 adc counts
+  * @retval none
+  */
+void trigger_commit(uint32_t energy)
+{
+  struct trigger_frame_t *frame = trigger_frame(written);
+  uint32_t oldest, first;
+
+  frame->cmd_code = trigger_cmd_code;
+  frame->block = written;
+  frame->energy = energy;
+  frame->flags = 0;
+
+  if(!event_active && energy >= trigger_threshold) {
+    // history is limited by the ring and by the end of the previous event
+    oldest = written >= TRIGGER_MAX_PRE_BLOCKS ? written - TRIGGER_MAX_PRE_BLOCKS : 0;
+    first = written >= trigger_pre ? written - trigger_pre : 0;
+    if(first < oldest)
+      first = oldest;
+    if(first < event_end)
+      first = event_end;
+
+    event_active = 1;
+    event_seq++;
+    event_trigger = written;
+    event_end = written + trigger_post + 1;
+    next_send = first;
+    dropped = 0;
+  }
+
+  written++;
+
+  // the next block is packed over the oldest one
+  if(event_active && written - next_send > TRIGGER_RING_BLOCKS - 1) {
+    next_send = written - (TRIGGER_RING_BLOCKS - 1);
+    dropped = 1;
+  }
+}
+
+/**
+  * @brief  next frame to send, if an event has one ready
+  * @retval frame, or 0 when there is nothing to send
+  */
+struct trigger_frame_t * trigger_pending(void)
+{
+  struct trigger_frame_t *frame;
+
+  if(!event_active || next_send >= written || next_send >= event_end)
+    return 0;
+
+  frame = trigger_frame(next_send);
+  frame->event = event_seq;
+  frame->trigger_block = event_trigger;
+  if(dropped)
+    frame->flags |= TRIGGER_FLAG_DROPPED;
+  if(next_send + 1 == event_end)
+    frame->flags |= TRIGGER_FLAG_LAST;
+  return frame;
+}
+
+/**
+  * @brief  mark the frame returned by trigger_pending() as handed to usb
+  */
+void trigger_sent(void)
+{
+  in_flight = trigger_frame(next_send);
+  dropped = 0;
+  if(++next_send >= event_end)
+    event_active = 0;
+}
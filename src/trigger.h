@@ -0,0 +1,58 @@
+/**
+  **************************************************************************
+  * @file     trigger.h
+  * @brief    event-triggered capture with a pre-trigger ring header file
+  **************************************************************************
+  */
+
+#ifndef __TRIGGER_H
+#define __TRIGGER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+  * @brief ring geometry. one slot holds one packed dma block (1024 sc12
+  *        pairs, ~3.6 ms) plus its frame header. a spare frame stands in for
+  *        the one usb may still be sending, so 16 slots use ~51 KB of sram.
+  */
+#define TRIGGER_RING_BLOCKS              16
+#define TRIGGER_BLOCK_BYTES              3072
+#define TRIGGER_MAX_PRE_BLOCKS           (TRIGGER_RING_BLOCKS - 2)
+
+/**
+  * @brief frame flags
+  */
+#define TRIGGER_FLAG_LAST                0x01  /*!< final block of the event */
+#define TRIGGER_FLAG_DROPPED             0x02  /*!< blocks were dropped before this one */
+
+/**
+  * @brief header sent in front of every block of an event. block indices
+  *        count dma blocks since READ_TRIGGERED started, so
+  *        block * 1024 is the sample index of the block's first sample.
+  */
+struct trigger_frame_t {
+  uint32_t cmd_code;
+  uint32_t event;          /*!< event sequence number */
+  uint32_t block;          /*!< block index of this block */
+  uint32_t trigger_block;  /*!< block index that fired the trigger (timestamp) */
+  uint32_t energy;         /*!< detector energy of this block, 1/16 adc counts */
+  uint32_t flags;          /*!< TRIGGER_FLAG_* */
+  uint8_t data[TRIGGER_BLOCK_BYTES];
+};
+
+void trigger_config(uint32_t threshold, uint32_t pre_blocks, uint32_t post_blocks);
+void trigger_start(uint32_t cmd_code);
+uint8_t * trigger_next_slot(void);
+void trigger_commit(uint32_t energy);
+struct trigger_frame_t * trigger_pending(void);
+void trigger_sent(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
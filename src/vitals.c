@@ -0,0 +1,280 @@
+/**
+  **************************************************************************
+  * @file     vitals.c
+  * @brief    vital-sign (respiration/heartbeat) extraction
+  *
+  *           raw i/q is decimated by summing whole dma blocks, demodulated
+  *           to chest-wall displacement with atan2 + phase unwrapping, then
+  *           split into respiration and heartbeat bands. each band's rate is
+  *           estimated from the spacing of its zero crossings.
+  **************************************************************************
+  */
+
+#include <math.h>
+#include <string.h>
+#include "vitals.h"
+
+#define ADC_MID_SCALE                    2048
+#define VITALS_PI                        3.14159265f
+
+/* level tracker time constant and crossing hysteresis (fraction of level) */
+#define RATE_LEVEL_ALPHA                 0.05f
+#define RATE_HYSTERESIS                  0.25f
+#define RATE_PERIOD_ALPHA                0.25f
+
+struct biquad_t {
+  float b0, b1, b2, a1, a2;
+  float z1, z2;
+};
+
+struct band_t {
+  struct biquad_t hp;
+  struct biquad_t lp;
+};
+
+struct rate_t {
+  float level;
+  float prev;
+  float last_crossing;
+  float period;
+  float min_period;
+  float max_period;
+  uint32_t now;
+  int armed;
+};
+
+static struct band_t breath_band;
+static struct band_t heart_band;
+static struct rate_t breath_rate;
+static struct rate_t heart_rate;
+
+static int32_t acc_i, acc_q;
+static uint32_t acc_blocks;
+static float last_phase;
+static float unwrapped_phase;
+static int have_phase;
+static uint32_t report_fill;
+static struct vitals_report_t report;
+
+/**
+  * @brief  design a butterworth (q = 1/sqrt(2)) low- or high-pass biquad
+  * @param  bq: filter to initialize
+  * @param  fc: corner frequency in Hz
+  * @param  fs: sample rate in Hz
+  * @param  highpass: non-zero for a high-pass section
+  * @retval none
+  */
+static void biquad_design(struct biquad_t *bq, float fc, float fs, int highpass)
+{
+  float w0 = 2.0f * VITALS_PI * fc / fs;
+  float cw = cosf(w0);
+  float alpha = sinf(w0) / (2.0f * 0.70710678f);
+  float a0 = 1.0f + alpha;
+
+  if(highpass) {
+    bq->b0 = (1.0f + cw) / 2.0f / a0;
+    bq->b1 = -(1.0f + cw) / a0;
+  } else {
+    bq->b0 = (1.0f - cw) / 2.0f / a0;
+    bq->b1 = (1.0f - cw) / a0;
+  }
+  bq->b2 = bq->b0;
+  bq->a1 = -2.0f * cw / a0;
+  bq->a2 = (1.0f - alpha) / a0;
+  bq->z1 = 0;
+  bq->z2 = 0;
+}
+
+/**
+  * @brief  run one sample through a biquad (transposed direct form ii)
+  */
+static float biquad_step(struct biquad_t *bq, float x)
+{
+  float y = bq->b0 * x + bq->z1;
+  bq->z1 = bq->b1 * x - bq->a1 * y + bq->z2;
+  bq->z2 = bq->b2 * x - bq->a2 * y;
+  return y;
+}
+
+static void band_init(struct band_t *band, float low, float high, float fs)
+{
+  biquad_design(&band->hp, low, fs, 1);
+  biquad_design(&band->lp, high, fs, 0);
+}
+
+static float band_step(struct band_t *band, float x)
+{
+  return biquad_step(&band->lp, biquad_step(&band->hp, x));
+}
+
+static void rate_init(struct rate_t *rate, float low, float high, float fs)
+{
+  memset(rate, 0, sizeof(*rate));
+  rate->min_period = fs / high;
+  rate->max_period = fs / low;
+}
+
+/**
+  * @brief  track positive-going zero crossings (with hysteresis) of a band
+  *         output and smooth the interpolated crossing-to-crossing period
+  * @param  rate: tracker state
+  * @param  x: band-passed sample
+  * @retval none
+  */
+static void rate_step(struct rate_t *rate, float x)
+{
+  float h, t, interval;
+
+  rate->level += RATE_LEVEL_ALPHA * (fabsf(x) - rate->level);
+  h = RATE_HYSTERESIS * rate->level;
+
+  if(x < -h) {
+    rate->armed = 1;
+  } else if(rate->armed && x > h && x != rate->prev) {
+    rate->armed = 0;
+    t = (float)rate->now - 1.0f + (h - rate->prev) / (x - rate->prev);
+    interval = t - rate->last_crossing;
+    rate->last_crossing = t;
+    if(interval >= rate->min_period && interval <= rate->max_period) {
+      if(rate->period == 0)
+        rate->period = interval;
+      else
+        rate->period += RATE_PERIOD_ALPHA * (interval - rate->period);
+    }
+  }
+
+  rate->prev = x;
+  rate->now++;
+}
+
+static float rate_bpm(const struct rate_t *rate, float fs)
+{
+  if(rate->period == 0)
+    return 0;
+  return 60.0f * fs / rate->period;
+}
+
+/**
+  * @brief  reset the vitals chain
+  * @param  cmd_code: command code stamped into each report
+  * @retval none
+  */
+void vitals_init(uint32_t cmd_code)
+{
+  float fs = VITALS_OUTPUT_RATE_HZ;
+
+  band_init(&breath_band, VITALS_BREATH_LOW_HZ, VITALS_BREATH_HIGH_HZ, fs);
+  band_init(&heart_band, VITALS_HEART_LOW_HZ, VITALS_HEART_HIGH_HZ, fs);
+  rate_init(&breath_rate, VITALS_BREATH_LOW_HZ, VITALS_BREATH_HIGH_HZ, fs);
+  rate_init(&heart_rate, VITALS_HEART_LOW_HZ, VITALS_HEART_HIGH_HZ, fs);
+
+  acc_i = 0;
+  acc_q = 0;
+  acc_blocks = 0;
+  have_phase = 0;
+  last_phase = 0;
+  unwrapped_phase = 0;
+  report_fill = 0;
+
+  memset(&report, 0, sizeof(report));
+  report.cmd_code = cmd_code;
+}
+
+/**
+  * @brief  a band's filter as a two-stage biquad cascade (high-pass, then
+  *         low-pass), in cmsis-dsp's {b0, b1, b2, -a1, -a2} order per stage,
+  *         as arm_biquad_cascade_df2T_f32 takes it
+  * @param  band: VITALS_BAND_BREATH or VITALS_BAND_HEART
+  * @param  coeffs: 10 output coefficients
+  * @retval none
+  */
+void vitals_band_coeffs(uint32_t band, float coeffs[10])
+{
+  struct band_t b;
+  const struct biquad_t *stage[2] = {&b.hp, &b.lp};
+  uint32_t x;
+
+  if(band == VITALS_BAND_HEART)
+    band_init(&b, VITALS_HEART_LOW_HZ, VITALS_HEART_HIGH_HZ, VITALS_OUTPUT_RATE_HZ);
+  else
+    band_init(&b, VITALS_BREATH_LOW_HZ, VITALS_BREATH_HIGH_HZ, VITALS_OUTPUT_RATE_HZ);
+
+  for(x = 0; x < 2; x++) {
+    coeffs[5*x] = stage[x]->b0;
+    coeffs[5*x+1] = stage[x]->b1;
+    coeffs[5*x+2] = stage[x]->b2;
+    coeffs[5*x+3] = -stage[x]->a1;
+    coeffs[5*x+4] = -stage[x]->a2;
+  }
+}
+
+/**
+  * @brief  feed one dma block of raw 12-bit i/q pairs into the vitals chain
+  * @param  block: i/q pairs
+  * @param  count: number of pairs in block
+  * @retval 1 when a new report is ready, 0 otherwise
+  */
+int vitals_process_block(const volatile uint16_t (*block)[2], uint32_t count)
+{
+  uint32_t x;
+  int32_t sum_i = 0, sum_q = 0;
+  float phase, delta, b, h;
+
+  // decimate: sum the whole block
+  for(x = 0; x < count; x++) {
+    sum_i += block[x][0];
+    sum_q += block[x][1];
+  }
+  acc_i += sum_i - (int32_t)(ADC_MID_SCALE * count);
+  acc_q += sum_q - (int32_t)(ADC_MID_SCALE * count);
+
+  if(++acc_blocks < VITALS_DECIMATION)
+    return 0;
+
+  // arctangent demodulation with unwrapping
+  phase = atan2f((float)acc_q, (float)acc_i);
+  acc_i = 0;
+  acc_q = 0;
+  acc_blocks = 0;
+
+  if(!have_phase) {
+    have_phase = 1;
+    unwrapped_phase = phase;
+  } else {
+    delta = phase - last_phase;
+    if(delta > VITALS_PI)
+      delta -= 2.0f * VITALS_PI;
+    else if(delta < -VITALS_PI)
+      delta += 2.0f * VITALS_PI;
+    unwrapped_phase += delta;
+  }
+  last_phase = phase;
+
+  b = band_step(&breath_band, unwrapped_phase);
+  h = band_step(&heart_band, unwrapped_phase);
+  rate_step(&breath_rate, b);
+  rate_step(&heart_rate, h);
+
+  report.phase[report_fill] = unwrapped_phase;
+  report.breath[report_fill] = b;
+  report.heart[report_fill] = h;
+
+  if(++report_fill < VITALS_REPORT_SAMPLES)
+    return 0;
+
+  report_fill = 0;
+  report.seq++;
+  report.breath_bpm = rate_bpm(&breath_rate, VITALS_OUTPUT_RATE_HZ);
+  report.heart_bpm = rate_bpm(&heart_rate, VITALS_OUTPUT_RATE_HZ);
+  return 1;
+}
+
+/**
+  * @brief  most recently completed report
+  * @param  none
+  * @retval report
+  */
+const struct vitals_report_t * vitals_report(void)
+{
+  return &report;
+}
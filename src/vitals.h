@@ -0,0 +1,70 @@
+/**
+  **************************************************************************
+  * @file     vitals.h
+  * @brief    vital-sign (respiration/heartbeat) extraction header file
+  **************************************************************************
+  */
+
+#ifndef __VITALS_H
+#define __VITALS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+  * @brief vitals chain rates
+  *        the adc samples one i/q pair every 2 * (71.5 + 12.5) adc clocks
+  *        (48 MHz), so one 1024-pair dma block arrives at ~279 Hz. each block
+  *        is summed into one complex sample, then VITALS_DECIMATION block sums
+  *        are summed into one output sample at ~10 Hz.
+  */
+#define VITALS_SAMPLE_RATE_HZ            285714.0f
+#define VITALS_BLOCK_SIZE                1024
+#define VITALS_DECIMATION                28
+#define VITALS_OUTPUT_RATE_HZ            (VITALS_SAMPLE_RATE_HZ / (VITALS_BLOCK_SIZE * VITALS_DECIMATION))
+
+/**
+  * @brief number of output samples carried by each report (~2.5 Hz reports)
+  */
+#define VITALS_REPORT_SAMPLES            4
+
+/**
+  * @brief respiration and heartbeat pass bands
+  */
+#define VITALS_BREATH_LOW_HZ             0.1f
+#define VITALS_BREATH_HIGH_HZ            0.5f
+#define VITALS_HEART_LOW_HZ              0.8f
+#define VITALS_HEART_HIGH_HZ             2.0f
+
+/**
+  * @brief vitals report, sized to fit a single 64-byte usb packet
+  */
+struct vitals_report_t {
+  uint32_t cmd_code;
+  uint32_t seq;
+  float breath_bpm;
+  float heart_bpm;
+  float phase[VITALS_REPORT_SAMPLES];
+  float breath[VITALS_REPORT_SAMPLES];
+  float heart[VITALS_REPORT_SAMPLES];
+};
+
+/**
+  * @brief bands for vitals_band_coeffs()
+  */
+#define VITALS_BAND_BREATH               0
+#define VITALS_BAND_HEART                1
+
+void vitals_init(uint32_t cmd_code);
+void vitals_band_coeffs(uint32_t band, float coeffs[10]);
+int vitals_process_block(const volatile uint16_t (*block)[2], uint32_t count);
+const struct vitals_report_t * vitals_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 
+import argparse
 import binascii
 import serial
 import struct
@@ -26,6 +27,26 @@ CFG_ADC = 0x1002
 TRIGGER_ADC = 0x1003
 READ_ADC = 0x1004
 SET_GPIO_PIN = 0x1005
+READ_VITALS = 0x1006
+CFG_CLUTTER = 0x1007
+BENCH_CFAR = 0x1008
+CFG_TRIGGER = 0x1009
+READ_TRIGGERED = 0x100A
+READ_VERSION = 0x100B
+
+FW_VERSION_SIZE = 32
+
+TRIGGER_FLAG_LAST    = 0x01
+TRIGGER_FLAG_DROPPED = 0x02
+TRIGGER_FRAME_HEADER = "IIIIII"
+
+CLUTTER_ENABLE = 0x01
+CLUTTER_FREEZE = 0x02
+CLUTTER_RESET  = 0x04
+
+VITALS_REPORT_SAMPLES = 4
+SAMPLES_PER_BLOCK = 1024
+SAMPLE_RATE = 285714
 
 
 class Command:
@@ -40,8 +61,8 @@ class Command:
 
 class Client:
 
-  def __init__(self):
-    self.tty = serial.Serial("/dev/ttyACM0", timeout=0.2)
+  def __init__(self, device="/dev/ttyACM0"):
+    self.tty = serial.Serial(device, timeout=0.2)
 
   def write(self, data):
     self.tty.write(data)
@@ -82,19 +103,96 @@ class Client:
       sys.stderr.write("error! trigger_adc failed!")
       sys.stderr.write(cmd_code, status)
 
+  def configure_clutter(self, flags, shift, ack=True):
+    # while streaming the firmware applies this without a response
+    cmd = Command(CFG_CLUTTER, [flags, shift])
+    self.write(cmd.serialize())
+    if not ack:
+      return
+    cmd_code, status = struct.unpack("II", self.read())
+    if cmd_code != CFG_CLUTTER or status != 0:
+      print("error! configure_clutter failed!", file=sys.stderr)
+      print(cmd_code, status, file=sys.stderr)
+
+  def bench_cfar(self):
+    cmd = Command(BENCH_CFAR, [])
+    self.write(cmd.serialize())
+    d = self.read2(36, 2)
+    cmd_code, status, cells = struct.unpack("III", d[:12])
+    cycles = struct.unpack("III", d[12:24])
+    detections = struct.unpack("III", d[24:36])
+    if cmd_code != BENCH_CFAR or status != 0:
+      print("error! bench_cfar failed!", file=sys.stderr)
+    return cells, cycles, detections
+
+  def read_version(self):
+    cmd = Command(READ_VERSION, [])
+    self.write(cmd.serialize())
+    d = self.read2(8 + FW_VERSION_SIZE, 1)
+    if len(d) < 8 + FW_VERSION_SIZE:
+      return None
+    cmd_code, status = struct.unpack("II", d[:8])
+    if cmd_code != READ_VERSION or status != 0:
+      return None
+    return d[8:].rstrip(b"\0").decode()
+
+  def configure_trigger(self, threshold, pre_blocks, post_blocks):
+    cmd = Command(CFG_TRIGGER, [threshold, pre_blocks, post_blocks])
+    self.write(cmd.serialize())
+    cmd_code, status = struct.unpack("II", self.read())
+    if cmd_code != CFG_TRIGGER or status != 0:
+      print("error! configure_trigger failed!", file=sys.stderr)
+      print(cmd_code, status, file=sys.stderr)
+
+  def read_triggered(self):
+    # yields (event, block, trigger_block, energy, flags, sc12 data) per frame
+    cmd = Command(READ_TRIGGERED, [])
+    self.write(cmd.serialize())
+    hdr_len = struct.calcsize(TRIGGER_FRAME_HEADER)
+    while True:
+      d = self.read2(hdr_len + 3072, 2)
+      if len(d) != hdr_len + 3072:
+        continue
+      cmd_code, event, block, trigger_block, energy, flags = struct.unpack(TRIGGER_FRAME_HEADER, d[:hdr_len])
+      if cmd_code != READ_TRIGGERED:
+        sys.stderr.write("error! unexpected trigger frame 0x%x\n" % cmd_code)
+        continue
+      yield(event, block, trigger_block, energy, flags, d[hdr_len:])
+
   def read_adc(self):
-    with open("output.iq", "wb") as f:
+    # a 1 MiB buffer turns ~280 block-sized writes per second into a few
+    # large ones; output.iq is complete once the script exits
+    with open("output.iq", "wb", buffering=1 << 20) as f:
       cmd = Command(READ_ADC, [])
       self.write(cmd.serialize())
       while True:
         data = self.read2(3072, 2)
         yield(data)
         f.write(data)
-        f.flush()
 
 
+  def read_vitals(self):
+    cmd = Command(READ_VITALS, [])
+    self.write(cmd.serialize())
+    fmt = "IIff%df" % (VITALS_REPORT_SAMPLES*3,)
+    while True:
+      d = self.read2(struct.calcsize(fmt), 2)
+      if len(d) != struct.calcsize(fmt):
+        continue
+      fields = struct.unpack(fmt, d)
+      cmd_code, seq, breath_bpm, heart_bpm = fields[:4]
+      if cmd_code != READ_VITALS:
+        sys.stderr.write("error! unexpected vitals report 0x%x\n" % cmd_code)
+        continue
+      n = VITALS_REPORT_SAMPLES
+      phase = fields[4:4+n]
+      breath = fields[4+n:4+2*n]
+      heart = fields[4+2*n:4+3*n]
+      yield(seq, breath_bpm, heart_bpm, phase, breath, heart)
+
   def configure_gpio(self, group, pin, mode, value=None):
-    cmd = Command(CFG_GPIO_PIN, [group, pin, mode, value])
+    # the firmware passes the pin straight to gpio_init() as a pin mask
+    cmd = Command(CFG_GPIO_PIN, [group, 1 << pin, mode, value])
     pld = cmd.serialize()
     self.write(pld)
     response = self.read()
@@ -104,7 +202,37 @@ class Client:
       print("error! configure_gpio failed!", file=sys.stderr)
       print(cmd_code, status, file=sys.stderr)
 
-c = Client()
+parser = argparse.ArgumentParser()
+parser.add_argument("--device", default="/dev/ttyACM0",
+                    help="module tty, or the pty printed by iqsim")
+parser.add_argument("--vitals", action="store_true",
+                    help="stream respiration/heartbeat reports instead of IQ")
+parser.add_argument("--clutter-shift", type=int, default=None,
+                    help="subtract static clutter, averaging over 2^N blocks")
+parser.add_argument("--trigger", type=float, default=None,
+                    help="only capture events whose mean |IQ - clutter| exceeds this many ADC counts")
+parser.add_argument("--pre", type=int, default=4,
+                    help="pre-trigger blocks per event (max 14)")
+parser.add_argument("--post", type=int, default=16,
+                    help="post-trigger blocks per event")
+parser.add_argument("--bench-cfar", action="store_true",
+                    help="time the on-device CFAR kernels and exit")
+parser.add_argument("--version", action="store_true",
+                    help="print the firmware version and exit")
+args = parser.parse_args()
+
+c = Client(args.device)
+
+if args.version:
+  print(c.read_version() or "unknown (firmware predates READ_VERSION)")
+  sys.exit(0)
+
+if args.bench_cfar:
+  cells, cycles, detections = c.bench_cfar()
+  for name, cyc, det in zip(("CA", "GO", "OS"), cycles, detections):
+    print("%s-CFAR: %d cells, %d cycles (%.1f cycles/cell), %d detections" %
+          (name, cells, cyc, cyc/cells, det))
+  sys.exit(0)
 
 # ADC Inputs
 c.configure_gpio(GPIOA, 6, GPIO_ANALOG)
@@ -120,6 +248,34 @@ c.configure_dma()
 c.configure_adc()
 c.trigger_adc()
 
+if args.clutter_shift is not None:
+  c.configure_clutter(CLUTTER_ENABLE | CLUTTER_RESET, args.clutter_shift)
+
+# triggered capture: one event-<n>.iq per event
+if args.trigger is not None:
+  c.configure_trigger(int(args.trigger*16), args.pre, args.post)
+  f = None
+  for event, block, trigger_block, energy, flags, data in c.read_triggered():
+    if f is None:
+      f = open("event-%d.iq" % event, "wb")
+      sys.stderr.write("event %d triggered at %.3f s (block %d)\n" %
+                       (event, trigger_block*SAMPLES_PER_BLOCK/SAMPLE_RATE, trigger_block))
+    if flags & TRIGGER_FLAG_DROPPED:
+      sys.stderr.write("event %d: blocks dropped before block %d\n" % (event, block))
+    f.write(data)
+    if flags & TRIGGER_FLAG_LAST:
+      f.close()
+      f = None
+  sys.exit(0)
+
+# low-rate vital-sign mode: one line per report
+if args.vitals:
+  for seq, breath_bpm, heart_bpm, phase, breath, heart in c.read_vitals():
+    print("%d breath=%.1f bpm heart=%.1f bpm phase=%s" % (seq, breath_bpm, heart_bpm,
+      " ".join("%.4f" % p for p in phase)))
+    sys.stdout.flush()
+  sys.exit(0)
+
 start = time.time()
 sample_count = 0
 for data in c.read_adc():